@@ -0,0 +1,184 @@
+// SSP1 cost per frame and per caller (user-004)
+//
+// Plays a scripted game with the firmware built with SPI_STATS=1 and
+// charges every frame the SSP1 model shifts out, and every chip select,
+// to the tag main.c had selected with GLCD_StatsTag at the time. A frame
+// ends where display_task reads GLCD_SpiBytes, which the link wraps
+// (-Wl,--wrap=GLCD_SpiBytes) to read the driver's own per tag counters
+// first. Frame 0 also holds the start screen and mapPrint. The build has
+// PROFILE_BUS on, so main.c busReport also sends the driver counters of
+// every frame as TLM_BUS records on UART0.
+//
+//   bench_bus [-a]
+//
+// Prints the first frames (-a: all of them) and per tag totals, and fails
+// if the driver counters or its wire time estimate disagree with the model,
+// or the TLM_BUS records on UART0 disagree with the driver counters.
+
+#include <stdio.h>
+#include <string.h>
+#include "GLCD.h"
+#include "hal.h"
+#include "telemetry.h"
+#include "sim.h"
+
+#define TAGS       (5)              // main.c BUS_xxx
+#define FRAMES     (4096)
+#define SHOWN      (10)
+
+typedef struct {
+	uint64_t bytes;
+	uint64_t cs;
+	uint64_t wireNs;
+	uint32_t drvBytes;
+	uint32_t drvCs;
+	uint32_t drvSkip;
+	uint32_t drvUs;
+} TAG_COST;
+
+static const char *names[TAGS] = {"other", "map", "tank", "mines", "flush"};
+
+static TAG_COST cur[TAGS];
+static TAG_COST frames[FRAMES][TAGS];
+static uint32_t nFrames = 0;
+static uint32_t mismatches = 0;
+
+int MinefieldMain(void);
+unsigned int __real_GLCD_SpiBytes(unsigned char reset);
+
+static void entry(void) {
+	MinefieldMain();
+}
+
+static void tap(unsigned int bytes, uint64_t wireNs, unsigned int cs) {
+	unsigned char tag = GLCD_StatsTag(0xFF);
+
+	if(tag >= TAGS)
+		tag = 0;
+	cur[tag].bytes += bytes;
+	cur[tag].wireNs += wireNs;
+	cur[tag].cs += cs;
+}
+
+unsigned int __wrap_GLCD_SpiBytes(unsigned char reset) {
+	GLCD_STATS st;
+	int i;
+
+	for(i=0; i<TAGS; i++) {
+		GLCD_Stats(i, &st, 0);
+		cur[i].drvBytes = st.bytes;
+		cur[i].drvCs = st.cs;
+		cur[i].drvSkip = st.skipped;
+		cur[i].drvUs = st.wire_us;
+		// rd_id_man bit-bangs two transactions before SSP1 is set up, which
+		// the driver rightly does not count, so frame 0 skips the cs check
+		if(st.bytes != cur[i].bytes || (nFrames && st.cs != cur[i].cs) ||
+		   (int64_t)st.wire_us - (int64_t)(cur[i].wireNs/1000) > 1 ||
+		   (int64_t)(cur[i].wireNs/1000) - (int64_t)st.wire_us > 1) {
+			printf("  frame %u %s: driver %uB %ucs %uus, model %lluB %llucs %lluus\n", nFrames, names[i],
+			       st.bytes, st.cs, st.wire_us, (unsigned long long)cur[i].bytes,
+			       (unsigned long long)cur[i].cs, (unsigned long long)cur[i].wireNs/1000);
+			mismatches++;
+		}
+	}
+	if(nFrames < FRAMES)
+		memcpy(frames[nFrames++], cur, sizeof(cur));
+	memset(cur, 0, sizeof(cur));
+	return __real_GLCD_SpiBytes(reset);
+}
+
+static uint32_t get16(const uint8_t *p) {
+	return p[0] | p[1] << 8;
+}
+
+static uint32_t get32(const uint8_t *p) {
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// Checks the TLM_BUS records on UART0 against the counters read by the
+// wrap, returns the number of records found
+static uint32_t busRecords(uint32_t *bad) {
+	const uint8_t *d, *p;
+	uint32_t len, i = 0, n = 0, frame, tag;
+	const TAG_COST *c;
+
+	d = SIM_UartOutput(0, &len);
+	while(i + 4 <= len && d[i] == TLM_SYNC && i + 4 + d[i+2] <= len) {
+		p = d + i + 3;
+		if(d[i+1] == TLM_BUS && d[i+2] == 15) {
+			frame = get16(p);
+			tag = p[2];
+			n++;
+			c = frame < nFrames && tag < TAGS ? &frames[frame][tag] : 0;
+			if(!c || get32(p + 3) != c->drvBytes || get16(p + 7) != c->drvCs ||
+			   get16(p + 9) != c->drvSkip || get32(p + 11) != c->drvUs)
+				(*bad)++;
+		}
+		i += 4 + d[i+2];
+	}
+	if(i != len)
+		(*bad)++;
+	return n;
+}
+
+static void printFrame(uint32_t n) {
+	int i;
+
+	printf("  frame %3u:", n);
+	for(i=0; i<TAGS; i++) {
+		if(frames[n][i].bytes || frames[n][i].drvSkip)
+			printf(" %s %lluB %llucs %.0fus (est %uus, %u skipped)", names[i],
+			       (unsigned long long)frames[n][i].bytes, (unsigned long long)frames[n][i].cs,
+			       frames[n][i].wireNs/1000.0, frames[n][i].drvUs, frames[n][i].drvSkip);
+	}
+	printf("\n");
+}
+
+int main(int argc, char **argv) {
+	uint64_t bytes, cs, wireNs, maxBytes;
+	uint32_t n, first, records, bad = 0;
+	int i, all = argc > 1 && !strcmp(argv[1], "-a");
+	int r;
+
+	// Start, drive up, stop, turn right and go again
+	SIM_JoyAt(200*SIM_MS, HAL_JOY_PRESS);
+	SIM_JoyAt(300*SIM_MS, 0);
+	SIM_JoyAt(1000*SIM_MS, HAL_JOY_P24 | HAL_JOY_PRESS);
+	SIM_JoyAt(1100*SIM_MS, 0);
+	SIM_ButtonAt(1800*SIM_MS);
+	SIM_JoyAt(2500*SIM_MS, HAL_JOY_P25);
+	SIM_JoyAt(2600*SIM_MS, HAL_JOY_P25 | HAL_JOY_PRESS);
+	SIM_JoyAt(2700*SIM_MS, 0);
+
+	SIM_SspTap(tap);
+	r = SIM_Run(entry, 300*SIM_S);
+
+	printf("bench_bus: %u frames, %s\n", nFrames, r == 0 ? "game over" : "did not finish");
+	for(n=0; n<nFrames && (all || n<SHOWN); n++)
+		printFrame(n);
+	if(!all && nFrames > SHOWN)
+		printf("  ... (-a prints all frames)\n");
+
+	// Frame 0 carries the start screen, the rest are game frames
+	first = nFrames > 1 ? 1 : 0;
+	printf(" per tag over frames %u-%u:\n", first, nFrames ? nFrames-1 : 0);
+	for(i=0; i<TAGS; i++) {
+		bytes = cs = wireNs = maxBytes = 0;
+		for(n=first; n<nFrames; n++) {
+			bytes += frames[n][i].bytes;
+			cs += frames[n][i].cs;
+			wireNs += frames[n][i].wireNs;
+			if(frames[n][i].bytes > maxBytes)
+				maxBytes = frames[n][i].bytes;
+		}
+		printf("  %-6s %9llu B %6llu cs %9.1f us wire, %8.1f B/frame, max %llu B\n", names[i],
+		       (unsigned long long)bytes, (unsigned long long)cs, wireNs/1000.0,
+		       nFrames > first ? (double)bytes/(nFrames-first) : 0.0, (unsigned long long)maxBytes);
+	}
+	printf(" driver counters vs model: %u mismatching tag/frame pairs\n", mismatches);
+	records = busRecords(&bad);
+	printf(" TLM_BUS records: %u of %u, %u not matching the driver, %u records dropped\n",
+	       records, nFrames*TAGS, bad, TLM_Dropped());
+
+	return r != 0 || nFrames < 2 || mismatches || bad || records != nFrames*TAGS ? 1 : 0;
+}
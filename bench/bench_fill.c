@@ -0,0 +1,127 @@
+// Solid fill timing on the simulated SSP1 (user-010)
+//
+// Times GLCD_Clear and two GLCD_FillRect sizes with the driver built
+// without DMA (SPI_DMA=0), so the fills go through the 16-bit FIFO engine,
+// against the 8-bit path GLCD_Clear used before it: every byte written with
+// spi_tran, which waits for RNE and reads DR before the next one
+// (reproduced here on the same registers).
+//
+// Prints simulated time and how busy the wire was, and fails if a fill
+// leaves a different screen or the engine is not faster.
+
+#include <stdio.h>
+#include "LPC17xx.h"
+#include "hal_io.h"
+#include "GLCD.h"
+#include "sim.h"
+
+#define SR_RNE     (0x04)
+#define PIN_CS     (1 << 6)
+
+typedef struct {
+	uint64_t ns;
+	uint64_t wireNs;
+	uint64_t bytes;
+} COST;
+
+static int failed = 0;
+
+#define CHECK(c) do { if(!(c)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #c); failed++; } } while(0)
+
+static uint64_t t0;
+
+static void costStart(void) {
+	SIM_SspStats(0, 1);
+	t0 = SIM_Now();
+}
+
+static COST costEnd(void) {
+	SIM_SSP_STATS st;
+	COST c;
+
+	SIM_SspStats(&st, 1);
+	c.ns = SIM_Now() - t0;
+	c.wireNs = st.wireNs;
+	c.bytes = st.bytes;
+	return c;
+}
+
+static unsigned char spiTran(unsigned char byte) {
+	IO_WR(LPC_SSP1->DR, byte);
+	while(!(IO_RD(LPC_SSP1->SR) & SR_RNE));
+	return IO_RD(LPC_SSP1->DR);
+}
+
+// wr_cmd(0x22), wr_dat_start, n x wr_dat_only, wr_dat_stop of the old driver
+static void refFill(unsigned int x, unsigned int y, unsigned int w, unsigned int h, uint16_t color) {
+	unsigned int i;
+
+	GLCD_SetWindow(x, y, w, h);
+	GLCD_WrCmd(0x22);
+	IO_WR(LPC_GPIO0->FIOCLR, PIN_CS);
+	spiTran(0x72);
+	for(i=0; i<w*h; i++) {
+		spiTran(color >> 8);
+		spiTran(color & 0xFF);
+	}
+	IO_WR(LPC_GPIO0->FIOSET, PIN_CS);
+}
+
+static int filled(unsigned int x, unsigned int y, unsigned int w, unsigned int h, uint16_t c) {
+	unsigned int i, j;
+
+	for(j=y; j<y+h; j++)
+		for(i=x; i<x+w; i++)
+			if(SIM_LcdPixel(i, j) != c)
+				return 0;
+	return 1;
+}
+
+static void row(const char *name, const COST *c) {
+	printf("    %-7s %9.3f ms %7llu B  %5.2f MB/s  wire busy %5.1f%%\n", name, c->ns/1e6,
+	       (unsigned long long)c->bytes, c->bytes*1e3/c->ns, 100.0*c->wireNs/c->ns);
+}
+
+static void compare(const char *name, unsigned int x, unsigned int y, unsigned int w, unsigned int h) {
+	COST ref, eng;
+
+	costStart();
+	refFill(x, y, w, h, Red);
+	ref = costEnd();
+	CHECK(filled(x, y, w, h, Red));
+
+	costStart();
+	if(w == SIM_LCD_W && h == SIM_LCD_H)
+		GLCD_Clear(Blue);
+	else
+		GLCD_FillRect(x, y, w, h, Blue);
+	eng = costEnd();
+	CHECK(filled(x, y, w, h, Blue));
+	CHECK(eng.ns < ref.ns);
+
+	printf("  %s:\n", name);
+	row("8-bit", &ref);
+	row("16-bit", &eng);
+}
+
+static void body(void) {
+	GLCD_Init();
+	GLCD_Clear(Black);
+
+	printf("bench_fill: 8-bit spi_tran per byte vs the 16-bit FIFO fill, no DMA\n");
+	compare("GLCD_Clear", 0, 0, SIM_LCD_W, SIM_LCD_H);
+	compare("GLCD_FillRect 100x100", 20, 20, 100, 100);
+	compare("GLCD_FillRect 16x16", 200, 100, 16, 16);
+	CHECK(SIM_LcdErrors() == 0);
+}
+
+int main(void) {
+	int r = SIM_Run(body, 10*SIM_S);
+
+	CHECK(r == 0);
+	if(failed) {
+		printf("%d check(s) failed\n", failed);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,134 @@
+// CPU idle time of the game tasks (user-018)
+//
+// Runs the firmware (main.c) on the simulated board and measures how much
+// of the time no task was ready, first as it is, with game_task and
+// display_task only running on new data, then with the old coll_task added
+// back: a task that checks the tank cell under dataMTX and asks for a
+// redraw on every pass without waiting for anything (reconstructed here,
+// the tasks it used to run next to were merged into game_task since). The
+// tank stays on the start cell, so nothing changes on screen in either
+// window.
+//
+// Prints idle time, kernel calls, task switches and tick interrupts per
+// window, and fails if the event-driven tasks do not leave the core idle
+// most of the time, the tick interrupt stays on while idle (tickless idle,
+// RTX_config.c) or the polling task does not take the core away.
+
+#include <stdio.h>
+#include <RTL.h>
+#include "game.h"
+#include "hal.h"
+#include "sim.h"
+
+#define WINDOW     (200)       // ticks of 10 ms
+#define EVT_RENDER (0x0004)    // main.c
+
+typedef struct {
+	uint64_t ns;
+	uint64_t idleNs;
+	uint64_t calls;
+	uint64_t switches;
+	uint32_t ticks;
+} LOAD;
+
+int MinefieldMain(void);
+void __real_os_sys_init(void (*task)(void));
+
+// main.c
+extern OS_MUT dataMTX;
+extern OS_TID tskDisp;
+extern GameState gameState;
+
+static int failed = 0;
+
+#define CHECK(c) do { if(!(c)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #c); failed++; } } while(0)
+
+static void (*fwInit)(void);
+static SIM_RTX_STATS s0;
+static uint64_t t0;
+
+static void loadStart(void) {
+	SIM_RtxStats(&s0);
+	t0 = SIM_Now();
+}
+
+static LOAD loadEnd(void) {
+	SIM_RTX_STATS s;
+	LOAD l;
+
+	SIM_RtxStats(&s);
+	l.ns = SIM_Now() - t0;
+	l.idleNs = s.idleNs - s0.idleNs;
+	l.calls = s.calls - s0.calls;
+	l.switches = s.switches - s0.switches;
+	l.ticks = s.ticks - s0.ticks;
+	return l;
+}
+
+static void row(const char *name, const LOAD *l) {
+	printf("  %-13s %5.1f%% idle %9.0f kernel calls/s %8.0f switches/s %5.0f tick interrupts/s\n", name,
+	       100.0*l->idleNs/l->ns, l->calls*1e9/l->ns, l->switches*1e9/l->ns, l->ticks*1e9/l->ns);
+}
+
+__task void pollTask(void) {
+	while(1) {
+		os_mut_wait(&dataMTX, 0xFFFF);
+		Game_CellState(&gameState, gameState.x, gameState.y);
+		os_evt_set(EVT_RENDER, tskDisp);
+		os_mut_release(&dataMTX);
+	}
+}
+
+__task void benchTask(void) {
+	LOAD events, poll;
+
+	os_tsk_prio_self(3);
+	os_tsk_create(fwInit, 1);
+
+	// Let the first frame go out
+	os_dly_wait(WINDOW/4);
+	loadStart();
+	os_dly_wait(WINDOW);
+	events = loadEnd();
+
+	os_tsk_create(pollTask, 1);
+	loadStart();
+	os_dly_wait(WINDOW);
+	poll = loadEnd();
+
+	CHECK(!gameState.gameOver);
+	CHECK(events.idleNs > events.ns*9/10);
+	CHECK(events.ticks < WINDOW/4);
+	CHECK(poll.idleNs < poll.ns/10);
+	CHECK(SIM_LcdErrors() == 0);
+
+	printf("bench_idle: %d ms windows, the tank standing still\n", WINDOW*10);
+	row("event-driven", &events);
+	row("coll polling", &poll);
+	SIM_Exit(0);
+}
+
+// main.c starts the kernel with init_tasks, which runs under benchTask
+void __wrap_os_sys_init(void (*task)(void)) {
+	fwInit = task;
+	__real_os_sys_init(benchTask);
+}
+
+static void entry(void) {
+	MinefieldMain();
+}
+
+int main(void) {
+	int r;
+
+	SIM_JoyAt(200*SIM_MS, HAL_JOY_PRESS);
+	SIM_JoyAt(300*SIM_MS, 0);
+	r = SIM_Run(entry, 60*SIM_S);
+
+	CHECK(r == 0);
+	if(failed) {
+		printf("%d check(s) failed\n", failed);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,119 @@
+// Mine collision lookups per second (user-005)
+//
+// Answers "is cell (x, y) in mine set s" for the same random queries three
+// ways and times them on the host CPU:
+//
+//   scan       linear search of the set's x/y lists, as coll_task did
+//              before the bit maps (lists built from MINE_SETx in MapData.h)
+//   bitfield   mineSetBitField[s][x] bit test
+//   cellsets   mineCellSets[y][x] set mask, as Game_CellState uses it
+//
+// Fails if the three disagree on any cell. The rates are wall clock and
+// only meaningful relative to each other.
+
+#include <stdio.h>
+#include <time.h>
+#include "game.h"
+
+#define QUERIES   (1 << 20)
+#define ROUNDS    (8)
+
+#define CELL_X(a, x, y) x,
+#define CELL_Y(a, x, y) y,
+
+typedef struct {
+	const uint8_t *x;
+	const uint8_t *y;
+	int n;
+} MINE_LIST;
+
+static const uint8_t set1X[] = {MINE_SET1(CELL_X, 0)}, set1Y[] = {MINE_SET1(CELL_Y, 0)};
+static const uint8_t set2X[] = {MINE_SET2(CELL_X, 0)}, set2Y[] = {MINE_SET2(CELL_Y, 0)};
+static const uint8_t set3X[] = {MINE_SET3(CELL_X, 0)}, set3Y[] = {MINE_SET3(CELL_Y, 0)};
+static const uint8_t set4X[] = {MINE_SET4(CELL_X, 0)}, set4Y[] = {MINE_SET4(CELL_Y, 0)};
+
+static const MINE_LIST lists[MINE_SETS] = {
+	{set1X, set1Y, sizeof(set1X)},
+	{set2X, set2Y, sizeof(set2X)},
+	{set3X, set3Y, sizeof(set3X)},
+	{set4X, set4Y, sizeof(set4X)}
+};
+
+static uint8_t qx[QUERIES], qy[QUERIES], qs[QUERIES];
+
+static int scan(int s, int x, int y) {
+	int i;
+
+	for(i=0; i<lists[s].n; i++) {
+		if(lists[s].x[i] == x && lists[s].y[i] == y)
+			return 1;
+	}
+	return 0;
+}
+
+static int bitfield(int s, int x, int y) {
+	return (mineSetBitField[s][x] >> (15-y)) & 1;
+}
+
+static int cellsets(int s, int x, int y) {
+	return (mineCellSets[y][x] >> s) & 1;
+}
+
+static double seconds(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+// Lookups per second and the number of hits
+static double rate(int (*lookup)(int s, int x, int y), uint32_t *hits) {
+	double t;
+	uint32_t i, r, n = 0;
+
+	t = seconds();
+	for(r=0; r<ROUNDS; r++) {
+		for(i=0; i<QUERIES; i++)
+			n += lookup(qs[i], qx[i], qy[i]);
+	}
+	t = seconds() - t;
+	*hits = n;
+	return (double)QUERIES*ROUNDS/t;
+}
+
+int main(void) {
+	uint32_t seed = 1, i, hScan, hBits, hSets;
+	int s, x, y, wrong = 0;
+	double rScan, rBits, rSets;
+
+	for(s=0; s<MINE_SETS; s++) {
+		for(x=0; x<MAP_COLS; x++) {
+			for(y=0; y<MAP_ROWS; y++) {
+				if(bitfield(s, x, y) != scan(s, x, y) || cellsets(s, x, y) != scan(s, x, y))
+					wrong++;
+			}
+		}
+	}
+
+	for(i=0; i<QUERIES; i++) {
+		seed = seed*1103515245 + 12345;
+		qx[i] = (seed >> 8) % MAP_COLS;
+		qy[i] = (seed >> 16) % MAP_ROWS;
+		qs[i] = (seed >> 24) % MINE_SETS;
+	}
+
+	rScan = rate(scan, &hScan);
+	rBits = rate(bitfield, &hBits);
+	rSets = rate(cellsets, &hSets);
+
+	printf("bench_mines: %u random lookups x %d\n", QUERIES, ROUNDS);
+	printf("  scan      %8.1f M/s\n", rScan/1e6);
+	printf("  bitfield  %8.1f M/s  %5.1fx\n", rBits/1e6, rBits/rScan);
+	printf("  cellsets  %8.1f M/s  %5.1fx\n", rSets/1e6, rSets/rScan);
+
+	if(wrong || hScan != hBits || hScan != hSets) {
+		printf("lookups disagree: %d cells, hits %u/%u/%u\n", wrong, hScan, hBits, hSets);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,295 @@
+// SSP1 cost of a mine set transition (user-008)
+//
+// Switches each mine set INVIS -> PRIMED -> EXP -> INVIS on the simulated
+// board, with the other sets invisible, and prints the SSP1 bytes, chip
+// selects and simulated time of every transition drawn three ways:
+//
+//   per mine   mineSetPrint before the batched renderer: every mine of the
+//              set drawn on its own with GLCD_DrawSprite, opaque except on
+//              the tank cell (reproduced here)
+//   runs       main.c sceneBuild + sceneDraw straight to the LCD
+//   runs+fb    the same into the frame buffer plus GLCD_FB_Flush, as
+//              display_task draws
+//
+// The frame buffer only knows what was drawn while it was on, so runs+fb is
+// a second pass over the same transitions with the buffer on from mapPrint,
+// as in main().
+//
+// Also times one tank move with set 1 primed, which mineSetPrint followed
+// by reprinting every primed set and sceneDraw by redrawing two cells.
+//
+// Fails if the drawings leave different screens (tank cell aside) or the
+// tank move is not cheaper.
+
+#include <stdio.h>
+#include "GLCD.h"
+#include "game.h"
+#include "sim.h"
+
+typedef struct {
+	uint16_t x;
+	uint16_t y;
+} POS;
+
+typedef struct {
+	uint64_t bytes;
+	uint64_t cs;
+	uint64_t ns;
+} COST;
+
+#define MINE_POS(a, x, y) { (x) * MAP_SCALE + (a), (y) * MAP_SCALE + (a) },
+
+static const POS set1[] = {MINE_SET1(MINE_POS, MAP_SCALE/2)};
+static const POS set2[] = {MINE_SET2(MINE_POS, MAP_SCALE/2)};
+static const POS set3[] = {MINE_SET3(MINE_POS, MAP_SCALE/2)};
+static const POS set4[] = {MINE_SET4(MINE_POS, MAP_SCALE/2)};
+
+static const struct {
+	const POS *pos;
+	int len;
+} sets[MINE_SETS] = {
+	{set1, sizeof(set1)/sizeof(POS)},
+	{set2, sizeof(set2)/sizeof(POS)},
+	{set3, sizeof(set3)/sizeof(POS)},
+	{set4, sizeof(set4)/sizeof(POS)}
+};
+
+static const char *stateNames[] = {"invis", "primed", "exp"};
+
+// main.c
+void mapCharacsInit(void);
+void lcdInit(void);
+void mineSpriteInit(void);
+void sceneInit(void);
+void mapPrint(void);
+void sceneBuild(const GameState* g);
+void sceneDraw(void);
+void tankPrint(int x, int y, Directions dir);
+
+static int failed = 0;
+
+#define CHECK(c) do { if(!(c)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #c); failed++; } } while(0)
+
+static uint16_t sprite[MAP_SCALE];
+static uint16_t screen[MINE_SETS*3][SIM_LCD_H][SIM_LCD_W];
+static uint64_t t0;
+
+static void costStart(void) {
+	SIM_SspStats(0, 1);
+	t0 = SIM_Now();
+}
+
+static COST costEnd(void) {
+	SIM_SSP_STATS st;
+	COST c;
+
+	SIM_SspStats(&st, 1);
+	c.bytes = st.bytes;
+	c.cs = st.csAsserts;
+	c.ns = SIM_Now() - t0;
+	return c;
+}
+
+// Same shape as main.c mineSpriteInit
+static void spriteInit(void) {
+	int i, j, c = MAP_SCALE/2;
+
+	for(i=8; i>=-8; i-=2) {
+		for(j=-8; j<=8; j++) {
+			if(i*i+j*j == 16) {
+				sprite[c+j]   |= (0x1 << (c+i)) | (0x1 << (c+i+1)) | (0x1 << (c+i-1));
+				sprite[c+j+1] |= (0x1 << (c+i));
+				sprite[c+j-1] |= (0x1 << (c+i));
+			}
+		}
+	}
+}
+
+static void setState(GameState *g, int set, MineState st) {
+	int i;
+
+	g->mines[set] = st;
+	g->setsPrimed = g->setsExp = 0;
+	for(i=0; i<MINE_SETS; i++) {
+		if(g->mines[i] == PRIMED)
+			g->setsPrimed |= 0x1 << i;
+		else if(g->mines[i] == EXP)
+			g->setsExp |= 0x1 << i;
+	}
+}
+
+static void redraw(const GameState *g) {
+	sceneBuild(g);
+	sceneDraw();
+}
+
+static void perMine(const GameState *g, int set) {
+	const POS *pos = sets[set].pos;
+	uint16_t tankX = g->x*MAP_SCALE + MAP_SCALE/2;
+	uint16_t tankY = g->y*MAP_SCALE + MAP_SCALE/2;
+	int i;
+
+	GLCD_SetTextColor(g->mines[set] == EXP ? Red : g->mines[set] == PRIMED ? Yellow : Black);
+	for(i=0; i<sets[set].len; i++) {
+		GLCD_DrawSprite(pos[i].x - MAP_SCALE/2, pos[i].y - MAP_SCALE/2, MAP_SCALE, MAP_SCALE,
+		                sprite, pos[i].x != tankX || pos[i].y != tankY);
+	}
+}
+
+static void save(int n) {
+	unsigned int x, y;
+
+	for(y=0; y<SIM_LCD_H; y++)
+		for(x=0; x<SIM_LCD_W; x++)
+			screen[n][y][x] = SIM_LcdPixel(x, y);
+}
+
+static unsigned int differences(int k, const GameState *g) {
+	unsigned int x, y, n = 0;
+
+	for(y=0; y<SIM_LCD_H; y++) {
+		for(x=0; x<SIM_LCD_W; x++) {
+			if(x/MAP_SCALE == g->x && y/MAP_SCALE == g->y)
+				continue;
+			n += screen[k][y][x] != SIM_LcdPixel(x, y);
+		}
+	}
+	return n;
+}
+
+static void row(const char *name, const COST *c) {
+	printf(" %-8s %6llu B %4llu cs %8.1f us", name, (unsigned long long)c->bytes,
+	       (unsigned long long)c->cs, c->ns/1000.0);
+}
+
+static void start(GameState *g) {
+	int s;
+
+	mapPrint();
+	Game_Init(g);
+	for(s=0; s<MINE_SETS; s++)
+		setState(g, s, INVIS);
+	redraw(g);
+}
+
+static void sum(COST *t, const COST *c) {
+	t->bytes += c->bytes;
+	t->cs += c->cs;
+	t->ns += c->ns;
+}
+
+static void body(void) {
+	static const MineState next[] = {PRIMED, EXP, INVIS};
+	static COST mine[MINE_SETS*3], run[MINE_SETS*3], fb[MINE_SETS*3];
+	GameState g;
+	COST tMine = {0}, tRun = {0}, tFb = {0}, moveMine, moveRun;
+	MineState from;
+	int s, i, n;
+
+	spriteInit();
+	mapCharacsInit();
+	lcdInit();
+	mineSpriteInit();
+	sceneInit();
+
+	// Straight to the LCD
+	start(&g);
+	for(n=0, s=0; s<MINE_SETS; s++) {
+		for(i=0; i<3; i++, n++) {
+			from = g.mines[s];
+
+			setState(&g, s, next[i]);
+			costStart();
+			redraw(&g);
+			run[n] = costEnd();
+			save(n);
+
+			// Back to the old state, then per mine
+			setState(&g, s, from);
+			redraw(&g);
+			setState(&g, s, next[i]);
+			costStart();
+			perMine(&g, s);
+			mine[n] = costEnd();
+			CHECK(differences(n, &g) == 0);
+			redraw(&g);
+		}
+	}
+
+	// Tank move: blocks at the old and new cell plus the primed set,
+	// against the cells that changed
+	setState(&g, 0, PRIMED);
+	redraw(&g);
+	g.y--;
+	costStart();
+	GLCD_FillRect(g.x*MAP_SCALE, (g.y+1)*MAP_SCALE, MAP_SCALE, MAP_SCALE, Black);
+	tankPrint(g.x, g.y, g.dir);
+	perMine(&g, 0);
+	moveMine = costEnd();
+	g.y++;
+	redraw(&g);
+	g.y--;
+	costStart();
+	redraw(&g);
+	moveRun = costEnd();
+	CHECK(moveRun.bytes < moveMine.bytes);
+	g.y++;
+	setState(&g, 0, INVIS);
+	redraw(&g);
+
+	// Through the frame buffer
+	GLCD_Clear(Black);
+	sceneInit();
+	GLCD_FB_Enable(1);
+	start(&g);
+	GLCD_FB_Flush();
+	for(n=0, s=0; s<MINE_SETS; s++) {
+		for(i=0; i<3; i++, n++) {
+			setState(&g, s, next[i]);
+			costStart();
+			redraw(&g);
+			GLCD_FB_Flush();
+			fb[n] = costEnd();
+			CHECK(differences(n, &g) == 0);
+		}
+	}
+	GLCD_FB_Enable(0);
+
+	printf("bench_minesets: one set changes, the others are invisible\n");
+	for(n=0, s=0; s<MINE_SETS; s++) {
+		from = INVIS;
+		for(i=0; i<3; i++, n++) {
+			printf("  set %d %-6s -> %-6s", s+1, stateNames[from], stateNames[next[i]]);
+			row("per mine", &mine[n]);
+			row("runs", &run[n]);
+			row("runs+fb", &fb[n]);
+			printf("\n");
+			from = next[i];
+			sum(&tMine, &mine[n]);
+			sum(&tRun, &run[n]);
+			sum(&tFb, &fb[n]);
+		}
+	}
+
+	printf("  all %d transitions:      ", n);
+	row("per mine", &tMine);
+	row("runs", &tRun);
+	row("runs+fb", &tFb);
+	printf("\n");
+	printf("  tank move, set 1 primed: ");
+	row("per mine", &moveMine);
+	row("runs", &moveRun);
+	printf("\n");
+	CHECK(SIM_LcdErrors() == 0);
+}
+
+int main(void) {
+	int r = SIM_Run(body, 60*SIM_S);
+
+	CHECK(r == 0);
+	if(failed) {
+		printf("%d check(s) failed\n", failed);
+		return 1;
+	}
+	return 0;
+}
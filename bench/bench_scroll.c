@@ -0,0 +1,144 @@
+// Console lines per second through print_string (user-014)
+//
+// Streams the same text through GLCD_Scroll.c print_string and through a
+// reference console that scrolls the way refresh_lcd used to: GLCD_Clear,
+// then every window line drawn again. Both use the 16x24 font on a 20x10
+// window, so every line after the first ten scrolls.
+//
+// The lines differ only in their numbers, like most log output, so
+// print_string, which redraws only the characters that change on screen,
+// should need a fraction of the SSP1 traffic of a full redraw.
+//
+// Prints simulated lines per second and SSP1 bytes per line, and fails if
+// the two leave different screens, print_string is not faster or it sends
+// a quarter of the bytes of the reference or more.
+
+#include <stdio.h>
+#include <string.h>
+#include "GLCD.h"
+#include "GLCD_Scroll.h"
+#include "sim.h"
+
+#define LINES    (16)
+
+typedef struct {
+	uint64_t ns;
+	uint64_t bytes;
+} COST;
+
+static int failed = 0;
+
+#define CHECK(c) do { if(!(c)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #c); failed++; } } while(0)
+
+static uint16_t screen[SIM_LCD_H][SIM_LCD_W];
+static char text[LINES][LCD_WIDTH + 1];
+static uint64_t t0;
+
+// Reference console: the last LCD_HEIGTH lines, the bottom one being written
+static unsigned char refLines[LCD_HEIGTH][LCD_WIDTH + 1];
+static int refRow = 0, refCol = 0;
+
+static void costStart(void) {
+	SIM_SspStats(0, 1);
+	t0 = SIM_Now();
+}
+
+static COST costEnd(void) {
+	SIM_SSP_STATS st;
+	COST c;
+
+	SIM_SspStats(&st, 1);
+	c.ns = SIM_Now() - t0;
+	c.bytes = st.bytes;
+	return c;
+}
+
+static void refNewLine(void) {
+	int i;
+
+	refCol = 0;
+	if(refRow < LCD_HEIGTH - 1) {
+		refRow++;
+		return;
+	}
+	memmove(refLines[0], refLines[1], sizeof(refLines[0])*(LCD_HEIGTH - 1));
+	memset(refLines[LCD_HEIGTH - 1], 0, sizeof(refLines[0]));
+	GLCD_Clear(BGC);
+	for(i=0; i<LCD_HEIGTH - 1; i++)
+		GLCD_DisplayString(i, 0, FONT_SIZE, refLines[i]);
+}
+
+static void refPrint(const char *s) {
+	for(; *s; s++) {
+		if(refCol >= LCD_WIDTH)
+			refNewLine();
+		if(*s == '\n') {
+			refCol = LCD_WIDTH;
+			continue;
+		}
+		GLCD_DisplayChar(refRow, refCol, FONT_SIZE, *s);
+		refLines[refRow][refCol++] = *s;
+	}
+}
+
+static void save(void) {
+	unsigned int x, y;
+
+	for(y=0; y<SIM_LCD_H; y++)
+		for(x=0; x<SIM_LCD_W; x++)
+			screen[y][x] = SIM_LcdPixel(x, y);
+}
+
+static unsigned int differences(void) {
+	unsigned int x, y, n = 0;
+
+	for(y=0; y<SIM_LCD_H; y++)
+		for(x=0; x<SIM_LCD_W; x++)
+			n += screen[y][x] != SIM_LcdPixel(x, y);
+	return n;
+}
+
+static void row(const char *name, const COST *c) {
+	printf("  %-12s %8.1f ms %7.1f lines/s %8.0f B/line\n", name, c->ns/1e6,
+	       LINES*1e9/c->ns, (double)c->bytes/LINES);
+}
+
+static void body(void) {
+	COST ref, cur;
+	int i;
+
+	for(i=0; i<LINES; i++)
+		snprintf(text[i], sizeof(text[i]), "line %3d of %d\n", i, LINES);
+
+	init_scroll();
+	costStart();
+	for(i=0; i<LINES; i++)
+		refPrint(text[i]);
+	ref = costEnd();
+	save();
+
+	init_scroll();
+	costStart();
+	for(i=0; i<LINES; i++)
+		print_string((unsigned char *)text[i]);
+	cur = costEnd();
+	CHECK(differences() == 0);
+	CHECK(cur.ns < ref.ns);
+	CHECK(cur.bytes < ref.bytes/4);
+	CHECK(SIM_LcdErrors() == 0);
+
+	printf("bench_scroll: %d lines through a %dx%d console\n", LINES, LCD_WIDTH, LCD_HEIGTH);
+	row("clear+redraw", &ref);
+	row("print_string", &cur);
+}
+
+int main(void) {
+	int r = SIM_Run(body, 60*SIM_S);
+
+	CHECK(r == 0);
+	if(failed) {
+		printf("%d check(s) failed\n", failed);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,165 @@
+// SSP1 cost of one 16x16 map tile (user-001)
+//
+// Draws the same tile three ways on the simulated board, frame buffer off:
+//
+//   putpixel   256 GLCD_PutPixel calls, each with all 8 window registers
+//              written, as blockPrint/blockClear did before GLCD_FillRect
+//   fillrect   GLCD_FillRect, one window and one burst (blockClear)
+//   blittile   GLCD_BlitTile, one window and one burst (blockPrint)
+//
+// The driver now keeps a shadow of the window registers, so PutPixel alone
+// would skip the unchanged ones. The putpixel rows force all 8 to be written
+// by invalidating the shadow with GLCD_WrReg before each pixel, and take the
+// cost of that GLCD_WrReg (measured on its own) off the total.
+//
+// Prints bytes, chip select assertions and simulated time per tile, and
+// fails if the drawings differ in GRAM or the burst is not cheaper.
+
+#include <stdio.h>
+#include "GLCD.h"
+#include "sim.h"
+
+#define X0    (64)
+#define Y0    (32)
+
+typedef struct {
+	uint64_t bytes;
+	uint64_t cs;
+	uint64_t ns;
+} COST;
+
+static int failed = 0;
+
+#define CHECK(c) do { if(!(c)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #c); failed++; } } while(0)
+
+static unsigned short tile[GLCD_TILE*GLCD_TILE];
+static uint16_t gram[GLCD_TILE][GLCD_TILE];
+
+static uint64_t t0;
+
+static void costStart(void) {
+	SIM_SspStats(0, 1);
+	t0 = SIM_Now();
+}
+
+static COST costEnd(void) {
+	SIM_SSP_STATS st;
+	COST c;
+
+	SIM_SspStats(&st, 1);
+	c.bytes = st.bytes;
+	c.cs = st.csAsserts;
+	c.ns = SIM_Now() - t0;
+	return c;
+}
+
+static void costSub(COST *a, const COST *b, unsigned int n) {
+	a->bytes -= b->bytes*n;
+	a->cs -= b->cs*n;
+	a->ns -= b->ns*n;
+}
+
+static void save(void) {
+	unsigned int x, y;
+
+	for(y=0; y<GLCD_TILE; y++)
+		for(x=0; x<GLCD_TILE; x++)
+			gram[y][x] = SIM_LcdPixel(X0 + x, Y0 + y);
+}
+
+static unsigned int differences(void) {
+	unsigned int x, y, n = 0;
+
+	for(y=0; y<GLCD_TILE; y++)
+		for(x=0; x<GLCD_TILE; x++)
+			n += gram[y][x] != SIM_LcdPixel(X0 + x, Y0 + y);
+	return n;
+}
+
+// Pixel by pixel with every window register written, minus the GLCD_WrReg
+// that invalidates the shadow
+static COST putPixels(const unsigned short *colors, const COST *wrReg) {
+	unsigned int x, y;
+	COST c;
+
+	costStart();
+	for(y=0; y<GLCD_TILE; y++) {
+		for(x=0; x<GLCD_TILE; x++) {
+			GLCD_WrReg(0x02, (X0 + x) >> 8);
+			GLCD_SetTextColor(colors[y*GLCD_TILE + x]);
+			GLCD_PutPixel(X0 + x, Y0 + y);
+		}
+	}
+	c = costEnd();
+	costSub(&c, wrReg, GLCD_TILE*GLCD_TILE);
+	return c;
+}
+
+static void row(const char *name, const COST *c, const COST *ref) {
+	printf("  %-10s %6llu B %5llu cs %9.1f us", name, (unsigned long long)c->bytes,
+	       (unsigned long long)c->cs, c->ns/1000.0);
+	if(ref)
+		printf("   %5.1fx fewer bytes, %5.1fx faster", (double)ref->bytes/c->bytes, (double)ref->ns/c->ns);
+	printf("\n");
+}
+
+static void body(void) {
+	static unsigned short flat[GLCD_TILE*GLCD_TILE];
+	COST wrReg, before, after;
+	unsigned int i;
+
+	// A wall block: filled square with a one pixel gap on the right and bottom
+	for(i=0; i<GLCD_TILE*GLCD_TILE; i++) {
+		flat[i] = Navy;
+		tile[i] = (i % GLCD_TILE == GLCD_TILE-1 || i / GLCD_TILE == GLCD_TILE-1) ? Navy : Maroon;
+	}
+
+	GLCD_Init();
+	GLCD_Clear(Black);
+
+	costStart();
+	GLCD_WrReg(0x02, 0);
+	wrReg = costEnd();
+
+	printf("bench_tile: one %dx%d tile, frame buffer off\n", GLCD_TILE, GLCD_TILE);
+
+	// blockClear
+	before = putPixels(flat, &wrReg);
+	save();
+	GLCD_Clear(Black);
+	costStart();
+	GLCD_FillRect(X0, Y0, GLCD_TILE, GLCD_TILE, Navy);
+	after = costEnd();
+	CHECK(differences() == 0);
+	CHECK(after.bytes < before.bytes);
+	printf(" clear:\n");
+	row("putpixel", &before, 0);
+	row("fillrect", &after, &before);
+
+	// blockPrint
+	GLCD_Clear(Black);
+	before = putPixels(tile, &wrReg);
+	save();
+	GLCD_Clear(Black);
+	costStart();
+	GLCD_BlitTile(X0, Y0, tile);
+	after = costEnd();
+	CHECK(differences() == 0);
+	CHECK(after.bytes < before.bytes);
+	printf(" print:\n");
+	row("putpixel", &before, 0);
+	row("blittile", &after, &before);
+
+	CHECK(SIM_LcdErrors() == 0);
+}
+
+int main(void) {
+	int r = SIM_Run(body, 10*SIM_S);
+
+	CHECK(r == 0);
+	if(failed) {
+		printf("%d check(s) failed\n", failed);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,184 @@
+// Board hardware abstraction for the host build (HAL_HOST, see host/sim.h)
+//
+// The joystick lines and the push button follow a script set up with
+// SIM_JoyAt and SIM_ButtonAt. The joystick is debounced exactly as in
+// hal.c, from a TIMER1 interrupt every HAL_JOY_SAMPLE_US of simulated time,
+// and the button pulses EINT3 when pressed. The time base, the one-shot
+// wake-up of HAL_WakeupIn and the sleep counter run on the simulated clock.
+
+#include <stdint.h>
+#include "LPC17xx.h"
+#include "hal.h"
+#include "sim.h"
+
+#define BUTTON_HOLD_NS  (50*SIM_MS)
+
+// Time spent in HAL_Sleep, in nanoseconds
+static uint64_t sleepNs = 0;
+
+static uint32_t joyLines = 0;       // scripted lines, 1 = pressed
+static uint8_t  buttonDown = 0;
+static uint8_t  ledValue = 0;
+static uint8_t  joyOn = 0;
+
+// TIMER1 interrupt flags as in LPC_TIM1->IR: match 0 wake-up, match 1 sample
+static uint32_t timerIr = 0;
+static int wakeEventId = 0;
+
+// Debounced joystick state and its change events, as in hal.c
+static uint32_t joyRaw = 0;
+static uint8_t  joyStable = 0;
+static volatile uint32_t joyState = 0;
+static uint32_t joyQueue[HAL_JOY_QUEUE];
+static volatile uint32_t joyHead = 0, joyTail = 0;
+
+void HAL_Init(void) {
+	SystemInit();
+}
+
+void HAL_LedInit(void) {
+	ledValue = 0;
+}
+
+void HAL_LedWrite(uint8_t num) {
+	SIM_Advance(4*SIM_IO_NS);
+	ledValue = num;
+}
+
+uint8_t SIM_Led(void) {
+	return ledValue;
+}
+
+static void joySampleEvent(void *arg) {
+	timerIr |= 0x2;
+	SIM_IrqPulse(TIMER1_IRQn);
+	SIM_At(SIM_Now() + HAL_JOY_SAMPLE_US*1000ULL, joySampleEvent, 0);
+}
+
+void HAL_JoystickInit(void) {
+	HAL_TimerInit();
+	if(!joyOn)
+		SIM_At(SIM_Now() + HAL_JOY_SAMPLE_US*1000ULL, joySampleEvent, 0);
+	joyOn = 1;
+	NVIC_EnableIRQ(TIMER1_IRQn);
+}
+
+uint32_t HAL_JoystickRead(void) {
+	SIM_Advance(SIM_IO_NS);
+	return joyLines & HAL_JOY_ALL;
+}
+
+uint32_t HAL_JoystickState(void) {
+	return joyState;
+}
+
+uint8_t HAL_JoystickEvent(uint32_t *state) {
+	uint32_t tail = joyTail;
+
+	if(tail == joyHead)
+		return 0;
+	*state = joyQueue[tail & (HAL_JOY_QUEUE - 1)];
+	joyTail = tail + 1;
+	return 1;
+}
+
+static void joySample(void) {
+	uint32_t raw = HAL_JoystickRead();
+
+	if(raw != joyRaw) {
+		joyRaw = raw;
+		joyStable = 0;
+		return;
+	}
+	if(joyStable >= HAL_JOY_STABLE)
+		return;
+	if(++joyStable == HAL_JOY_STABLE && raw != joyState) {
+		joyState = raw;
+		if(joyHead - joyTail < HAL_JOY_QUEUE) {
+			joyQueue[joyHead & (HAL_JOY_QUEUE - 1)] = raw;
+			joyHead++;
+		}
+	}
+}
+
+static void joyEvent(void *arg) {
+	joyLines = (uint32_t)(uintptr_t)arg;
+}
+
+void SIM_JoyAt(uint64_t t, uint32_t lines) {
+	SIM_At(t, joyEvent, (void *)(uintptr_t)lines);
+}
+
+void HAL_ButtonInit(void) {
+	NVIC_EnableIRQ(EINT3_IRQn);
+}
+
+uint8_t HAL_ButtonRead(void) {
+	SIM_Advance(SIM_IO_NS);
+	return buttonDown;
+}
+
+void HAL_ButtonIntClear(void) {
+	SIM_Advance(SIM_IO_NS);
+}
+
+static void buttonEvent(void *arg) {
+	buttonDown = arg != 0;
+	if(buttonDown)
+		SIM_IrqPulse(EINT3_IRQn);
+}
+
+// Falling edge on P2.10, released again after BUTTON_HOLD_NS
+void SIM_ButtonAt(uint64_t t) {
+	SIM_At(t, buttonEvent, (void *)1);
+	SIM_At(t + BUTTON_HOLD_NS, buttonEvent, 0);
+}
+
+// The time base is the simulated clock
+void HAL_TimerInit(void) {
+}
+
+uint32_t HAL_TimerUs(void) {
+	SIM_Advance(SIM_IO_NS);
+	return (uint32_t)(SIM_Now()/1000);
+}
+
+void HAL_Sleep(void) {
+	uint64_t t0 = SIM_Now();
+
+	__WFI();
+	sleepNs += SIM_Now() - t0;
+}
+
+static void wakeEvent(void *arg) {
+	wakeEventId = 0;
+	timerIr |= 0x1;
+	SIM_IrqPulse(TIMER1_IRQn);
+}
+
+void HAL_WakeupIn(uint32_t us) {
+	SIM_Advance(3*SIM_IO_NS);
+	if(wakeEventId)
+		SIM_Cancel(wakeEventId);
+	timerIr &= ~0x1;
+	wakeEventId = us ? SIM_At(SIM_Now() + us*1000ULL, wakeEvent, 0) : 0;
+	NVIC_EnableIRQ(TIMER1_IRQn);
+}
+
+uint32_t HAL_SleepUs(uint8_t reset) {
+	uint32_t us = (uint32_t)(sleepNs/1000);
+
+	// Keep the part below a microsecond, so the reports add up
+	if(reset)
+		sleepNs -= us*1000ULL;
+	return us;
+}
+
+void TIMER1_IRQHandler(void) {
+	uint32_t ir = timerIr;
+
+	timerIr &= ~ir;
+	SIM_Advance(2*SIM_IO_NS);
+	if(ir & 0x2)
+		joySample();
+}
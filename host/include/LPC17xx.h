@@ -0,0 +1,157 @@
+// LPC17xx device header for the host build (HAL_HOST)
+//
+// Same names as the CMSIS header the Keil build uses, but every peripheral
+// is a plain struct in host memory. Registers with side effects are reached
+// through IO_RD/IO_WR (hal_io.h) and modelled in host/sim_*.c, the rest are
+// plain variables. Only the peripherals and fields the firmware touches are
+// declared. Register unions of the real header are separate fields here, so
+// e.g. DLM and IER do not overwrite each other.
+
+#ifndef _HOST_LPC17XX_H
+#define _HOST_LPC17XX_H
+
+#include <stdint.h>
+
+#define __I     volatile
+#define __O     volatile
+#define __IO    volatile
+
+typedef enum IRQn {
+	SysTick_IRQn   = -1,
+	TIMER1_IRQn    = 2,
+	UART0_IRQn     = 5,
+	UART1_IRQn     = 6,
+	EINT3_IRQn     = 21,
+	DMA_IRQn       = 26
+} IRQn_Type;
+
+typedef struct {
+	__IO uint32_t FIODIR;
+	__IO uint32_t FIOMASK;
+	__IO uint32_t FIOPIN;
+	__IO uint32_t FIOSET;
+	__O  uint32_t FIOCLR;
+} LPC_GPIO_TypeDef;
+
+typedef struct {
+	__IO uint32_t PINSEL0, PINSEL1, PINSEL2, PINSEL3, PINSEL4;
+	__IO uint32_t PINSEL5, PINSEL6, PINSEL7, PINSEL8, PINSEL9, PINSEL10;
+	__IO uint32_t PINMODE0, PINMODE1, PINMODE2, PINMODE3, PINMODE4;
+	__IO uint32_t PINMODE5, PINMODE6, PINMODE7, PINMODE8, PINMODE9;
+} LPC_PINCON_TypeDef;
+
+typedef struct {
+	__IO uint32_t IntStatus;
+	__I  uint32_t IO0IntStatR, IO0IntStatF;
+	__O  uint32_t IO0IntClr;
+	__IO uint32_t IO0IntEnR, IO0IntEnF;
+	__I  uint32_t IO2IntStatR, IO2IntStatF;
+	__O  uint32_t IO2IntClr;
+	__IO uint32_t IO2IntEnR, IO2IntEnF;
+} LPC_GPIOINT_TypeDef;
+
+typedef struct {
+	__IO uint32_t PCONP;
+	__IO uint32_t PCLKSEL0;
+	__IO uint32_t PCLKSEL1;
+	__IO uint32_t PCON;
+} LPC_SC_TypeDef;
+
+typedef struct {
+	__IO uint32_t CR0;
+	__IO uint32_t CR1;
+	__IO uint32_t DR;
+	__I  uint32_t SR;
+	__IO uint32_t CPSR;
+	__IO uint32_t IMSC;
+	__IO uint32_t RIS;
+	__IO uint32_t MIS;
+	__O  uint32_t ICR;
+	__IO uint32_t DMACR;
+} LPC_SSP_TypeDef;
+
+typedef struct {
+	__I  uint8_t  RBR;
+	__O  uint8_t  THR;
+	__IO uint8_t  DLL;
+	__IO uint8_t  DLM;
+	__IO uint32_t IER;
+	__I  uint32_t IIR;
+	__O  uint8_t  FCR;
+	__IO uint8_t  LCR;
+	__I  uint8_t  LSR;
+	__IO uint8_t  SCR;
+	__IO uint32_t TER;
+} LPC_UART_TypeDef;
+
+typedef LPC_UART_TypeDef LPC_UART0_TypeDef;
+typedef LPC_UART_TypeDef LPC_UART1_TypeDef;
+
+typedef struct {
+	__I  uint32_t DMACIntStat;
+	__I  uint32_t DMACIntTCStat;
+	__O  uint32_t DMACIntTCClear;
+	__I  uint32_t DMACIntErrStat;
+	__O  uint32_t DMACIntErrClr;
+	__I  uint32_t DMACRawIntTCStat;
+	__I  uint32_t DMACRawIntErrStat;
+	__I  uint32_t DMACEnbldChns;
+	__IO uint32_t DMACConfig;
+	__IO uint32_t DMACSync;
+} LPC_GPDMA_TypeDef;
+
+typedef struct {
+	__IO uint32_t DMACCSrcAddr;
+	__IO uint32_t DMACCDestAddr;
+	__IO uint32_t DMACCLLI;
+	__IO uint32_t DMACCControl;
+	__IO uint32_t DMACCConfig;
+} LPC_GPDMACH_TypeDef;
+
+extern LPC_GPIO_TypeDef    SIM_GPIO0, SIM_GPIO1, SIM_GPIO2, SIM_GPIO4;
+extern LPC_PINCON_TypeDef  SIM_PINCON;
+extern LPC_GPIOINT_TypeDef SIM_GPIOINT;
+extern LPC_SC_TypeDef      SIM_SC;
+extern LPC_SSP_TypeDef     SIM_SSP1;
+extern LPC_UART_TypeDef    SIM_UART0, SIM_UART1;
+extern LPC_GPDMA_TypeDef   SIM_GPDMA;
+extern LPC_GPDMACH_TypeDef SIM_GPDMACH0;
+
+#define LPC_GPIO0       (&SIM_GPIO0)
+#define LPC_GPIO1       (&SIM_GPIO1)
+#define LPC_GPIO2       (&SIM_GPIO2)
+#define LPC_GPIO4       (&SIM_GPIO4)
+#define LPC_PINCON      (&SIM_PINCON)
+#define LPC_GPIOINT     (&SIM_GPIOINT)
+#define LPC_SC          (&SIM_SC)
+#define LPC_SSP1        (&SIM_SSP1)
+#define LPC_UART0       (&SIM_UART0)
+#define LPC_UART1       (&SIM_UART1)
+#define LPC_GPDMA       (&SIM_GPDMA)
+#define LPC_GPDMACH0    (&SIM_GPDMACH0)
+
+// Core: interrupt controller, PRIMASK and exclusive access (host/sim_core.c)
+void     NVIC_EnableIRQ(IRQn_Type irq);
+void     NVIC_DisableIRQ(IRQn_Type irq);
+void     __disable_irq(void);
+void     __enable_irq(void);
+uint32_t SIM_Ldrex(volatile void *addr, unsigned int size);
+uint32_t SIM_Strex(uint32_t val, volatile void *addr, unsigned int size);
+void     __WFI(void);
+#define  __NOP()        ((void)0)
+
+// Exclusive access of the object size, uart.c uses the word intrinsics on
+// byte locks
+#define  __LDREXW(p)    SIM_Ldrex((p), sizeof(*(p)))
+#define  __STREXW(v, p) SIM_Strex((v), (p), sizeof(*(p)))
+
+// Debug output (ITM), goes to stdout
+#define ITM_RXBUFFER_EMPTY 0x5AA55AA5
+uint32_t ITM_SendChar(uint32_t ch);
+int32_t  ITM_ReceiveChar(void);
+int32_t  ITM_CheckChar(void);
+
+extern uint32_t SystemCoreClock;
+void     SystemInit(void);
+
+#endif /* _HOST_LPC17XX_H */
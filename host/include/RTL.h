@@ -0,0 +1,61 @@
+// RTX kernel interface for the host build (HAL_HOST)
+//
+// The subset of the RL-ARM RTL.h the firmware calls, with the same types,
+// return codes and timeout conventions. host/rtx_host.c implements it with
+// cooperative tasks on the simulated clock (see host/sim.h).
+
+#ifndef _HOST_RTL_H
+#define _HOST_RTL_H
+
+#include <stdint.h>
+
+typedef uint8_t  U8;
+typedef uint16_t U16;
+typedef uint32_t U32;
+typedef int32_t  S32;
+typedef uint8_t  BIT;
+typedef uint32_t BOOL;
+
+#define __TRUE          1
+#define __FALSE         0
+
+typedef U32 OS_TID;
+typedef U32 OS_RESULT;
+typedef U32 OS_MUT[3];
+
+#define OS_R_TMO        0x01
+#define OS_R_EVT        0x02
+#define OS_R_SEM        0x03
+#define OS_R_MBX        0x04
+#define OS_R_MUT        0x05
+#define OS_R_OK         0x00
+#define OS_R_NOK        0xFF
+
+#define __task
+
+void      os_sys_init(void (*task)(void));
+OS_TID    os_tsk_create(void (*task)(void), U8 priority);
+void      os_tsk_delete_self(void);
+OS_RESULT os_tsk_delete(OS_TID task_id);
+OS_TID    os_tsk_self(void);
+OS_RESULT os_tsk_prio_self(U8 new_prio);
+OS_RESULT os_tsk_pass(void);
+void      tsk_lock(void);
+void      tsk_unlock(void);
+
+OS_RESULT os_evt_wait_or(U16 wait_flags, U16 timeout);
+void      os_evt_set(U16 event_flags, OS_TID task_id);
+void      isr_evt_set(U16 event_flags, OS_TID task_id);
+void      os_evt_clr(U16 clear_flags, OS_TID task_id);
+U16       os_evt_get(void);
+
+void      os_mut_init(OS_MUT *mutex);
+OS_RESULT os_mut_wait(OS_MUT *mutex, U16 timeout);
+OS_RESULT os_mut_release(OS_MUT *mutex);
+
+void      os_dly_wait(U16 delay_time);
+void      os_itv_set(U16 interval_time);
+void      os_itv_wait(void);
+U32       os_time_get(void);
+
+#endif /* _HOST_RTL_H */
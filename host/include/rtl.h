@@ -0,0 +1,2 @@
+// Lower case name used by some of the firmware sources
+#include "RTL.h"
@@ -0,0 +1,570 @@
+// RTX kernel calls (RTL.h) for the host build
+//
+// Tasks are ucontext coroutines scheduled the way RTX 4 does with the
+// settings of RTX_config.c: the highest priority ready task runs, equal
+// priorities take turns every OS_ROBINTOUT ticks of OS_TICK, and with no
+// task ready the idle demon sleeps in HAL_Sleep, with the tick interrupt
+// off until the earliest timeout (OS_TICKLESS). A running task only loses
+// the CPU in a kernel call or at a preemption point of the simulation
+// (register access, interrupt return, see sim.h).
+//
+// Every kernel call costs SIM_OS_NS and every task switch SIM_SWITCH_NS.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+#include "LPC17xx.h"
+#include "RTL.h"
+#include "hal.h"
+#include "sim.h"
+
+#if defined(__SANITIZE_ADDRESS__)
+#define RTX_ASAN 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define RTX_ASAN 1
+#endif
+#endif
+#ifdef RTX_ASAN
+#include <sanitizer/common_interface_defs.h>
+#endif
+
+// Same as RTX_config.c
+#define OS_TASKCNT     (6)
+#define OS_TICK        (10000)      // us
+#define OS_ROBINTOUT   (5)
+#define OS_TICKLESS    (1)
+
+// Host stacks are much larger than OS_STKSIZE, libc calls need the room
+#define RTX_STACK      (256*1024)
+#define RTX_INFINITE   (0xFFFF)
+
+enum { T_FREE, T_READY, T_RUN, T_WAIT_DLY, T_WAIT_ITV, T_WAIT_EVT, T_WAIT_MUT, T_DONE };
+
+typedef struct {
+	ucontext_t ctx;
+	void *stack;
+	void (*entry)(void);
+	uint8_t state;
+	uint8_t prio;               // current priority, raised by inheritance
+	uint8_t basePrio;
+	uint32_t seq;               // order of arrival within a priority
+	U16 events, waits;
+	uint8_t timed;
+	uint32_t timeout;           // tick a timed wait ends on
+	uint32_t itvNext, itvPeriod;
+	OS_MUT *mut;                // mutex waited for
+	OS_RESULT result;
+} TCB;
+
+static TCB tcb[OS_TASKCNT + 1];     // index is the task id, 0 unused
+static TCB *run = 0;                // running task, 0 on the scheduler stack
+static ucontext_t schedCtx;
+static uint32_t osTime = 0;
+static uint32_t seqNext = 0;
+static uint32_t sliceStart = 0;
+static int robinDue = 0;
+static int locked = 0;
+static int leaving = 0;
+static uint64_t tickNs = 0;         // time of the last tick
+static int tickOff = 0;             // tick interrupt off, see idle()
+static uint32_t ticksOff = 0;       // ticks that passed meanwhile
+static SIM_RTX_STATS st;
+
+#ifdef RTX_ASAN
+static const void *mainStack;
+static size_t mainStackSize;
+#endif
+
+static void rtxCall(void) {
+	st.calls++;
+	SIM_Advance(SIM_OS_NS);
+}
+
+static OS_TID tidOf(TCB *t) {
+	return t ? (OS_TID)(t - tcb) : 0;
+}
+
+static TCB *task(OS_TID id) {
+	if(id < 1 || id > OS_TASKCNT || tcb[id].state == T_FREE || tcb[id].state == T_DONE)
+		return 0;
+	return &tcb[id];
+}
+
+// Highest priority ready task, first come first served within a priority
+static TCB *pick(void) {
+	TCB *best = 0;
+	int i;
+
+	for(i=1; i<=OS_TASKCNT; i++) {
+		if(tcb[i].state != T_READY)
+			continue;
+		if(!best || tcb[i].prio > best->prio ||
+		   (tcb[i].prio == best->prio && (int32_t)(tcb[i].seq - best->seq) < 0))
+			best = &tcb[i];
+	}
+	return best;
+}
+
+static void ready(TCB *t) {
+	t->state = T_READY;
+	t->seq = ++seqNext;
+}
+
+static void wake(TCB *t, OS_RESULT result) {
+	t->result = result;
+	t->timed = 0;
+	t->mut = 0;
+	ready(t);
+}
+
+// Back to the scheduler, returns when the task is picked again
+static void yield(void) {
+	TCB *self = run;
+#ifdef RTX_ASAN
+	void *fake = 0;
+
+	__sanitizer_start_switch_fiber(self->state == T_DONE ? 0 : &fake, mainStack, mainStackSize);
+#endif
+	swapcontext(&self->ctx, &schedCtx);
+#ifdef RTX_ASAN
+	__sanitizer_finish_switch_fiber(fake, &mainStack, &mainStackSize);
+#endif
+}
+
+static OS_RESULT block(uint8_t state, U16 timeout) {
+	TCB *self = run;
+
+	self->state = state;
+	self->timed = timeout != RTX_INFINITE;
+	self->timeout = osTime + timeout;
+	self->result = OS_R_TMO;
+	yield();
+	return self->result;
+}
+
+// Gives the CPU to a higher priority task, or to an equal one whose turn
+// has come
+static void dispatch(int robin) {
+	TCB *t;
+
+	if(!run || locked)
+		return;
+	t = pick();
+	if(t && (t->prio > run->prio || (robin && t->prio == run->prio))) {
+		ready(run);
+		yield();
+	}
+}
+
+void SIM_RtxPreempt(void) {
+	int robin = robinDue;
+
+	if(!run || locked)
+		return;
+	robinDue = 0;
+	dispatch(robin);
+}
+
+static void taskMain(void) {
+#ifdef RTX_ASAN
+	__sanitizer_finish_switch_fiber(0, &mainStack, &mainStackSize);
+#endif
+	run->entry();
+	os_tsk_delete_self();
+}
+
+static void release(TCB *t);
+
+static void taskEnd(TCB *t) {
+	release(t);
+	t->state = T_DONE;
+}
+
+static void runTask(TCB *t) {
+#ifdef RTX_ASAN
+	void *fake = 0;
+#endif
+
+	run = t;
+	t->state = T_RUN;
+	sliceStart = osTime;
+	robinDue = 0;
+#ifdef RTX_ASAN
+	__sanitizer_start_switch_fiber(&fake, t->stack, RTX_STACK);
+#endif
+	swapcontext(&schedCtx, &t->ctx);
+#ifdef RTX_ASAN
+	__sanitizer_finish_switch_fiber(fake, 0, 0);
+#endif
+	run = 0;
+}
+
+static int alive(void) {
+	int i;
+
+	for(i=1; i<=OS_TASKCNT; i++) {
+		if(tcb[i].state != T_FREE && tcb[i].state != T_DONE)
+			return 1;
+	}
+	return 0;
+}
+
+// The SysTick counter, it keeps running while the interrupt is off
+static void tickEvent(void *arg) {
+	tickNs = SIM_Now();
+	if(tickOff)
+		ticksOff++;
+	else
+		SIM_IrqPulse(SysTick_IRQn);
+	SIM_At(SIM_Now() + OS_TICK*1000ULL, tickEvent, 0);
+}
+
+void SysTick_Handler(void) {
+	int i;
+	TCB *t;
+
+	osTime++;
+	st.ticks++;
+	for(i=1; i<=OS_TASKCNT; i++) {
+		t = &tcb[i];
+		if(t->timed && t->state > T_RUN && t->state < T_DONE &&
+		   (int32_t)(osTime - t->timeout) >= 0) {
+			if(t->state == T_WAIT_DLY || t->state == T_WAIT_ITV)
+				wake(t, OS_R_OK);
+			else
+				wake(t, OS_R_TMO);
+		}
+	}
+	if(run && osTime - sliceStart >= OS_ROBINTOUT) {
+		sliceStart = osTime;
+		robinDue = 1;
+	}
+}
+
+// Ticks until the earliest timeout, RTX_INFINITE if no task waits with one
+static uint32_t nextTimeout(void) {
+	uint32_t next = RTX_INFINITE, ticks;
+	int i;
+
+	for(i=1; i<=OS_TASKCNT; i++) {
+		if(tcb[i].timed && tcb[i].state > T_RUN && tcb[i].state < T_DONE) {
+			ticks = tcb[i].timeout - osTime;
+			if(ticks < next)
+				next = ticks;
+		}
+	}
+	return next;
+}
+
+// Idle demon as in RTX_config.c. With OS_TICKLESS the tick interrupt is off
+// until the earliest timeout, interrupts that ready no task only end one
+// HAL_Sleep. Then all but the last missed tick go into the kernel time
+// here, and the last one through the tick handler, which readies the tasks
+// whose timeout ends.
+static void idle(void) {
+#if (OS_TICKLESS == 1)
+	uint32_t ticks = nextTimeout();
+	uint64_t wake;
+
+	if(ticks >= 2) {
+		tickOff = 1;
+		ticksOff = 0;
+		wake = tickNs + ticks*OS_TICK*1000ULL;
+		HAL_WakeupIn((wake - SIM_Now() + 999)/1000);
+		do {
+			HAL_Sleep();
+		} while(!pick() && ticksOff < ticks);
+		HAL_WakeupIn(0);
+		tickOff = 0;
+		if(ticksOff) {
+			osTime += ticksOff - 1;
+			SIM_IrqPulse(SysTick_IRQn);
+			SIM_Advance(0);
+		}
+		return;
+	}
+#endif
+	HAL_Sleep();                        // woken up by the next tick at most
+}
+
+// Scheduler and idle demon, runs on the stack of the caller (main)
+void os_sys_init(void (*task)(void)) {
+	uint64_t t0;
+	TCB *t;
+	int i;
+
+	SIM_At(SIM_Now() + OS_TICK*1000ULL, tickEvent, 0);
+	NVIC_EnableIRQ(SysTick_IRQn);
+	os_tsk_create(task, 1);
+
+	while(1) {
+		for(i=1; i<=OS_TASKCNT; i++) {
+			if(tcb[i].state == T_DONE) {
+				free(tcb[i].stack);
+				memset(&tcb[i], 0, sizeof(TCB));
+			}
+		}
+		t = pick();
+		if(!t) {
+			if(!alive())
+				SIM_Exit(0);
+			t0 = SIM_Now();
+			idle();
+			st.idleNs += SIM_Now() - t0;
+			continue;
+		}
+		runTask(t);
+		if(leaving)
+			SIM_Exit(0);
+		st.switches++;
+		SIM_Advance(SIM_SWITCH_NS);
+	}
+}
+
+int SIM_RtxLeave(void) {
+	if(!run)
+		return 0;
+	leaving = 1;
+	run->state = T_DONE;
+	yield();
+	return 1;
+}
+
+void SIM_RtxStats(SIM_RTX_STATS *s) {
+	*s = st;
+}
+
+OS_TID os_tsk_create(void (*task)(void), U8 priority) {
+	TCB *t = 0;
+	int i;
+
+	rtxCall();
+	for(i=1; i<=OS_TASKCNT && !t; i++) {
+		if(tcb[i].state == T_FREE)
+			t = &tcb[i];
+	}
+	if(!t)
+		return 0;
+
+	memset(t, 0, sizeof(TCB));
+	t->stack = malloc(RTX_STACK);
+	if(!t->stack) {
+		fprintf(stderr, "rtx: out of memory\n");
+		abort();
+	}
+	getcontext(&t->ctx);
+	t->ctx.uc_stack.ss_sp = t->stack;
+	t->ctx.uc_stack.ss_size = RTX_STACK;
+	t->ctx.uc_link = 0;
+	makecontext(&t->ctx, taskMain, 0);
+	t->entry = task;
+	t->prio = t->basePrio = priority ? priority : 1;
+	ready(t);
+	dispatch(0);
+	return tidOf(t);
+}
+
+void os_tsk_delete_self(void) {
+	rtxCall();
+	taskEnd(run);
+	yield();
+	// Never picked again
+	abort();
+}
+
+OS_RESULT os_tsk_delete(OS_TID task_id) {
+	TCB *t;
+
+	rtxCall();
+	if(run && task_id == tidOf(run))
+		os_tsk_delete_self();
+	t = task(task_id);
+	if(!t)
+		return OS_R_NOK;
+	taskEnd(t);
+	dispatch(0);
+	return OS_R_OK;
+}
+
+OS_TID os_tsk_self(void) {
+	return tidOf(run);
+}
+
+OS_RESULT os_tsk_prio_self(U8 new_prio) {
+	rtxCall();
+	if(run->prio == run->basePrio)
+		run->prio = new_prio;
+	run->basePrio = new_prio;
+	dispatch(0);
+	return OS_R_OK;
+}
+
+OS_RESULT os_tsk_pass(void) {
+	rtxCall();
+	dispatch(1);
+	return OS_R_OK;
+}
+
+// Scheduler lock, interrupts keep running (RTX stops the SysTick)
+void tsk_lock(void) {
+	locked = 1;
+}
+
+void tsk_unlock(void) {
+	locked = 0;
+	SIM_RtxPreempt();
+}
+
+static void evtSet(U16 flags, TCB *t) {
+	t->events |= flags;
+	if(t->state == T_WAIT_EVT && (t->events & t->waits)) {
+		t->waits &= t->events;
+		t->events &= ~t->waits;
+		wake(t, OS_R_EVT);
+	}
+}
+
+OS_RESULT os_evt_wait_or(U16 wait_flags, U16 timeout) {
+	rtxCall();
+	if(run->events & wait_flags) {
+		run->waits = run->events & wait_flags;
+		run->events &= ~run->waits;
+		return OS_R_EVT;
+	}
+	if(!timeout)
+		return OS_R_TMO;
+	run->waits = wait_flags;
+	return block(T_WAIT_EVT, timeout);
+}
+
+void os_evt_set(U16 event_flags, OS_TID task_id) {
+	TCB *t;
+
+	rtxCall();
+	if((t = task(task_id))) {
+		evtSet(event_flags, t);
+		dispatch(0);
+	}
+}
+
+// Wakes the task, the switch happens when the interrupt returns
+void isr_evt_set(U16 event_flags, OS_TID task_id) {
+	TCB *t;
+
+	rtxCall();
+	if((t = task(task_id)))
+		evtSet(event_flags, t);
+}
+
+void os_evt_clr(U16 clear_flags, OS_TID task_id) {
+	TCB *t;
+
+	rtxCall();
+	if((t = task(task_id)))
+		t->events &= ~clear_flags;
+}
+
+U16 os_evt_get(void) {
+	return run->waits;
+}
+
+// OS_MUT: owner task id, nesting level
+void os_mut_init(OS_MUT *mutex) {
+	rtxCall();
+	memset(*mutex, 0, sizeof(OS_MUT));
+}
+
+OS_RESULT os_mut_wait(OS_MUT *mutex, U16 timeout) {
+	TCB *owner;
+
+	rtxCall();
+	if(!(*mutex)[0]) {
+		(*mutex)[0] = tidOf(run);
+		(*mutex)[1] = 1;
+		return OS_R_OK;
+	}
+	if((*mutex)[0] == tidOf(run)) {
+		(*mutex)[1]++;
+		return OS_R_OK;
+	}
+	if(!timeout)
+		return OS_R_TMO;
+
+	// Priority inheritance
+	owner = &tcb[(*mutex)[0]];
+	if(owner->prio < run->prio)
+		owner->prio = run->prio;
+	run->mut = mutex;
+	return block(T_WAIT_MUT, timeout);
+}
+
+// Hands the mutex to the first of the highest priority waiters
+static void handOver(OS_MUT *mutex) {
+	TCB *w = 0;
+	int i;
+
+	for(i=1; i<=OS_TASKCNT; i++) {
+		if(tcb[i].state == T_WAIT_MUT && tcb[i].mut == mutex &&
+		   (!w || tcb[i].prio > w->prio || (tcb[i].prio == w->prio && (int32_t)(tcb[i].seq - w->seq) < 0)))
+			w = &tcb[i];
+	}
+	if(!w) {
+		(*mutex)[0] = 0;
+		(*mutex)[1] = 0;
+		return;
+	}
+	(*mutex)[0] = tidOf(w);
+	(*mutex)[1] = 1;
+	wake(w, OS_R_MUT);
+}
+
+OS_RESULT os_mut_release(OS_MUT *mutex) {
+	rtxCall();
+	if((*mutex)[0] != tidOf(run) || !(*mutex)[1])
+		return OS_R_NOK;
+	if(--(*mutex)[1])
+		return OS_R_OK;
+	run->prio = run->basePrio;
+	handOver(mutex);
+	dispatch(0);
+	return OS_R_OK;
+}
+
+// Mutexes of a deleted task are only found through its waiters
+static void release(TCB *t) {
+	OS_TID id = tidOf(t);
+	int i;
+
+	for(i=1; i<=OS_TASKCNT; i++) {
+		if(tcb[i].state == T_WAIT_MUT && tcb[i].mut && (*tcb[i].mut)[0] == id)
+			handOver(tcb[i].mut);
+	}
+}
+
+void os_dly_wait(U16 delay_time) {
+	rtxCall();
+	if(delay_time)
+		block(T_WAIT_DLY, delay_time);
+}
+
+void os_itv_set(U16 interval_time) {
+	rtxCall();
+	run->itvPeriod = interval_time;
+	run->itvNext = osTime + interval_time;
+}
+
+void os_itv_wait(void) {
+	int32_t delta;
+
+	rtxCall();
+	delta = (int32_t)(run->itvNext - osTime);
+	run->itvNext += run->itvPeriod;
+	if(delta > 0)
+		block(T_WAIT_ITV, delta);
+}
+
+U32 os_time_get(void) {
+	return osTime;
+}
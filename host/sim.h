@@ -0,0 +1,130 @@
+// Host simulation of the MCB1700 board (HAL_HOST build)
+//
+// The firmware sources are compiled for the host and linked against these
+// models instead of the LPC1768 and the RTX library:
+//
+//   sim_core.c   virtual clock, timed events, interrupt lines, register access
+//   sim_ssp.c    SSP1, GPDMA channel 0 and the LCD chip select on P0.6
+//   sim_lcd.c    HX8347-D LCD controller on SSP1
+//   sim_uart.c   UART0 and UART1
+//   rtx_host.c   RTX kernel calls (RTL.h) as cooperative tasks
+//   hal_host.c   hal.h with a scripted joystick and push button
+//
+// Time only advances when the firmware touches a peripheral register through
+// IO_RD/IO_WR (SIM_IO_NS per access), enters an interrupt, calls the kernel
+// or sleeps. The clock therefore measures bus, wire and wait time, not the
+// time the CPU spends in plain C code.
+//
+// Firmware statics cannot be reset, so a process runs one SIM_Run.
+
+#ifndef _SIM_H
+#define _SIM_H
+
+#include <stdint.h>
+
+// Costs charged to the virtual clock, in ns
+#define SIM_IO_NS        (50)     // one peripheral register access
+#define SIM_ISR_NS       (120)    // interrupt entry and exit
+#define SIM_OS_NS        (1000)   // one kernel call
+#define SIM_SWITCH_NS    (2000)   // task switch
+
+#define SIM_MS           (1000000ULL)
+#define SIM_S            (1000000000ULL)
+
+// Core
+typedef void (*SIM_EVENT)(void *arg);
+
+uint64_t SIM_Now(void);
+int      SIM_At(uint64_t t, SIM_EVENT fn, void *arg);
+void     SIM_Cancel(int id);
+void     SIM_Advance(uint64_t ns);
+void     SIM_Idle(void);
+
+void     SIM_IrqSet(int irq, int level);
+void     SIM_IrqPulse(int irq);
+uint32_t SIM_IrqCount(int irq);
+
+typedef uint32_t (*SIM_IO_READ)(volatile void *reg, unsigned int size);
+typedef void     (*SIM_IO_WRITE)(volatile void *reg, unsigned int size, uint32_t val);
+void     SIM_IoMap(volatile void *base, unsigned int size, SIM_IO_READ rd, SIM_IO_WRITE wr);
+uint32_t SIM_IoCount(void);
+void    *SIM_Ptr(uint32_t addr);
+
+// Runs entry (usually the firmware main) until SIM_Exit, the last task
+// ends or limitNs of simulated time have passed. Returns the exit code,
+// 0 for the end of the last task, -1 for the time limit.
+int      SIM_Run(void (*entry)(void), uint64_t limitNs);
+void     SIM_Exit(int code);
+
+// SSP1 and GPDMA
+typedef struct {
+	uint64_t frames;      // frames shifted out
+	uint64_t bytes;       // bytes shifted out (16-bit frames count 2)
+	uint64_t wireNs;      // time the shifter was busy
+	uint64_t csAsserts;   // falling edges of the LCD chip select
+	uint64_t dmaBytes;    // bytes moved by GPDMA
+	uint64_t txOverflow;  // DR writes with a full TX FIFO
+	uint64_t rxOverrun;   // frames lost on a full RX FIFO
+} SIM_SSP_STATS;
+
+void     SIM_SspInit(void);
+void     SIM_SspStats(SIM_SSP_STATS *st, int reset);
+
+// Called for every frame at its end (bytes, wire time) and for every falling
+// edge of the LCD chip select (cs = 1), e.g. to charge them to a caller
+typedef void (*SIM_SSP_TAP)(unsigned int bytes, uint64_t wireNs, unsigned int cs);
+void     SIM_SspTap(SIM_SSP_TAP fn);
+
+// LCD
+#define SIM_LCD_W        (320)
+#define SIM_LCD_H        (240)
+
+typedef struct {
+	uint64_t pixels;      // GRAM writes
+	uint64_t regWrites;   // register writes other than GRAM
+	uint64_t badStart;    // transactions with an invalid start byte
+	uint64_t outsideCs;   // frames clocked while CS was high
+	uint64_t partial;     // transactions ended in the middle of a word
+} SIM_LCD_STATS;
+
+void     SIM_LcdInit(void);
+void     SIM_LcdCs(int level);
+uint8_t  SIM_LcdXfer(uint8_t mosi);
+uint16_t SIM_LcdPixel(unsigned int x, unsigned int y);
+void     SIM_LcdStats(SIM_LCD_STATS *st, int reset);
+uint32_t SIM_LcdErrors(void);
+int      SIM_LcdDump(const char *path);
+
+// UART0/1
+typedef struct {
+	uint64_t txBytes;     // bytes sent on the wire
+	uint64_t txOverflow;  // THR writes with a full TX FIFO
+	uint64_t rxBytes;     // bytes received into the RX FIFO
+	uint64_t rxOverrun;   // bytes lost on a full RX FIFO
+	uint64_t txBusyNs;    // time the transmitter was busy
+} SIM_UART_STATS;
+
+void     SIM_UartInit(void);
+void     SIM_UartFeed(int port, const uint8_t *data, uint32_t len, uint64_t t);
+const uint8_t *SIM_UartOutput(int port, uint32_t *len);
+uint64_t SIM_UartByteNs(int port);
+void     SIM_UartStats(int port, SIM_UART_STATS *st);
+
+// RTX
+typedef struct {
+	uint64_t switches;    // task switches
+	uint64_t calls;       // kernel calls
+	uint64_t idleNs;      // time no task was ready
+	uint32_t ticks;       // kernel ticks
+} SIM_RTX_STATS;
+
+void     SIM_RtxStats(SIM_RTX_STATS *st);
+void     SIM_RtxPreempt(void);
+int      SIM_RtxLeave(void);
+
+// Board inputs and outputs of hal.h
+void     SIM_JoyAt(uint64_t t, uint32_t lines);
+void     SIM_ButtonAt(uint64_t t);
+uint8_t  SIM_Led(void);
+
+#endif /* _SIM_H */
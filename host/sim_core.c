@@ -0,0 +1,427 @@
+// Virtual clock, timed events, interrupt lines and register access (sim.h)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include "LPC17xx.h"
+#include "hal_io.h"
+#include "sim.h"
+
+#define SIM_IRQS     (34)     // SysTick (-1) and IRQ 0..32, index irq + 1
+#define SIM_MAPS     (16)
+#define SIM_ADDRS    (32)
+#define SIM_ADDR_TAG (0xA0000000u)
+#define SIM_STORM    (100000) // interrupts in a row that count as a storm
+
+// Peripherals without a model are plain memory
+LPC_GPIO_TypeDef    SIM_GPIO1, SIM_GPIO2, SIM_GPIO4;
+LPC_PINCON_TypeDef  SIM_PINCON;
+LPC_GPIOINT_TypeDef SIM_GPIOINT;
+LPC_SC_TypeDef      SIM_SC;
+
+uint32_t SystemCoreClock = 100000000;
+
+// Interrupt handlers of the firmware, left out ones are 0
+void SysTick_Handler(void) __attribute__((weak));
+void TIMER1_IRQHandler(void) __attribute__((weak));
+void UART0_IRQHandler(void) __attribute__((weak));
+void UART1_IRQHandler(void) __attribute__((weak));
+void EINT3_IRQHandler(void) __attribute__((weak));
+void DMA_IRQHandler(void) __attribute__((weak));
+
+typedef struct {
+	uint64_t t;
+	int id;
+	SIM_EVENT fn;
+	void *arg;
+} EVENT;
+
+typedef struct {
+	volatile uint8_t *base;
+	unsigned int size;
+	SIM_IO_READ rd;
+	SIM_IO_WRITE wr;
+} IOMAP;
+
+static uint64_t now = 0;
+
+// Timed events as a binary heap ordered by time, then by id
+static EVENT *heap = 0;
+static int heapLen = 0, heapCap = 0;
+static int eventId = 0;
+static int inEvent = 0;
+
+// Interrupt lines: level sensitive ones follow SIM_IrqSet, pulses latch
+static uint8_t irqLevel[SIM_IRQS];
+static uint8_t irqLatch[SIM_IRQS];
+static uint8_t irqEnabled[SIM_IRQS];
+static uint32_t irqCount[SIM_IRQS];
+static int inIsr = 0;
+static int primask = 0;
+
+static IOMAP ioMap[SIM_MAPS];
+static int ioMaps = 0;
+static uint32_t ioCount = 0;
+static const volatile void *addrTab[SIM_ADDRS];
+static int addrs = 0;
+static const volatile void *exclusive = 0;
+
+static jmp_buf exitJmp;
+static int exitCode = 0;
+static int exiting = 0;
+
+static void (*irqHandler(int irq))(void) {
+	switch(irq) {
+		case SysTick_IRQn: return SysTick_Handler;
+		case TIMER1_IRQn:  return TIMER1_IRQHandler;
+		case UART0_IRQn:   return UART0_IRQHandler;
+		case UART1_IRQn:   return UART1_IRQHandler;
+		case EINT3_IRQn:   return EINT3_IRQHandler;
+		case DMA_IRQn:     return DMA_IRQHandler;
+	}
+	return 0;
+}
+
+static int eventBefore(const EVENT *a, const EVENT *b) {
+	return a->t < b->t || (a->t == b->t && a->id < b->id);
+}
+
+static void heapDown(int i) {
+	EVENT e = heap[i];
+	int c;
+
+	while((c = 2*i + 1) < heapLen) {
+		if(c + 1 < heapLen && eventBefore(&heap[c + 1], &heap[c]))
+			c++;
+		if(!eventBefore(&heap[c], &e))
+			break;
+		heap[i] = heap[c];
+		i = c;
+	}
+	heap[i] = e;
+}
+
+uint64_t SIM_Now(void) {
+	return now;
+}
+
+int SIM_At(uint64_t t, SIM_EVENT fn, void *arg) {
+	EVENT e;
+	int i;
+
+	if(heapLen == heapCap) {
+		heapCap = heapCap ? heapCap*2 : 64;
+		heap = realloc(heap, heapCap*sizeof(EVENT));
+		if(!heap) {
+			fprintf(stderr, "sim: out of memory\n");
+			abort();
+		}
+	}
+	e.t = t < now ? now : t;
+	e.id = ++eventId;
+	e.fn = fn;
+	e.arg = arg;
+
+	for(i = heapLen++; i > 0 && eventBefore(&e, &heap[(i - 1)/2]); i = (i - 1)/2)
+		heap[i] = heap[(i - 1)/2];
+	heap[i] = e;
+	return e.id;
+}
+
+// Cancelled events stay in the heap and are skipped when due
+void SIM_Cancel(int id) {
+	int i;
+
+	for(i=0; i<heapLen; i++) {
+		if(heap[i].id == id) {
+			heap[i].fn = 0;
+			return;
+		}
+	}
+}
+
+// Time of the next live event, 0 if there is none
+static int nextEvent(uint64_t *t) {
+	while(heapLen && heap[0].fn == 0) {
+		heap[0] = heap[--heapLen];
+		heapDown(0);
+	}
+	if(!heapLen)
+		return 0;
+	*t = heap[0].t;
+	return 1;
+}
+
+// Runs the events due up to time end, moving the clock along
+static void runEvents(uint64_t end) {
+	uint64_t t;
+	EVENT e;
+
+	while(nextEvent(&t) && t <= end) {
+		e = heap[0];
+		heap[0] = heap[--heapLen];
+		heapDown(0);
+		if(e.t > now)
+			now = e.t;
+		inEvent++;
+		e.fn(e.arg);
+		inEvent--;
+	}
+}
+
+static int irqPending(void) {
+	int i;
+
+	for(i=0; i<SIM_IRQS; i++) {
+		if((irqLevel[i] || irqLatch[i]) && irqEnabled[i])
+			return i;
+	}
+	return -1;
+}
+
+// Takes pending interrupts, lowest number first like NVIC at equal priority
+static void irqDispatch(void) {
+	void (*handler)(void);
+	int i, n = 0;
+
+	while(!inIsr && !primask && (i = irqPending()) >= 0) {
+		irqLatch[i] = 0;
+		handler = irqHandler(i - 1);
+		if(!handler) {
+			irqEnabled[i] = 0;
+			continue;
+		}
+		if(++n > SIM_STORM) {
+			fprintf(stderr, "sim: interrupt %d does not clear\n", i - 1);
+			abort();
+		}
+		inIsr = 1;
+		exclusive = 0;
+		runEvents(now + SIM_ISR_NS);
+		now += SIM_ISR_NS;
+		irqCount[i]++;
+		handler();
+		inIsr = 0;
+	}
+}
+
+void SIM_Advance(uint64_t ns) {
+	uint64_t end = now + ns;
+
+	if(inEvent) {
+		fprintf(stderr, "sim: time advanced inside an event\n");
+		abort();
+	}
+	runEvents(end);
+	now = end;
+	irqDispatch();
+	if(!inIsr && !primask)
+		SIM_RtxPreempt();
+}
+
+// Like WFI: sleeps until an interrupt is pending and takes it
+void SIM_Idle(void) {
+	uint64_t t;
+
+	while(irqPending() < 0) {
+		if(!nextEvent(&t)) {
+			fprintf(stderr, "sim: sleeping with nothing left to wake up\n");
+			SIM_Exit(-2);
+		}
+		runEvents(t);
+	}
+	irqDispatch();
+	if(!inIsr && !primask)
+		SIM_RtxPreempt();
+}
+
+void SIM_IrqSet(int irq, int level) {
+	irqLevel[irq + 1] = level != 0;
+}
+
+void SIM_IrqPulse(int irq) {
+	irqLatch[irq + 1] = 1;
+}
+
+uint32_t SIM_IrqCount(int irq) {
+	return irqCount[irq + 1];
+}
+
+void NVIC_EnableIRQ(IRQn_Type irq) {
+	irqEnabled[irq + 1] = 1;
+}
+
+void NVIC_DisableIRQ(IRQn_Type irq) {
+	irqEnabled[irq + 1] = 0;
+}
+
+void __disable_irq(void) {
+	primask = 1;
+}
+
+void __enable_irq(void) {
+	primask = 0;
+	irqDispatch();
+	if(!inIsr)
+		SIM_RtxPreempt();
+}
+
+void __WFI(void) {
+	SIM_Idle();
+}
+
+void SIM_IoMap(volatile void *base, unsigned int size, SIM_IO_READ rd, SIM_IO_WRITE wr) {
+	if(ioMaps == SIM_MAPS) {
+		fprintf(stderr, "sim: too many register maps\n");
+		abort();
+	}
+	ioMap[ioMaps].base = base;
+	ioMap[ioMaps].size = size;
+	ioMap[ioMaps].rd = rd;
+	ioMap[ioMaps].wr = wr;
+	ioMaps++;
+}
+
+static IOMAP *ioFind(const volatile void *reg) {
+	const volatile uint8_t *p = reg;
+	int i;
+
+	for(i=0; i<ioMaps; i++) {
+		if(p >= ioMap[i].base && p < ioMap[i].base + ioMap[i].size)
+			return &ioMap[i];
+	}
+	return 0;
+}
+
+static uint32_t plainRead(const volatile void *reg, unsigned int size) {
+	switch(size) {
+		case 1:  return *(const volatile uint8_t *)reg;
+		case 2:  return *(const volatile uint16_t *)reg;
+		default: return *(const volatile uint32_t *)reg;
+	}
+}
+
+static void plainWrite(volatile void *reg, unsigned int size, uint32_t val) {
+	switch(size) {
+		case 1:  *(volatile uint8_t *)reg = val; break;
+		case 2:  *(volatile uint16_t *)reg = val; break;
+		default: *(volatile uint32_t *)reg = val; break;
+	}
+}
+
+uint32_t SIM_IoRead(const volatile void *reg, unsigned int size) {
+	IOMAP *m;
+
+	SIM_Advance(SIM_IO_NS);
+	ioCount++;
+	m = ioFind(reg);
+	if(m && m->rd)
+		return m->rd((volatile void *)reg, size);
+	return plainRead(reg, size);
+}
+
+void SIM_IoWrite(volatile void *reg, unsigned int size, uint32_t val) {
+	IOMAP *m;
+
+	SIM_Advance(SIM_IO_NS);
+	ioCount++;
+	m = ioFind(reg);
+	if(m && m->wr)
+		m->wr(reg, size, val);
+	else
+		plainWrite(reg, size, val);
+}
+
+uint32_t SIM_IoCount(void) {
+	return ioCount;
+}
+
+// Bus addresses for the GPDMA registers are handles into a table
+uint32_t SIM_Addr(const volatile void *p) {
+	int i;
+
+	for(i=0; i<addrs; i++) {
+		if(addrTab[i] == p)
+			return SIM_ADDR_TAG | i;
+	}
+	if(addrs == SIM_ADDRS) {
+		fprintf(stderr, "sim: too many DMA addresses\n");
+		abort();
+	}
+	addrTab[addrs] = p;
+	return SIM_ADDR_TAG | addrs++;
+}
+
+void *SIM_Ptr(uint32_t addr) {
+	if((addr & ~0xFFFFu) != SIM_ADDR_TAG || (int)(addr & 0xFFFF) >= addrs)
+		return 0;
+	return (void *)addrTab[addr & 0xFFFF];
+}
+
+uint32_t SIM_Ldrex(volatile void *addr, unsigned int size) {
+	SIM_Advance(SIM_IO_NS);
+	exclusive = addr;
+	return plainRead(addr, size);
+}
+
+// Fails if an interrupt came in since SIM_Ldrex
+uint32_t SIM_Strex(uint32_t val, volatile void *addr, unsigned int size) {
+	if(exclusive != addr)
+		return 1;
+	exclusive = 0;
+	plainWrite(addr, size, val);
+	return 0;
+}
+
+void SystemInit(void) {
+	SystemCoreClock = 100000000;
+}
+
+uint32_t ITM_SendChar(uint32_t ch) {
+	putchar((int)ch);
+	return ch;
+}
+
+int32_t ITM_ReceiveChar(void) {
+	return -1;
+}
+
+int32_t ITM_CheckChar(void) {
+	return 0;
+}
+
+static void limitHit(void *arg) {
+	SIM_Exit(-1);
+}
+
+int SIM_Run(void (*entry)(void), uint64_t limitNs) {
+	static int runs = 0;
+
+	if(runs++) {
+		fprintf(stderr, "sim: one SIM_Run per process\n");
+		abort();
+	}
+	SIM_SspInit();
+	SIM_LcdInit();
+	SIM_UartInit();
+	if(limitNs)
+		SIM_At(limitNs, limitHit, 0);
+
+	if(setjmp(exitJmp) == 0)
+		entry();
+	return exitCode;
+}
+
+// Ends the run from anywhere, a task first hands over to the scheduler so
+// the jump starts from the stack SIM_Run is on
+void SIM_Exit(int code) {
+	if(!exiting) {
+		exiting = 1;
+		exitCode = code;
+	}
+	SIM_RtxLeave();
+	inEvent = 0;
+	inIsr = 0;
+	longjmp(exitJmp, 1);
+}
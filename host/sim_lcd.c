@@ -0,0 +1,164 @@
+// HX8347-D LCD controller on the SPI interface of the MCB1700 (sim.h)
+//
+// Every transaction starts with chip select going low and a start byte
+// 0x70 | RS << 1 | RW. Writes carry 16-bit words MSB first: an index
+// word selects a register, data words go to that register or, for index
+// 0x22, into GRAM at the address counter. The counter starts at the window
+// corner (SC, SP) on selecting 0x22 and runs along x first (the driver sets
+// landscape mode, so SC/EC span 0..319 and SP/EP 0..239). Reads return a
+// dummy byte and then the register value, register 0x00 always reads the
+// controller ID whatever was written to it.
+
+#include <stdio.h>
+#include <string.h>
+#include "sim.h"
+
+#define LCD_START       (0x70)
+#define LCD_RD          (0x01)
+#define LCD_DATA        (0x02)
+#define LCD_GRAM        (0x22)
+#define LCD_ID          (0x47)
+
+static uint16_t gram[SIM_LCD_H][SIM_LCD_W];
+static uint16_t regs[256];
+static uint8_t regIndex;
+static unsigned int curX, curY;
+
+static int csLow = 0;
+static int nbytes;                  // bytes of the current transaction
+static uint8_t start;
+static uint8_t hi;
+static int bad;
+
+static SIM_LCD_STATS st;
+
+static unsigned int reg16(unsigned int r) {
+	return ((regs[r] & 0xFF) << 8) | (regs[r + 1] & 0xFF);
+}
+
+static void gramWrite(uint16_t val) {
+	unsigned int sc = reg16(0x02), ec = reg16(0x04);
+	unsigned int sp = reg16(0x06), ep = reg16(0x08);
+
+	if(curX < SIM_LCD_W && curY < SIM_LCD_H)
+		gram[curY][curX] = val;
+	st.pixels++;
+	if(++curX > ec || curX >= SIM_LCD_W) {
+		curX = sc;
+		if(++curY > ep || curY >= SIM_LCD_H)
+			curY = sp;
+	}
+}
+
+static void wordWrite(uint16_t val) {
+	if(!(start & LCD_DATA)) {
+		regIndex = val & 0xFF;
+		if(regIndex == LCD_GRAM) {
+			curX = reg16(0x02);
+			curY = reg16(0x06);
+		}
+	} else if(regIndex == LCD_GRAM) {
+		gramWrite(val);
+	} else {
+		regs[regIndex] = val;
+		st.regWrites++;
+	}
+}
+
+void SIM_LcdInit(void) {
+	memset(gram, 0, sizeof(gram));
+	memset(regs, 0, sizeof(regs));
+	regs[0x05] = (SIM_LCD_W - 1) & 0xFF;
+	regs[0x04] = (SIM_LCD_W - 1) >> 8;
+	regs[0x09] = (SIM_LCD_H - 1) & 0xFF;
+	regIndex = 0;
+	curX = curY = 0;
+	csLow = 0;
+}
+
+void SIM_LcdCs(int level) {
+	if(!level) {
+		csLow = 1;
+		nbytes = 0;
+		bad = 0;
+		return;
+	}
+	// A write ends on a whole word: start byte plus an even byte count
+	if(csLow && !bad && nbytes > 1 && !(start & LCD_RD) && !(nbytes & 1))
+		st.partial++;
+	csLow = 0;
+}
+
+uint8_t SIM_LcdXfer(uint8_t mosi) {
+	uint16_t val;
+	int n;
+
+	if(!csLow) {
+		st.outsideCs++;
+		return 0;
+	}
+	n = nbytes++;
+	if(n == 0) {
+		start = mosi;
+		if((mosi & 0xFC) != LCD_START) {
+			bad = 1;
+			st.badStart++;
+		}
+		return 0;
+	}
+	if(bad)
+		return 0;
+
+	if(start & LCD_RD) {
+		// Dummy byte, then the register value MSB first
+		val = regIndex == 0x00 ? LCD_ID : regs[regIndex];
+		if(n == 2)
+			return val >> 8;
+		if(n == 3)
+			return val & 0xFF;
+		return 0;
+	}
+	if(n & 1) {
+		hi = mosi;
+	} else {
+		wordWrite((hi << 8) | mosi);
+	}
+	return 0;
+}
+
+uint16_t SIM_LcdPixel(unsigned int x, unsigned int y) {
+	if(x >= SIM_LCD_W || y >= SIM_LCD_H)
+		return 0;
+	return gram[y][x];
+}
+
+void SIM_LcdStats(SIM_LCD_STATS *s, int reset) {
+	if(s)
+		*s = st;
+	if(reset)
+		memset(&st, 0, sizeof(st));
+}
+
+uint32_t SIM_LcdErrors(void) {
+	return (uint32_t)(st.badStart + st.outsideCs + st.partial);
+}
+
+// Writes GRAM as a binary PPM, returns 0 on success
+int SIM_LcdDump(const char *path) {
+	FILE *f = fopen(path, "wb");
+	unsigned int x, y;
+	uint16_t c;
+
+	if(!f)
+		return -1;
+	fprintf(f, "P6\n%d %d\n255\n", SIM_LCD_W, SIM_LCD_H);
+	for(y=0; y<SIM_LCD_H; y++) {
+		for(x=0; x<SIM_LCD_W; x++) {
+			c = gram[y][x];
+			fputc(((c >> 11) & 0x1F) << 3, f);
+			fputc(((c >> 5) & 0x3F) << 2, f);
+			fputc((c & 0x1F) << 3, f);
+		}
+	}
+	return fclose(f) ? -1 : 0;
+}
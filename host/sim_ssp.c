@@ -0,0 +1,250 @@
+// SSP1, GPDMA channel 0 and the LCD chip select on P0.6 (sim.h)
+//
+// A frame is handed to the LCD model when its last bit has been shifted
+// out. The shifter pulls the next frame from the 8-entry TX FIFO right
+// away and GPDMA tops the FIFO up whenever there is room, so a transfer
+// runs at the wire rate set by PCLKSEL0, CPSR and CR0.SCR.
+
+#include <stdio.h>
+#include "LPC17xx.h"
+#include "hal_io.h"
+#include "sim.h"
+
+#define SSP_FIFO    (8)
+#define SR_TFE      (0x01)
+#define SR_TNF      (0x02)
+#define SR_RNE      (0x04)
+#define SR_BSY      (0x10)
+#define RIS_ROR     (0x01)
+#define TXDMAE      (0x02)
+
+#define PIN_CS      (1 << 6)
+#define DMA_SSP1_TX (2)
+
+LPC_GPIO_TypeDef    SIM_GPIO0;
+LPC_SSP_TypeDef     SIM_SSP1;
+LPC_GPDMA_TypeDef   SIM_GPDMA;
+LPC_GPDMACH_TypeDef SIM_GPDMACH0;
+
+static uint16_t txFifo[SSP_FIFO], rxFifo[SSP_FIFO];
+static int txHead = 0, txCnt = 0;
+static int rxHead = 0, rxCnt = 0;
+
+static int shifting = 0;
+static uint16_t shiftVal;
+static unsigned int shiftBits;
+static uint64_t shiftStart;
+
+static int dmaOn = 0;
+static const uint8_t *dmaSrc;
+static uint32_t dmaLeft;
+
+static SIM_SSP_STATS st;
+static SIM_SSP_TAP tap;
+
+static uint64_t frameNs(unsigned int bits) {
+	uint64_t pclk = SystemCoreClock;
+	uint64_t div;
+
+	switch((SIM_SC.PCLKSEL0 >> 20) & 3) {
+		case 0: pclk /= 4; break;
+		case 2: pclk /= 2; break;
+		case 3: pclk /= 8; break;
+	}
+	div = (SIM_SSP1.CPSR & 0xFE) * (((SIM_SSP1.CR0 >> 8) & 0xFF) + 1);
+	if(!div)
+		div = 2;
+	return bits*div*SIM_S/pclk;
+}
+
+static void dmaIrq(void) {
+	SIM_IrqSet(DMA_IRQn, (SIM_GPDMA.DMACIntTCStat | SIM_GPDMA.DMACIntErrStat) & 1);
+}
+
+static void dmaDone(void) {
+	dmaOn = 0;
+	SIM_GPDMACH0.DMACCConfig &= ~1u;
+	if(SIM_GPDMACH0.DMACCControl & (1u << 31)) {
+		SIM_GPDMA.DMACRawIntTCStat |= 1;
+		if(SIM_GPDMACH0.DMACCConfig & (1 << 15))
+			SIM_GPDMA.DMACIntTCStat |= 1;
+	}
+	dmaIrq();
+}
+
+// GPDMA moves bytes while SSP1 requests them (TX FIFO not full)
+static void dmaFeed(void) {
+	while(dmaOn && dmaLeft && txCnt < SSP_FIFO && (SIM_SSP1.DMACR & TXDMAE)) {
+		txFifo[(txHead + txCnt++) % SSP_FIFO] = *dmaSrc++;
+		dmaLeft--;
+		st.dmaBytes++;
+	}
+	if(dmaOn && !dmaLeft)
+		dmaDone();
+}
+
+static void shiftDone(void *arg);
+
+static void sspKick(void) {
+	dmaFeed();
+	if(shifting || !txCnt || !(SIM_SSP1.CR1 & 0x02))
+		return;
+	shiftVal = txFifo[txHead];
+	txHead = (txHead + 1) % SSP_FIFO;
+	txCnt--;
+	shiftBits = (SIM_SSP1.CR0 & 0x0F) + 1;
+	shifting = 1;
+	shiftStart = SIM_Now();
+	SIM_At(shiftStart + frameNs(shiftBits), shiftDone, 0);
+	dmaFeed();
+}
+
+static void shiftDone(void *arg) {
+	uint16_t miso;
+	unsigned int bytes = shiftBits > 8 ? 2 : 1;
+
+	if(bytes == 2) {
+		miso = SIM_LcdXfer(shiftVal >> 8) << 8;
+		miso |= SIM_LcdXfer(shiftVal & 0xFF);
+	} else {
+		miso = SIM_LcdXfer(shiftVal & 0xFF);
+	}
+	st.bytes += bytes;
+	st.frames++;
+	st.wireNs += SIM_Now() - shiftStart;
+	if(tap)
+		tap(bytes, SIM_Now() - shiftStart, 0);
+
+	if(rxCnt == SSP_FIFO) {
+		SIM_SSP1.RIS |= RIS_ROR;
+		st.rxOverrun++;
+	} else {
+		rxFifo[(rxHead + rxCnt++) % SSP_FIFO] = miso;
+	}
+	shifting = 0;
+	sspKick();
+}
+
+static uint32_t sspRead(volatile void *reg, unsigned int size) {
+	uint32_t v = 0;
+
+	if(reg == &SIM_SSP1.DR) {
+		if(rxCnt) {
+			v = rxFifo[rxHead];
+			rxHead = (rxHead + 1) % SSP_FIFO;
+			rxCnt--;
+		}
+		return v;
+	}
+	if(reg == &SIM_SSP1.SR) {
+		if(!txCnt)
+			v |= SR_TFE;
+		if(txCnt < SSP_FIFO)
+			v |= SR_TNF;
+		if(rxCnt)
+			v |= SR_RNE;
+		if(txCnt || shifting)
+			v |= SR_BSY;
+		return v;
+	}
+	return *(volatile uint32_t *)reg;
+}
+
+static void sspWrite(volatile void *reg, unsigned int size, uint32_t val) {
+	if(reg == &SIM_SSP1.DR) {
+		if(txCnt == SSP_FIFO) {
+			st.txOverflow++;
+			return;
+		}
+		txFifo[(txHead + txCnt++) % SSP_FIFO] = val & 0xFFFF;
+		sspKick();
+	} else if(reg == &SIM_SSP1.ICR) {
+		SIM_SSP1.RIS &= ~(val & 0x03);
+	} else {
+		*(volatile uint32_t *)reg = val;
+	}
+}
+
+static void dmaWrite(volatile void *reg, unsigned int size, uint32_t val) {
+	if(reg == &SIM_GPDMA.DMACIntTCClear) {
+		SIM_GPDMA.DMACIntTCStat &= ~val;
+		SIM_GPDMA.DMACRawIntTCStat &= ~val;
+	} else if(reg == &SIM_GPDMA.DMACIntErrClr) {
+		SIM_GPDMA.DMACIntErrStat &= ~val;
+		SIM_GPDMA.DMACRawIntErrStat &= ~val;
+	} else {
+		*(volatile uint32_t *)reg = val;
+	}
+	dmaIrq();
+}
+
+// Only memory to SSP1 TX is wired up, anything else is a channel error
+static void dmaChWrite(volatile void *reg, unsigned int size, uint32_t val) {
+	*(volatile uint32_t *)reg = val;
+	if(reg != &SIM_GPDMACH0.DMACCConfig || !(val & 1) || dmaOn)
+		return;
+
+	dmaSrc = SIM_Ptr(SIM_GPDMACH0.DMACCSrcAddr);
+	dmaLeft = SIM_GPDMACH0.DMACCControl & 0xFFF;
+	if(!(SIM_GPDMA.DMACConfig & 1) || !dmaSrc ||
+	   SIM_Ptr(SIM_GPDMACH0.DMACCDestAddr) != &SIM_SSP1.DR ||
+	   ((val >> 6) & 0x1F) != DMA_SSP1_TX || ((val >> 11) & 7) != 1 ||
+	   !(SIM_GPDMACH0.DMACCControl & (1 << 26))) {
+		SIM_GPDMACH0.DMACCConfig &= ~1u;
+		SIM_GPDMA.DMACRawIntErrStat |= 1;
+		if(val & (1 << 14))
+			SIM_GPDMA.DMACIntErrStat |= 1;
+		dmaIrq();
+		return;
+	}
+	dmaOn = 1;
+	sspKick();
+}
+
+// Input pins read low, nothing drives the data line back
+static uint32_t gpioRead(volatile void *reg, unsigned int size) {
+	if(reg == &SIM_GPIO0.FIOPIN)
+		return SIM_GPIO0.FIOPIN & SIM_GPIO0.FIODIR;
+	return *(volatile uint32_t *)reg;
+}
+
+static void gpioWrite(volatile void *reg, unsigned int size, uint32_t val) {
+	uint32_t old = SIM_GPIO0.FIOPIN;
+
+	if(reg == &SIM_GPIO0.FIOSET)
+		SIM_GPIO0.FIOPIN |= val;
+	else if(reg == &SIM_GPIO0.FIOCLR)
+		SIM_GPIO0.FIOPIN &= ~val;
+	else
+		*(volatile uint32_t *)reg = val;
+
+	if((old ^ SIM_GPIO0.FIOPIN) & PIN_CS) {
+		if(!(SIM_GPIO0.FIOPIN & PIN_CS)) {
+			st.csAsserts++;
+			if(tap)
+				tap(0, 0, 1);
+		}
+		SIM_LcdCs((SIM_GPIO0.FIOPIN & PIN_CS) != 0);
+	}
+}
+
+void SIM_SspInit(void) {
+	SIM_GPIO0.FIOPIN = PIN_CS;
+	SIM_IoMap(&SIM_GPIO0, sizeof(SIM_GPIO0), gpioRead, gpioWrite);
+	SIM_IoMap(&SIM_SSP1, sizeof(SIM_SSP1), sspRead, sspWrite);
+	SIM_IoMap(&SIM_GPDMA, sizeof(SIM_GPDMA), 0, dmaWrite);
+	SIM_IoMap(&SIM_GPDMACH0, sizeof(SIM_GPDMACH0), 0, dmaChWrite);
+}
+
+void SIM_SspTap(SIM_SSP_TAP fn) {
+	tap = fn;
+}
+
+void SIM_SspStats(SIM_SSP_STATS *s, int reset) {
+	if(s)
+		*s = st;
+	if(reset) {
+		st.frames = st.bytes = st.wireNs = st.csAsserts = 0;
+		st.dmaBytes = st.txOverflow = st.rxOverrun = 0;
+	}
+}
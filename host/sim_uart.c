@@ -0,0 +1,252 @@
+// UART0 and UART1 with 16-byte FIFOs (sim.h)
+//
+// Bytes written to THR go through the TX FIFO and the shifter at the rate
+// set by the divisor latches and PCLKSEL0, and end up in a capture buffer.
+// SIM_UartFeed delivers bytes into the RX FIFO at the same rate. The
+// interrupt line follows IER and the pending sources the way IIR reports
+// them: line status, then receive data, then THRE.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "LPC17xx.h"
+#include "hal_io.h"
+#include "sim.h"
+
+#define UART_FIFO   (16)
+
+#define IER_RBR     (0x01)
+#define IER_THRE    (0x02)
+#define IER_RLS     (0x04)
+
+#define IIR_NONE    (0x01)
+#define IIR_RLS     (0x06)
+#define IIR_RDA     (0x04)
+#define IIR_THRE    (0x02)
+#define IIR_FIFO    (0xC0)
+
+#define LSR_RDR     (0x01)
+#define LSR_OE      (0x02)
+#define LSR_THRE    (0x20)
+#define LSR_TEMT    (0x40)
+
+LPC_UART_TypeDef SIM_UART0, SIM_UART1;
+
+typedef struct {
+	LPC_UART_TypeDef *reg;
+	int irq;
+	unsigned int pclkShift;         // PCLKSEL0 field of the port
+
+	uint8_t tx[UART_FIFO];
+	int txHead, txCnt;
+	int shifting;
+	uint8_t shiftByte;
+	uint64_t shiftStart;
+	int threPending;
+
+	uint8_t rx[UART_FIFO];
+	int rxHead, rxCnt;
+	int overrun;
+
+	uint8_t *out;                   // bytes sent
+	uint32_t outLen, outCap;
+	uint8_t *feed;                  // bytes still to arrive
+	uint32_t feedLen, feedPos;
+	int feeding;
+
+	SIM_UART_STATS st;
+} UART;
+
+static UART uart[2] = {
+	{ &SIM_UART0, UART0_IRQn, 6 },
+	{ &SIM_UART1, UART1_IRQn, 8 },
+};
+
+static UART *uartOf(volatile void *reg) {
+	return ((volatile uint8_t *)reg >= (volatile uint8_t *)&SIM_UART1 &&
+	        (volatile uint8_t *)reg < (volatile uint8_t *)(&SIM_UART1 + 1)) ? &uart[1] : &uart[0];
+}
+
+uint64_t SIM_UartByteNs(int port) {
+	UART *u = &uart[port & 1];
+	uint64_t pclk = SystemCoreClock;
+	uint64_t fdiv = u->reg->DLM*256 + u->reg->DLL;
+
+	switch((SIM_SC.PCLKSEL0 >> u->pclkShift) & 3) {
+		case 0: pclk /= 4; break;
+		case 2: pclk /= 2; break;
+		case 3: pclk /= 8; break;
+	}
+	if(!fdiv)
+		fdiv = 1;
+	return 10*16*fdiv*SIM_S/pclk;
+}
+
+static void irqUpdate(UART *u) {
+	uint32_t ier = u->reg->IER;
+
+	SIM_IrqSet(u->irq, ((ier & IER_RLS) && u->overrun) ||
+	                   ((ier & IER_RBR) && u->rxCnt) ||
+	                   ((ier & IER_THRE) && u->threPending));
+}
+
+static void txDone(void *arg);
+
+static void txStart(UART *u) {
+	if(u->shifting || !u->txCnt)
+		return;
+	u->shiftByte = u->tx[u->txHead];
+	u->txHead = (u->txHead + 1) % UART_FIFO;
+	if(!--u->txCnt)
+		u->threPending = 1;
+	u->shifting = 1;
+	u->shiftStart = SIM_Now();
+	SIM_At(u->shiftStart + SIM_UartByteNs(u == &uart[1]), txDone, u);
+}
+
+static void txDone(void *arg) {
+	UART *u = arg;
+
+	if(u->outLen == u->outCap) {
+		u->outCap = u->outCap ? u->outCap*2 : 4096;
+		u->out = realloc(u->out, u->outCap);
+		if(!u->out) {
+			fprintf(stderr, "sim: out of memory\n");
+			abort();
+		}
+	}
+	u->out[u->outLen++] = u->shiftByte;
+	u->st.txBytes++;
+	u->st.txBusyNs += SIM_Now() - u->shiftStart;
+	u->shifting = 0;
+	txStart(u);
+	irqUpdate(u);
+}
+
+static void rxArrive(void *arg) {
+	UART *u = arg;
+
+	if(u->rxCnt == UART_FIFO) {
+		u->overrun = 1;
+		u->st.rxOverrun++;
+	} else {
+		u->rx[(u->rxHead + u->rxCnt++) % UART_FIFO] = u->feed[u->feedPos];
+		u->st.rxBytes++;
+	}
+	u->feedPos++;
+	if(u->feedPos < u->feedLen)
+		SIM_At(SIM_Now() + SIM_UartByteNs(u == &uart[1]), rxArrive, u);
+	else
+		u->feeding = 0;
+	irqUpdate(u);
+}
+
+static uint32_t uartRead(volatile void *reg, unsigned int size) {
+	UART *u = uartOf(reg);
+	uint32_t v = 0;
+
+	if(reg == &u->reg->RBR) {
+		if(u->rxCnt) {
+			v = u->rx[u->rxHead];
+			u->rxHead = (u->rxHead + 1) % UART_FIFO;
+			u->rxCnt--;
+		}
+	} else if(reg == &u->reg->LSR) {
+		if(u->rxCnt)
+			v |= LSR_RDR;
+		if(u->overrun)
+			v |= LSR_OE;
+		if(!u->txCnt)
+			v |= LSR_THRE;
+		if(!u->txCnt && !u->shifting)
+			v |= LSR_TEMT;
+		u->overrun = 0;
+	} else if(reg == &u->reg->IIR) {
+		// Reading IIR with THRE as the top source clears it
+		if((u->reg->IER & IER_RLS) && u->overrun)
+			v = IIR_RLS;
+		else if((u->reg->IER & IER_RBR) && u->rxCnt)
+			v = IIR_RDA;
+		else if((u->reg->IER & IER_THRE) && u->threPending) {
+			v = IIR_THRE;
+			u->threPending = 0;
+		} else
+			v = IIR_NONE;
+		v |= IIR_FIFO;
+	} else {
+		switch(size) {
+			case 1:  v = *(volatile uint8_t *)reg; break;
+			default: v = *(volatile uint32_t *)reg; break;
+		}
+	}
+	irqUpdate(u);
+	return v;
+}
+
+static void uartWrite(volatile void *reg, unsigned int size, uint32_t val) {
+	UART *u = uartOf(reg);
+	uint32_t old;
+
+	if(reg == &u->reg->THR) {
+		u->threPending = 0;
+		if(u->txCnt == UART_FIFO) {
+			u->st.txOverflow++;
+		} else {
+			u->tx[(u->txHead + u->txCnt++) % UART_FIFO] = val;
+			txStart(u);
+		}
+	} else if(reg == &u->reg->IER) {
+		old = u->reg->IER;
+		u->reg->IER = val;
+		if((val & IER_THRE) && !(old & IER_THRE) && !u->txCnt)
+			u->threPending = 1;
+	} else if(reg == &u->reg->FCR) {
+		if(val & 0x02)
+			u->rxCnt = 0;
+		if(val & 0x04)
+			u->txCnt = 0;
+		u->reg->FCR = val;
+	} else {
+		switch(size) {
+			case 1:  *(volatile uint8_t *)reg = val; break;
+			default: *(volatile uint32_t *)reg = val; break;
+		}
+	}
+	irqUpdate(u);
+}
+
+void SIM_UartInit(void) {
+	SIM_IoMap(&SIM_UART0, sizeof(SIM_UART0), uartRead, uartWrite);
+	SIM_IoMap(&SIM_UART1, sizeof(SIM_UART1), uartRead, uartWrite);
+}
+
+// Bytes arrive back to back from time t on, after any earlier feed
+void SIM_UartFeed(int port, const uint8_t *data, uint32_t len, uint64_t t) {
+	UART *u = &uart[port & 1];
+
+	if(!len)
+		return;
+	u->feed = realloc(u->feed, u->feedLen + len);
+	if(!u->feed) {
+		fprintf(stderr, "sim: out of memory\n");
+		abort();
+	}
+	memcpy(u->feed + u->feedLen, data, len);
+	u->feedLen += len;
+	if(!u->feeding) {
+		u->feeding = 1;
+		SIM_At(t, rxArrive, u);
+	}
+}
+
+const uint8_t *SIM_UartOutput(int port, uint32_t *len) {
+	UART *u = &uart[port & 1];
+
+	if(len)
+		*len = u->outLen;
+	return u->out;
+}
+
+void SIM_UartStats(int port, SIM_UART_STATS *st) {
+	*st = uart[port & 1].st;
+}
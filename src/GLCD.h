@@ -39,12 +39,29 @@
 #define Yellow          0xFFE0      /* 255, 255, 0   */
 #define White           0xFFFF      /* 255, 255, 255 */
 
+/* Tile size of GLCD_BlitTile in pixels                                       */
+#define GLCD_TILE       16
+
+/* SSP1 traffic statistics of one tag (see SPI_STATS in GLCD_SPI_LPC1700.c)   */
+typedef struct {
+  unsigned int bytes;                   /* Bytes transferred                  */
+  unsigned int cs;                      /* Chip select assertions             */
+  unsigned int skipped;                 /* Window register writes avoided     */
+  unsigned int wire_us;                 /* Estimated wire time [us]           */
+} GLCD_STATS;
+
 extern void GLCD_Init           (void);
+extern void GLCD_SetWindow      (unsigned int x,  unsigned int y, unsigned int w, unsigned int h);
 extern void GLCD_WindowMax      (void);
 extern void GLCD_PutPixel       (unsigned int x, unsigned int y);
+extern void GLCD_RemovePixel    (unsigned int x, unsigned int y);
 extern void GLCD_SetTextColor   (unsigned short color);
 extern void GLCD_SetBackColor   (unsigned short color);
 extern void GLCD_Clear          (unsigned short color);
+extern void GLCD_FillRect       (unsigned int x,  unsigned int y, unsigned int w, unsigned int h, unsigned short color);
+extern void GLCD_DrawSprite     (unsigned int x,  unsigned int y, unsigned int w, unsigned int h, const unsigned short *bits, unsigned char opaque);
+extern void GLCD_DrawSpriteRun  (unsigned int x,  unsigned int y, unsigned int w, unsigned int h, const unsigned short *bits, unsigned int count);
+extern void GLCD_BlitTile       (unsigned int x,  unsigned int y, const unsigned short *tile);
 extern void GLCD_DrawChar       (unsigned int x,  unsigned int y, unsigned int cw, unsigned int ch, unsigned char *c);
 extern void GLCD_DisplayChar    (unsigned int ln, unsigned int col, unsigned char fi, unsigned char  c);
 extern void GLCD_DisplayString  (unsigned int ln, unsigned int col, unsigned char fi, unsigned char *s);
@@ -56,4 +73,13 @@ extern void GLCD_ScrollVertical (unsigned int dy);
 extern void GLCD_WrCmd          (unsigned char cmd);
 extern void GLCD_WrReg          (unsigned char reg, unsigned short val); 
 
+extern unsigned char GLCD_StatsTag (unsigned char tag);
+extern void GLCD_Stats          (unsigned char tag, GLCD_STATS *st, unsigned char reset);
+extern unsigned int GLCD_SpiBytes (unsigned char reset);
+
+extern void GLCD_FB_Enable      (unsigned char on);
+extern void GLCD_FB_Flush       (void);
+
+extern void GLCD_DMAYield       (unsigned char on);
+
 #endif /* _GLCD_H */
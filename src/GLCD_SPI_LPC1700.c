@@ -11,6 +11,8 @@
 
 
 #include <lpc17xx.h>
+#include <rtl.h>
+#include "hal_io.h"
 #include "GLCD.h"
 #include "Font_6x8_h.h"
 #include "Font_16x24_h.h"
@@ -20,6 +22,36 @@
 #define LANDSCAPE   1                   /* 1 for landscape, 0 for portrait    */
 #define ROTATE180   0                   /* 1 to rotate the screen for 180 deg */
 
+/************************** Statistics configuration **************************/
+
+#ifndef SPI_STATS
+#define SPI_STATS   0                   /* 1 to count SSP1 traffic per tag    */
+#endif
+#define SPI_TAGS    8                   /* Number of statistics tags          */
+
+/************************* Frame buffer configuration *************************/
+
+#ifndef FRAMEBUFFER
+#define FRAMEBUFFER 1                   /* 1 to include off-screen buffer     */
+#endif
+#define FB_RECTS    64                  /* Max. dirty rectangles per frame    */
+#define FB_SLACK    128                 /* Clean pixels accepted on merge     */
+
+/**************************** DMA configuration *******************************/
+
+#ifndef SPI_DMA
+#define SPI_DMA     1                   /* 1 to send bursts with GPDMA        */
+#endif
+#define DMA_CHUNK   512                 /* Bytes per DMA buffer (max. 4095)   */
+#define DMA_MIN     64                  /* Min. pixels for a DMA burst        */
+#define DMA_EVT     0x8000              /* RTX event flag for DMA completion  */
+
+/************************* Glyph cache configuration **************************/
+
+#ifndef GLYPH_CACHE
+#define GLYPH_CACHE 8                   /* Expanded glyphs kept (0 = off)     */
+#endif
+
 /*********************** Hardware specific configuration **********************/
 
 /* SPI Interface: SPI3
@@ -41,9 +73,19 @@
 
 /* SPI_SR - bit definitions                                                   */
 #define TFE         0x01
+#define TNF         0x02
 #define RNE         0x04
 #define BSY         0x10
 
+/* SSP_ICR / SSP_DMACR - bit definitions                                      */
+#define RORIC       0x01
+#define TXDMAE      0x02
+
+/* SSP_CR0 - data size select                                                 */
+#define DSS_MASK    0x0F
+#define DSS_8       0x07
+#define DSS_16      0x0F
+
 /*------------------------- Speed dependant settings -------------------------*/
 
 /* If processor works on high frequency delay has to be increased, it can be 
@@ -62,15 +104,46 @@
 #define BPP         16                  /* Bits per pixel                     */
 #define BYPP        ((BPP+7)/8)         /* Bytes per pixel                    */
 
+/*------------------------ Frame buffer definitions --------------------------*/
+
+/* The frame buffer is stored as 3 bit planes of palette indexes, so it holds
+   up to 8 different colors in 3 x 9600 bytes. It is placed in the AHB SRAM
+   (32 KB at 0x2007C000, IRAM2 / RW_IRAM2 in MinefieldGame.sct), which is
+   otherwise unused by this project.                                          */
+#define FB_PLANES   3                   /* Bit planes per pixel               */
+#define FB_COLORS   (1 << FB_PLANES)    /* Palette size                       */
+#define FB_WPR      ((WIDTH+31)/32)     /* 32-bit words per row and plane     */
+#ifndef HAL_HOST
+#define FB_RAM      __attribute__((at(0x2007C000), zero_init))
+#else
+#define FB_RAM                          /* Plain static memory on the host    */
+#endif
+
+/*---------------------------- DMA definitions -------------------------------*/
+
+/* GPDMA cannot access the local SRAM, so the DMA buffers are placed in the
+   AHB SRAM as well, behind the frame buffer                                  */
+#ifndef HAL_HOST
+#define DMA_RAM     __attribute__((at(0x20083800), zero_init))
+#else
+#define DMA_RAM
+#endif
+#define DMA_SSP1_TX 2                   /* GPDMA request line of SSP1 TX      */
+
 /*--------------- Graphic LCD interface hardware definitions -----------------*/
 
 /* Pin CS setting to 0 or 1                                                   */
-#define LCD_CS(x)   ((x) ? (LPC_GPIO0->FIOSET = PIN_CS)    : (LPC_GPIO0->FIOCLR = PIN_CS))
-#define LCD_CLK(x)  ((x) ? (LPC_GPIO0->FIOSET = PIN_CLK)   : (LPC_GPIO0->FIOCLR = PIN_CLK))
-#define LCD_DAT(x)  ((x) ? (LPC_GPIO0->FIOSET = PIN_DAT)   : (LPC_GPIO0->FIOCLR = PIN_DAT))
+#define LCD_CS(x)   ((x) ? IO_WR(LPC_GPIO0->FIOSET, PIN_CS)  : IO_WR(LPC_GPIO0->FIOCLR, PIN_CS))
+#define LCD_CLK(x)  ((x) ? IO_WR(LPC_GPIO0->FIOSET, PIN_CLK) : IO_WR(LPC_GPIO0->FIOCLR, PIN_CLK))
+#define LCD_DAT(x)  ((x) ? IO_WR(LPC_GPIO0->FIOSET, PIN_DAT) : IO_WR(LPC_GPIO0->FIOCLR, PIN_DAT))
 
 #define DAT_MODE(x) ((x == OUT) ? (LPC_GPIO0->FIODIR |= PIN_DAT) : (LPC_GPIO0->FIODIR &= ~PIN_DAT))
-#define BUS_VAL()                ((LPC_GPIO0->FIOPIN  & PIN_DAT) != 0)
+#define BUS_VAL()                ((IO_RD(LPC_GPIO0->FIOPIN) & PIN_DAT) != 0)
+
+/* SSP1 data and status registers (see hal_io.h)                              */
+#define SSP_SR()    IO_RD(LPC_SSP1->SR)
+#define SSP_RD()    IO_RD(LPC_SSP1->DR)
+#define SSP_WR(x)   IO_WR(LPC_SSP1->DR, (x))
 
 
 #define SPI_START   (0x70)              /* Start byte for SPI transfer        */
@@ -88,6 +161,57 @@
 /******************************************************************************/
 static volatile unsigned short Color[2] = {White, Black};
 static unsigned char Himax;
+static unsigned char WinReg[8];         /* Himax window registers 0x02..0x09  */
+static unsigned char WinValid;          /* WinReg matches the controller      */
+
+#if (SPI_STATS == 1)
+static unsigned int  SpiBytes[SPI_TAGS];/* Bytes transferred over SSP1        */
+static unsigned int  SpiCs[SPI_TAGS];   /* Chip select assertions             */
+static unsigned int  SpiSkip[SPI_TAGS]; /* Register writes avoided            */
+static unsigned char SpiTag;            /* Tag charged for current traffic    */
+#define SPI_STAT_CS()   (SpiCs[SpiTag]++)
+#define SPI_STAT_SKIP() (SpiSkip[SpiTag]++)
+#else
+#define SPI_STAT_CS()
+#define SPI_STAT_SKIP()
+#endif
+
+#if (GLYPH_CACHE > 0)
+typedef struct {
+  const unsigned char *bits;            /* Font bitmap (font and character)   */
+  unsigned short fg, bg;                /* Colors the glyph was expanded with */
+  unsigned int   used;                  /* LRU time stamp                     */
+  unsigned short pix[16*24];            /* Expanded pixels, row by row        */
+} GLYPH;
+
+static GLYPH        Glyph[GLYPH_CACHE];
+static unsigned int GlyphTick;
+#endif
+
+#define LINE_MAX    ((WIDTH+5)/6)       /* Characters per line, 6x8 font      */
+static const unsigned char *LineBits[LINE_MAX];
+#if (GLYPH_CACHE > 0)
+static GLYPH       *LineGlyph[LINE_MAX];
+#endif
+
+#if (SPI_DMA == 1)
+static unsigned char  DmaBuf[2][DMA_CHUNK] DMA_RAM;
+static volatile unsigned char DmaBusy;  /* Channel 0 transfer in progress     */
+static OS_TID         DmaTid;           /* Task sleeping on DMA completion    */
+#endif
+
+#if (FRAMEBUFFER == 1)
+typedef struct {                        /* Dirty rectangle (inclusive bounds) */
+  unsigned short x0, y0, x1, y1;
+} FB_RECT;
+
+static unsigned int   FbPlane[FB_PLANES][HEIGHT*FB_WPR] FB_RAM;
+static unsigned short FbPal[FB_COLORS]; /* Palette index to RGB565 color      */
+static unsigned char  FbPalUsed;        /* Bit mask of used palette entries   */
+static unsigned char  FbOn;             /* Drawing goes to the frame buffer   */
+static FB_RECT        FbRect[FB_RECTS]; /* Dirty rectangles of current frame  */
+static unsigned char  FbRectCnt;        /* Number of dirty rectangles         */
+#endif
 
 /************************ Local auxiliary functions ***************************/
 
@@ -140,9 +264,64 @@ static unsigned char spi_tran_man (unsigned char byte, unsigned int mode) {
 
 static __inline unsigned char spi_tran (unsigned char byte) {
 
-  LPC_SSP1->DR = byte;
-  while (!(LPC_SSP1->SR & RNE));        /* Wait for send to finish            */
-  return (LPC_SSP1->DR);
+#if (SPI_STATS == 1)
+  SpiBytes[SpiTag]++;
+#endif
+  SSP_WR(byte);
+  while (!(SSP_SR() & RNE));            /* Wait for send to finish            */
+  return (SSP_RD());
+}
+
+
+/*******************************************************************************
+* Queue 1 byte for sending without waiting for it. Received bytes are drained  *
+* and discarded as they come in, spi_sync has to be called before chip select  *
+* is released.                                                                 *
+*   Parameter:    byte:   byte to be sent                                      *
+*   Return:                                                                    *
+*******************************************************************************/
+
+static __inline void spi_put (unsigned char byte) {
+
+#if (SPI_STATS == 1)
+  SpiBytes[SpiTag]++;
+#endif
+  while (SSP_SR() & RNE)
+    SSP_RD();
+  while (!(SSP_SR() & TNF));            /* Wait for room in the TX FIFO       */
+  SSP_WR(byte);
+}
+
+
+/*******************************************************************************
+* Queue 1 byte at the start of a transaction without checking the FIFOs.       *
+* spi_sync left both of them empty, so up to 8 bytes fit this way.             *
+*   Parameter:    byte:   byte to be sent                                      *
+*   Return:                                                                    *
+*******************************************************************************/
+
+static __inline void spi_put_first (unsigned char byte) {
+
+#if (SPI_STATS == 1)
+  SpiBytes[SpiTag]++;
+#endif
+  SSP_WR(byte);
+}
+
+
+/*******************************************************************************
+* Wait until all queued bytes are sent and empty the receive FIFO              *
+*   Parameter:                                                                 *
+*   Return:                                                                    *
+*******************************************************************************/
+
+static __inline void spi_sync (void) {
+  unsigned int sr;
+
+  while ((sr = SSP_SR()) & (BSY | RNE)) {
+    if (sr & RNE)
+      SSP_RD();
+  }
 }
 
 
@@ -154,9 +333,11 @@ static __inline unsigned char spi_tran (unsigned char byte) {
 
 static __inline void wr_cmd (unsigned char cmd) {
   LCD_CS(0);
-  spi_tran(SPI_START | SPI_WR | SPI_INDEX);   /* Write : RS = 0, RW = 0       */
-  spi_tran(0);
-  spi_tran(cmd);
+  SPI_STAT_CS();
+  spi_put_first(SPI_START | SPI_WR | SPI_INDEX);  /* Write : RS = 0, RW = 0    */
+  spi_put_first(0);
+  spi_put_first(cmd);
+  spi_sync();
   LCD_CS(1);
 }
 
@@ -169,9 +350,11 @@ static __inline void wr_cmd (unsigned char cmd) {
 
 static __inline void wr_dat (unsigned short dat) {
   LCD_CS(0);
-  spi_tran(SPI_START | SPI_WR | SPI_DATA);    /* Write : RS = 1, RW = 0       */
-  spi_tran((dat >>   8));                     /* Write D8..D15                */
-  spi_tran((dat & 0xFF));                     /* Write D0..D7                 */
+  SPI_STAT_CS();
+  spi_put_first(SPI_START | SPI_WR | SPI_DATA);  /* Write : RS = 1, RW = 0     */
+  spi_put_first((dat >>   8));                /* Write D8..D15                */
+  spi_put_first((dat & 0xFF));                /* Write D0..D7                 */
+  spi_sync();
   LCD_CS(1);
 }
 
@@ -184,7 +367,8 @@ static __inline void wr_dat (unsigned short dat) {
 
 static __inline void wr_dat_start (void) {
   LCD_CS(0);
-  spi_tran(SPI_START | SPI_WR | SPI_DATA);    /* Write : RS = 1, RW = 0       */
+  SPI_STAT_CS();
+  spi_put_first(SPI_START | SPI_WR | SPI_DATA);  /* Write : RS = 1, RW = 0     */
 }
 
 
@@ -196,6 +380,7 @@ static __inline void wr_dat_start (void) {
 
 static __inline void wr_dat_stop (void) {
 
+  spi_sync();
   LCD_CS(1);
 }
 
@@ -208,8 +393,226 @@ static __inline void wr_dat_stop (void) {
 
 static __inline void wr_dat_only (unsigned short dat) {
 
-  spi_tran((dat >>   8));                     /* Write D8..D15                */
-  spi_tran((dat & 0xFF));                     /* Write D0..D7                 */
+  spi_put((dat >>   8));                      /* Write D8..D15                */
+  spi_put((dat & 0xFF));                      /* Write D0..D7                 */
+}
+
+
+/*******************************************************************************
+* Switch SSP1 to 16-bit frames for a pixel burst (inside wr_dat_start/stop)    *
+*   Parameter:                                                                 *
+*   Return:                                                                    *
+*******************************************************************************/
+
+static void ssp16_begin (void) {
+
+  spi_sync();
+  LPC_SSP1->CR0 = (LPC_SSP1->CR0 & ~DSS_MASK) | DSS_16;
+}
+
+
+/*******************************************************************************
+* Send one color n times as 16-bit frames, keeping the TX FIFO full. Received  *
+* frames are only drained, not waited for.                                     *
+*   Parameter:    color:  pixel color                                          *
+*                 n:      number of pixels                                     *
+*   Return:                                                                    *
+*******************************************************************************/
+
+static void ssp16_fill (unsigned short color, unsigned int n) {
+
+#if (SPI_STATS == 1)
+  SpiBytes[SpiTag] += n*2;
+#endif
+  while (n) {
+    if (SSP_SR() & TNF) {
+      SSP_WR(color);
+      n--;
+    }
+    if (SSP_SR() & RNE)
+      SSP_RD();
+  }
+}
+
+
+/*******************************************************************************
+* Send pixels from memory as 16-bit frames, keeping the TX FIFO full           *
+*   Parameter:    buf:    pixel colors                                         *
+*                 n:      number of pixels                                     *
+*   Return:                                                                    *
+*******************************************************************************/
+
+static void ssp16_write (const unsigned short *buf, unsigned int n) {
+
+#if (SPI_STATS == 1)
+  SpiBytes[SpiTag] += n*2;
+#endif
+  while (n) {
+    if (SSP_SR() & TNF) {
+      SSP_WR(*buf++);
+      n--;
+    }
+    if (SSP_SR() & RNE)
+      SSP_RD();
+  }
+}
+
+
+/*******************************************************************************
+* Send one font row as 16-bit frames, set bits in foreground color             *
+*   Parameter:    pixs:   font row, first pixel in bit 0                       *
+*                 n:      number of pixels                                     *
+*   Return:                                                                    *
+*******************************************************************************/
+
+static void ssp16_bits (unsigned int pixs, unsigned int n) {
+
+#if (SPI_STATS == 1)
+  SpiBytes[SpiTag] += n*2;
+#endif
+  while (n) {
+    if (SSP_SR() & TNF) {
+      SSP_WR(Color[pixs & 1]);
+      pixs >>= 1;
+      n--;
+    }
+    if (SSP_SR() & RNE)
+      SSP_RD();
+  }
+}
+
+
+/*******************************************************************************
+* Wait for the burst to leave SSP1, discard the received frames and switch     *
+* back to 8-bit frames                                                         *
+*   Parameter:                                                                 *
+*   Return:                                                                    *
+*******************************************************************************/
+
+static void ssp16_end (void) {
+
+  spi_sync();
+  LPC_SSP1->CR0 = (LPC_SSP1->CR0 & ~DSS_MASK) | DSS_8;
+}
+
+
+
+#if (SPI_DMA == 1)
+
+/*******************************************************************************
+* Start sending a buffer to SSP1 on GPDMA channel 0                            *
+*   Parameter:    buf:    data to be sent (in AHB SRAM)                        *
+*                 len:    number of bytes (max. DMA_CHUNK)                     *
+*   Return:                                                                    *
+*******************************************************************************/
+
+static void dma_start (unsigned char *buf, unsigned int len) {
+
+#if (SPI_STATS == 1)
+  SpiBytes[SpiTag] += len;
+#endif
+  DmaBusy = 1;
+  IO_WR(LPC_GPDMA->DMACIntTCClear, 0x01);
+  IO_WR(LPC_GPDMA->DMACIntErrClr,  0x01);
+  LPC_GPDMACH0->DMACCSrcAddr  = IO_ADDR(buf);
+  LPC_GPDMACH0->DMACCDestAddr = IO_ADDR(&LPC_SSP1->DR);
+  LPC_GPDMACH0->DMACCLLI      = 0;
+  LPC_GPDMACH0->DMACCControl  = len       |   /* Transfer size                */
+                                (1 << 12) |   /* Source burst: 4              */
+                                (1 << 15) |   /* Destination burst: 4         */
+                                (1 << 26) |   /* Source increment             */
+                                (1UL << 31);  /* Terminal count interrupt     */
+  IO_WR(LPC_GPDMACH0->DMACCConfig,   /* Starts the transfer               */
+        1                  |            /* Channel enable                     */
+        (DMA_SSP1_TX << 6) |            /* Destination: SSP1                  */
+        (1 << 11)          |            /* Memory to peripheral               */
+        (1 << 14)          |            /* Error interrupt                    */
+        (1 << 15));                     /* TC interrupt                       */
+}
+
+
+/*******************************************************************************
+* Wait for the running DMA transfer. The task registered with GLCD_DMAYield    *
+* sleeps on an RTX event, any other caller polls the channel, as the DMA       *
+* interrupt only signals the registered task.                                  *
+*   Parameter:                                                                 *
+*   Return:                                                                    *
+*******************************************************************************/
+
+static void dma_wait (void) {
+
+  if (!DmaBusy)
+    return;
+  if (DmaTid && DmaTid == os_tsk_self())
+    os_evt_wait_or(DMA_EVT, 0xFFFF);
+  while (IO_RD(LPC_GPDMACH0->DMACCConfig) & 1);
+  DmaBusy = 0;
+}
+
+
+/*******************************************************************************
+* Wait until the last DMA data has left SSP1 and discard the received bytes,   *
+* so the following spi_tran calls see their own RX data again                  *
+*   Parameter:                                                                 *
+*   Return:                                                                    *
+*******************************************************************************/
+
+static void dma_finish (void) {
+
+  dma_wait();
+  spi_sync();                           /* Drop RX bytes of the burst         */
+  IO_WR(LPC_SSP1->ICR, RORIC);          /* which overran the RX FIFO          */
+}
+
+
+/*******************************************************************************
+* Send pixels of one color as a DMA burst (inside wr_dat_start/wr_dat_stop)    *
+*   Parameter:    color:  pixel color                                          *
+*                 n:      number of pixels                                     *
+*   Return:               1 if sent, 0 if too short for DMA                    *
+*******************************************************************************/
+
+static int dma_fill (unsigned short color, unsigned int n) {
+  unsigned int i, len;
+
+  if (n < DMA_MIN)
+    return (0);
+
+  /* Buffer content is the same for every chunk, so one buffer is enough     */
+  for (i = 0; i < DMA_CHUNK; i += 2) {
+    DmaBuf[0][i]   = color >>   8;
+    DmaBuf[0][i+1] = color & 0xFF;
+  }
+  while (n) {
+    len = (n*2 > DMA_CHUNK) ? DMA_CHUNK : n*2;
+    dma_wait();
+    dma_start(DmaBuf[0], len);
+    n -= len/2;
+  }
+  dma_finish();
+  return (1);
+}
+
+#else
+#define dma_fill(color, n)  (0)
+#endif
+
+
+/*******************************************************************************
+* Send pixels of one color (inside wr_dat_start/wr_dat_stop), by DMA for long  *
+* bursts and as 16-bit frames otherwise                                        *
+*   Parameter:    color:  pixel color                                          *
+*                 n:      number of pixels                                     *
+*   Return:                                                                    *
+*******************************************************************************/
+
+static void fill_solid (unsigned short color, unsigned int n) {
+
+  if (dma_fill(color, n))
+    return;
+  ssp16_begin();
+  ssp16_fill(color, n);
+  ssp16_end();
 }
 
 
@@ -223,6 +626,7 @@ static __inline unsigned short rd_dat (void) {
   unsigned short val = 0;
 
   LCD_CS(0);
+  SPI_STAT_CS();
   spi_tran(SPI_START | SPI_RD | SPI_DATA);    /* Read: RS = 1, RW = 1         */
   spi_tran(0);                                /* Dummy read 1                 */  
   val   = spi_tran(0);                        /* Read D8..D15                 */
@@ -246,6 +650,39 @@ static __inline void wr_reg (unsigned char reg, unsigned short val) {
 }
 
 
+/*******************************************************************************
+* Set the Himax column/row address registers, skipping those that already      *
+* hold the requested value                                                     *
+*   Parameter:    x, y:   window start                                         *
+*                 xe, ye: window end (inclusive)                               *
+*   Return:                                                                    *
+*******************************************************************************/
+
+static void wr_win_himax (unsigned int x, unsigned int y, unsigned int xe, unsigned int ye) {
+  unsigned char val[8];
+  unsigned int i;
+
+  val[0] = x  >>    8;                  /* Column address start MSB           */
+  val[1] = x  &  0xFF;                  /* Column address start LSB           */
+  val[2] = xe >>    8;                  /* Column address end MSB             */
+  val[3] = xe &  0xFF;                  /* Column address end LSB             */
+  val[4] = y  >>    8;                  /* Row address start MSB              */
+  val[5] = y  &  0xFF;                  /* Row address start LSB              */
+  val[6] = ye >>    8;                  /* Row address end MSB                */
+  val[7] = ye &  0xFF;                  /* Row address end LSB                */
+
+  for (i = 0; i < 8; i++) {
+    if (WinValid && WinReg[i] == val[i]) {
+      SPI_STAT_SKIP();
+      continue;
+    }
+    wr_reg(0x02 + i, val[i]);
+    WinReg[i] = val[i];
+  }
+  WinValid = 1;
+}
+
+
 /*******************************************************************************
 * Read from the LCD register                                                   *
 *   Parameter:    reg:    register to be read                                  *
@@ -294,6 +731,323 @@ static unsigned short rd_id_man (void) {
 }
 
 
+#if (FRAMEBUFFER == 1)
+
+/*******************************************************************************
+* Find or allocate the frame buffer palette index of a color                  *
+*   Parameter:    color:  RGB565 color                                         *
+*   Return:               palette index, -1 if the palette is full             *
+*******************************************************************************/
+
+static int fb_index (unsigned short color) {
+  int i;
+
+  for (i = 0; i < FB_COLORS; i++) {
+    if ((FbPalUsed & (1 << i)) && FbPal[i] == color)
+      return (i);
+  }
+  for (i = 0; i < FB_COLORS; i++) {
+    if (!(FbPalUsed & (1 << i))) {
+      FbPal[i]   = color;
+      FbPalUsed |= 1 << i;
+      return (i);
+    }
+  }
+  return (-1);
+}
+
+
+/*******************************************************************************
+* Free the palette entries no pixel of the frame buffer uses any more          *
+*   Parameter:                                                                 *
+*   Return:                                                                    *
+*******************************************************************************/
+
+static void fb_reclaim (void) {
+  unsigned int w, i, m, used = 0;
+
+  for (w = 0; w < HEIGHT*FB_WPR && used != FbPalUsed; w++) {
+    for (i = 0; i < FB_COLORS; i++) {
+      if (!(FbPalUsed & (1 << i)) || (used & (1 << i)))
+        continue;
+      /* Pixels of the word with palette index i                              */
+      m  = (i & 1) ? FbPlane[0][w] : ~FbPlane[0][w];
+      m &= (i & 2) ? FbPlane[1][w] : ~FbPlane[1][w];
+      m &= (i & 4) ? FbPlane[2][w] : ~FbPlane[2][w];
+#if (WIDTH & 31)
+      if (w % FB_WPR == FB_WPR - 1)     /* Bits past the end of the row       */
+        m &= (1 << (WIDTH & 31)) - 1;
+#endif
+      if (m)
+        used |= 1 << i;
+    }
+  }
+  FbPalUsed = used;
+}
+
+
+/*******************************************************************************
+* Make sure the palette has an entry for every given color. When it is full,   *
+* the dirty regions are sent and the unused entries freed; if the colors do    *
+* not fit even then, the frame buffer is switched off                          *
+*   Parameter:    color:  RGB565 colors                                        *
+*                 n:      number of colors                                     *
+*   Return:               1 if all colors have an entry, 0 if the frame buffer *
+*                         has been switched off                                *
+*******************************************************************************/
+
+static int fb_colors (const unsigned short *color, unsigned int n) {
+  unsigned int i, pass;
+
+  for (pass = 0; pass < 2; pass++) {
+    for (i = 0; i < n; i++) {
+      if ((i == 0 || color[i] != color[i-1]) && fb_index(color[i]) < 0)
+        break;
+    }
+    if (i == n)
+      return (1);
+    GLCD_FB_Flush();
+    if (pass == 0)
+      fb_reclaim();
+  }
+  FbOn = 0;                             /* Write through from now on          */
+  return (0);
+}
+
+
+/*******************************************************************************
+* Read the palette index of a pixel from the frame buffer                      *
+*   Parameter:    x:      horizontal position                                  *
+*                 y:      vertical position                                    *
+*   Return:               palette index                                        *
+*******************************************************************************/
+
+static __inline unsigned int fb_get (unsigned int x, unsigned int y) {
+  unsigned int w = y*FB_WPR + (x >> 5);
+  unsigned int b = x & 31;
+
+  return ((((FbPlane[0][w] >> b) & 1)     ) |
+          (((FbPlane[1][w] >> b) & 1) << 1) |
+          (((FbPlane[2][w] >> b) & 1) << 2));
+}
+
+
+/*******************************************************************************
+* Set a horizontal span of the frame buffer to a palette index                 *
+*   Parameter:    x0:     first horizontal position                            *
+*                 x1:     last horizontal position                             *
+*                 y:      vertical position                                    *
+*                 idx:    palette index                                        *
+*   Return:               non-zero if any pixel has changed                    *
+*******************************************************************************/
+
+static unsigned int fb_span (unsigned int x0, unsigned int x1, unsigned int y, unsigned int idx) {
+  unsigned int w, ws, we, p, mask, old, val;
+  unsigned int chg = 0;
+
+  ws = y*FB_WPR + (x0 >> 5);
+  we = y*FB_WPR + (x1 >> 5);
+
+  for (w = ws; w <= we; w++) {
+    mask = 0xFFFFFFFF;
+    if (w == ws) mask &= 0xFFFFFFFF << (x0 & 31);
+    if (w == we) mask &= 0xFFFFFFFF >> (31 - (x1 & 31));
+
+    for (p = 0; p < FB_PLANES; p++) {
+      old = FbPlane[p][w];
+      val = (idx & (1 << p)) ? (old | mask) : (old & ~mask);
+      chg |= old ^ val;
+      FbPlane[p][w] = val;
+    }
+  }
+  return (chg);
+}
+
+
+/*******************************************************************************
+* Number of pixels covered by a dirty rectangle                                *
+*   Parameter:    r:      pointer to rectangle                                 *
+*   Return:               area in pixels                                       *
+*******************************************************************************/
+
+static __inline int fb_area (FB_RECT *r) {
+
+  return ((r->x1 - r->x0 + 1) * (r->y1 - r->y0 + 1));
+}
+
+
+/*******************************************************************************
+* Record a dirty rectangle, merging it with the recorded ones where the merge  *
+* costs at most FB_SLACK clean pixels (or always when the list is full)        *
+*   Parameter:    x0, y0: top left corner                                      *
+*                 x1, y1: bottom right corner (inclusive)                      *
+*   Return:                                                                    *
+*******************************************************************************/
+
+static void fb_dirty (unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1) {
+  FB_RECT r, u;
+  int i, best, cost, bestCost;
+
+  r.x0 = x0; r.y0 = y0; r.x1 = x1; r.y1 = y1;
+
+  while (1) {
+    best     = -1;
+    bestCost = 0x7FFFFFFF;
+    for (i = 0; i < FbRectCnt; i++) {
+      u.x0 = (FbRect[i].x0 < r.x0) ? FbRect[i].x0 : r.x0;
+      u.y0 = (FbRect[i].y0 < r.y0) ? FbRect[i].y0 : r.y0;
+      u.x1 = (FbRect[i].x1 > r.x1) ? FbRect[i].x1 : r.x1;
+      u.y1 = (FbRect[i].y1 > r.y1) ? FbRect[i].y1 : r.y1;
+      cost = fb_area(&u) - fb_area(&FbRect[i]) - fb_area(&r);
+      if (cost < bestCost) {
+        bestCost = cost;
+        best     = i;
+      }
+    }
+
+    if (best < 0 || (bestCost > FB_SLACK && FbRectCnt < FB_RECTS)) {
+      FbRect[FbRectCnt++] = r;          /* Keep as a separate rectangle       */
+      return;
+    }
+
+    /* Merge with the cheapest rectangle and retry, the union may now touch
+       other rectangles as well                                               */
+    if (FbRect[best].x0 < r.x0) r.x0 = FbRect[best].x0;
+    if (FbRect[best].y0 < r.y0) r.y0 = FbRect[best].y0;
+    if (FbRect[best].x1 > r.x1) r.x1 = FbRect[best].x1;
+    if (FbRect[best].y1 > r.y1) r.y1 = FbRect[best].y1;
+    FbRect[best] = FbRect[--FbRectCnt];
+  }
+}
+
+
+/*******************************************************************************
+* Fill a rectangle in the frame buffer and record it as dirty if it changed    *
+*   Parameter:    x:      horizontal position                                  *
+*                 y:      vertical position                                    *
+*                 w:      rectangle width in pixels                            *
+*                 h:      rectangle height in pixels                           *
+*                 color:  fill color                                           *
+*   Return:               1 if handled, 0 if it has to be written to the LCD   *
+*******************************************************************************/
+
+static int fb_fill (unsigned int x, unsigned int y, unsigned int w, unsigned int h, unsigned short color) {
+  unsigned int j;
+  unsigned int chg = 0;
+  int idx;
+
+  if (!FbOn)
+    return (0);
+
+  if (!fb_colors(&color, 1))            /* Palette full, write through        */
+    return (0);
+  idx = fb_index(color);
+
+  if (x >= WIDTH || y >= HEIGHT || w == 0 || h == 0)
+    return (1);
+  if (x+w > WIDTH)  w = WIDTH  - x;
+  if (y+h > HEIGHT) h = HEIGHT - y;
+
+  for (j = y; j < y+h; j++)
+    chg |= fb_span(x, x+w-1, j, idx);
+
+  if (chg)
+    fb_dirty(x, y, x+w-1, y+h-1);
+  return (1);
+}
+
+
+
+/*******************************************************************************
+* Draw a 1 bit per pixel sprite into the frame buffer                          *
+*   Parameter:    x, y, w, h, bits, opaque: see GLCD_DrawSprite                *
+*   Return:               1 if handled, 0 if it has to be written to the LCD   *
+*******************************************************************************/
+
+static int fb_sprite (unsigned int x, unsigned int y, unsigned int w, unsigned int h,
+                      const unsigned short *bits, unsigned char opaque) {
+  unsigned int i, j, s, b, pixs;
+  unsigned int chg = 0;
+  unsigned short col[2];
+  int idx[2];
+
+  if (!FbOn)
+    return (0);
+
+  col[0] = Color[TXT_COLOR];
+  col[1] = Color[BG_COLOR];
+  if (!fb_colors(col, opaque ? 2 : 1))  /* Palette full, write through        */
+    return (0);
+  idx[1] = fb_index(col[0]);
+  idx[0] = opaque ? fb_index(col[1]) : 0;
+
+  if (x >= WIDTH || y >= HEIGHT || w == 0 || h == 0)
+    return (1);
+  if (x+w > WIDTH)  w = WIDTH  - x;
+  if (y+h > HEIGHT) h = HEIGHT - y;
+
+  for (j = 0; j < h; j++) {
+    pixs = bits[j];
+    /* Fill each run of equal bits, skip clear runs if transparent            */
+    for (i = 0; i < w; i = s) {
+      b = (pixs >> i) & 1;
+      for (s = i + 1; s < w && ((pixs >> s) & 1) == b; s++);
+      if (b || opaque)
+        chg |= fb_span(x+i, x+s-1, y+j, idx[b]);
+    }
+  }
+
+  if (chg)
+    fb_dirty(x, y, x+w-1, y+h-1);
+  return (1);
+}
+
+
+
+/*******************************************************************************
+* Draw a GLCD_TILE x GLCD_TILE RGB565 tile into the frame buffer               *
+*   Parameter:    x, y, tile: see GLCD_BlitTile                                *
+*   Return:               1 if handled, 0 if it has to be written to the LCD   *
+*******************************************************************************/
+
+static int fb_tile (unsigned int x, unsigned int y, const unsigned short *tile) {
+  unsigned int i, j, s, w, h;
+  unsigned int chg = 0;
+  const unsigned short *row;
+
+  if (!FbOn)
+    return (0);
+
+  /* Every color of the tile needs a palette entry, else write through       */
+  if (!fb_colors(tile, GLCD_TILE*GLCD_TILE))
+    return (0);
+
+  if (x >= WIDTH || y >= HEIGHT)
+    return (1);
+  w = (x+GLCD_TILE > WIDTH)  ? WIDTH  - x : GLCD_TILE;
+  h = (y+GLCD_TILE > HEIGHT) ? HEIGHT - y : GLCD_TILE;
+
+  for (j = 0; j < h; j++) {
+    row = &tile[j*GLCD_TILE];
+    /* Fill each run of one color                                             */
+    for (i = 0; i < w; i = s) {
+      for (s = i + 1; s < w && row[s] == row[i]; s++);
+      chg |= fb_span(x+i, x+s-1, y+j, fb_index(row[i]));
+    }
+  }
+
+  if (chg)
+    fb_dirty(x, y, x+w-1, y+h-1);
+  return (1);
+}
+
+#else
+#define fb_fill(x, y, w, h, color)                (0)
+#define fb_sprite(x, y, w, h, bits, opaque)       (0)
+#define fb_tile(x, y, tile)                       (0)
+#endif
+
+
 /************************ Exported functions **********************************/
 
 /*******************************************************************************
@@ -312,11 +1066,11 @@ void GLCD_Init (void) {
   /* Configure the LCD Control pins                                           */
   LPC_PINCON->PINSEL9 &= 0xF0FFFFFF;
   LPC_GPIO4->FIODIR   |= 0x30000000;
-  LPC_GPIO4->FIOSET    = 0x20000000;
+  IO_WR(LPC_GPIO4->FIOSET, 0x20000000);
 
   /* SSEL1 is GPIO output set to high                                         */
   LPC_GPIO0->FIODIR   |= 0x00000040;
-  LPC_GPIO0->FIOSET    = 0x00000040;
+  IO_WR(LPC_GPIO0->FIOSET, 0x00000040);
   LPC_PINCON->PINSEL0 &= 0xFFF03FFF;
   LPC_PINCON->PINSEL0 |= 0x000A8000;
 
@@ -325,6 +1079,16 @@ void GLCD_Init (void) {
   LPC_SSP1->CR0        = 0x01C7;
   LPC_SSP1->CPSR       = 0x02;
   LPC_SSP1->CR1        = 0x02;
+
+#if (SPI_DMA == 1)
+  /* Enable GPDMA for SSP1 transmit bursts                                    */
+  LPC_SC->PCONP       |= (1 << 29);
+  LPC_GPDMA->DMACConfig     = 0x01;
+  IO_WR(LPC_GPDMA->DMACIntTCClear, 0x01);
+  IO_WR(LPC_GPDMA->DMACIntErrClr,  0x01);
+  LPC_SSP1->DMACR      = TXDMAE;
+  NVIC_EnableIRQ(DMA_IRQn);
+#endif
   
   driverCode = rd_id_man ();
   if (driverCode == 0) {
@@ -333,6 +1097,7 @@ void GLCD_Init (void) {
 
   if (driverCode == 0x47) {             /* LCD with HX8347-D LCD Controller   */
     Himax = 1;                          /* Set Himax LCD controller flag      */
+    WinValid = 0;                       /* Window registers are unknown       */
     /* Driving ability settings ----------------------------------------------*/
     wr_reg(0xEA, 0x00);                 /* Power control internal used (1)    */
     wr_reg(0xEB, 0x20);                 /* Power control internal used (2)    */
@@ -569,7 +1334,7 @@ void GLCD_Init (void) {
 
     wr_reg(0x07, 0x0137);               /* 262K color and display ON          */
   }
-  LPC_GPIO4->FIOSET = 0x10000000;
+  IO_WR(LPC_GPIO4->FIOSET, 0x10000000);
 }
 
 
@@ -589,15 +1354,7 @@ void GLCD_SetWindow (unsigned int x, unsigned int y, unsigned int w, unsigned in
     xe = x+w-1;
     ye = y+h-1;
 
-    wr_reg(0x02, x  >>    8);           /* Column address start MSB           */
-    wr_reg(0x03, x  &  0xFF);           /* Column address start LSB           */
-    wr_reg(0x04, xe >>    8);           /* Column address end MSB             */
-    wr_reg(0x05, xe &  0xFF);           /* Column address end LSB             */
-  
-    wr_reg(0x06, y  >>    8);           /* Row address start MSB              */
-    wr_reg(0x07, y  &  0xFF);           /* Row address start LSB              */
-    wr_reg(0x08, ye >>    8);           /* Row address end MSB                */
-    wr_reg(0x09, ye &  0xFF);           /* Row address end LSB                */
+    wr_win_himax(x, y, xe, ye);
   }
   else {
    #if (LANDSCAPE == 1)
@@ -639,16 +1396,11 @@ void GLCD_WindowMax (void) {
 
 void GLCD_PutPixel (unsigned int x, unsigned int y) {
 
+  if (fb_fill(x, y, 1, 1, Color[TXT_COLOR]))
+    return;
+
   if (Himax) {
-    wr_reg(0x02, x >>    8);            /* Column address start MSB           */
-    wr_reg(0x03, x &  0xFF);            /* Column address start LSB           */
-    wr_reg(0x04, x >>    8);            /* Column address end MSB             */
-    wr_reg(0x05, x &  0xFF);            /* Column address end LSB             */
-  
-    wr_reg(0x06, y >>    8);            /* Row address start MSB              */
-    wr_reg(0x07, y &  0xFF);            /* Row address start LSB              */
-    wr_reg(0x08, y >>    8);            /* Row address end MSB                */
-    wr_reg(0x09, y &  0xFF);            /* Row address end LSB                */
+    wr_win_himax(x, y, x, y);
   }
   else {
    #if (LANDSCAPE == 1)
@@ -673,16 +1425,11 @@ void GLCD_PutPixel (unsigned int x, unsigned int y) {
 
 void GLCD_RemovePixel (unsigned int x, unsigned int y) {
 
+  if (fb_fill(x, y, 1, 1, Color[BG_COLOR]))
+    return;
+
   if (Himax) {
-    wr_reg(0x02, x >>    8);            /* Column address start MSB           */
-    wr_reg(0x03, x &  0xFF);            /* Column address start LSB           */
-    wr_reg(0x04, x >>    8);            /* Column address end MSB             */
-    wr_reg(0x05, x &  0xFF);            /* Column address end LSB             */
-  
-    wr_reg(0x06, y >>    8);            /* Row address start MSB              */
-    wr_reg(0x07, y &  0xFF);            /* Row address start LSB              */
-    wr_reg(0x08, y >>    8);            /* Row address end MSB                */
-    wr_reg(0x09, y &  0xFF);            /* Row address end LSB                */
+    wr_win_himax(x, y, x, y);
   }
   else {
    #if (LANDSCAPE == 1)
@@ -730,18 +1477,224 @@ void GLCD_SetBackColor (unsigned short color) {
 *******************************************************************************/
 
 void GLCD_Clear (unsigned short color) {
-  unsigned int i;
+  if (fb_fill(0, 0, WIDTH, HEIGHT, color))
+    return;
 
   GLCD_WindowMax();
   wr_cmd(0x22);
   wr_dat_start();
 
-  for(i = 0; i < (WIDTH*HEIGHT); i++)
-    wr_dat_only(color);
+  fill_solid(color, WIDTH*HEIGHT);
   wr_dat_stop();
 }
 
 
+/*******************************************************************************
+* Fill rectangle with a color in a single data burst                           *
+*   Parameter:      x:        horizontal position                              *
+*                   y:        vertical position                                *
+*                   w:        rectangle width in pixels                        *
+*                   h:        rectangle height in pixels                       *
+*                   color:    fill color                                       *
+*   Return:                                                                    *
+*******************************************************************************/
+
+void GLCD_FillRect (unsigned int x, unsigned int y, unsigned int w, unsigned int h, unsigned short color) {
+  if (w == 0 || h == 0)
+    return;
+  if (fb_fill(x, y, w, h, color))
+    return;
+
+  GLCD_SetWindow(x, y, w, h);
+  wr_cmd(0x22);
+  wr_dat_start();
+
+  fill_solid(color, w*h);
+  wr_dat_stop();
+}
+
+
+/*******************************************************************************
+* Draw a 1 bit per pixel sprite, set bits in foreground color. An opaque       *
+* sprite draws clear bits in background color as one window burst, a           *
+* transparent one leaves them untouched and draws each run of set bits.        *
+*   Parameter:      x:        horizontal position                              *
+*                   y:        vertical position                                *
+*                   w:        sprite width in pixels (max. 16)                 *
+*                   h:        sprite height in pixels                          *
+*                   bits:     one row per entry, bit i is pixel x+i            *
+*                   opaque:   1 for opaque, 0 for transparent                  *
+*   Return:                                                                    *
+*******************************************************************************/
+
+void GLCD_DrawSprite (unsigned int x, unsigned int y, unsigned int w, unsigned int h,
+                      const unsigned short *bits, unsigned char opaque) {
+  unsigned int i, j, s, pixs;
+
+  if (fb_sprite(x, y, w, h, bits, opaque))
+    return;
+
+  if (opaque) {
+    GLCD_SetWindow(x, y, w, h);
+    wr_cmd(0x22);
+    wr_dat_start();
+    for (j = 0; j < h; j++) {
+      pixs = bits[j];
+      for (i = 0; i < w; i++)
+        wr_dat_only(Color[(pixs >> i) & 1]);
+    }
+    wr_dat_stop();
+  }
+  else {
+    for (j = 0; j < h; j++) {
+      pixs = bits[j];
+      for (i = 0; i < w; i = s) {
+        if (!((pixs >> i) & 1)) {
+          s = i + 1;
+          continue;
+        }
+        for (s = i + 1; s < w && ((pixs >> s) & 1); s++);
+        GLCD_FillRect(x+i, y+j, s-i, 1, Color[TXT_COLOR]);
+      }
+    }
+  }
+}
+
+
+/*******************************************************************************
+* Draw count copies of an opaque 1 bit per pixel sprite side by side in one    *
+* window burst                                                                 *
+*   Parameter:      x:        horizontal position of the first copy            *
+*                   y:        vertical position                                *
+*                   w:        sprite width in pixels (max. 16)                 *
+*                   h:        sprite height in pixels                          *
+*                   bits:     one row per entry, bit i is pixel x+i            *
+*                   count:    number of copies                                 *
+*   Return:                                                                    *
+*******************************************************************************/
+
+void GLCD_DrawSpriteRun (unsigned int x, unsigned int y, unsigned int w, unsigned int h,
+                         const unsigned short *bits, unsigned int count) {
+  unsigned int i, j, k, pixs;
+
+  if (count == 0)
+    return;
+
+  if (fb_sprite(x, y, w, h, bits, 1)) {
+    for (k = 1; k < count; k++)
+      fb_sprite(x + k*w, y, w, h, bits, 1);
+    return;
+  }
+
+  GLCD_SetWindow(x, y, w*count, h);
+  wr_cmd(0x22);
+  wr_dat_start();
+  for (j = 0; j < h; j++) {
+    pixs = bits[j];
+    for (k = 0; k < count; k++) {
+      for (i = 0; i < w; i++)
+        wr_dat_only(Color[(pixs >> i) & 1]);
+    }
+  }
+  wr_dat_stop();
+}
+
+
+/*******************************************************************************
+* Draw a GLCD_TILE x GLCD_TILE tile of RGB565 pixels in one window burst       *
+*   Parameter:      x:        horizontal position                              *
+*                   y:        vertical position                                *
+*                   tile:     pixels row by row, GLCD_TILE per row             *
+*   Return:                                                                    *
+*******************************************************************************/
+
+void GLCD_BlitTile (unsigned int x, unsigned int y, const unsigned short *tile) {
+
+  if (fb_tile(x, y, tile))
+    return;
+
+  GLCD_SetWindow(x, y, GLCD_TILE, GLCD_TILE);
+  wr_cmd(0x22);
+  wr_dat_start();
+  ssp16_begin();
+  ssp16_write(tile, GLCD_TILE*GLCD_TILE);
+  ssp16_end();
+  wr_dat_stop();
+}
+
+
+/*******************************************************************************
+* Read one row of a font bitmap                                                *
+*   Parameter:    c:      font bitmap of the character                         *
+*                 cw:     character width in pixels                            *
+*                 j:      row number                                           *
+*   Return:               row bits, first pixel in bit 0                       *
+*******************************************************************************/
+
+static unsigned int font_row (const unsigned char *c, unsigned int cw, unsigned int j) {
+
+  if (cw <= 8)
+    return (c[j]);
+  return (((const unsigned short *)c)[j]);
+}
+
+
+#if (GLYPH_CACHE > 0)
+/*******************************************************************************
+* Find a glyph in the cache for the current colors                             *
+*   Parameter:    c:      font bitmap of the character                         *
+*   Return:               cache entry, 0 if not cached                         *
+*******************************************************************************/
+
+static GLYPH *glyph_find (const unsigned char *c) {
+  unsigned int i;
+
+  for (i = 0; i < GLYPH_CACHE; i++) {
+    if (Glyph[i].bits == c && Glyph[i].fg == Color[TXT_COLOR] &&
+                              Glyph[i].bg == Color[BG_COLOR]) {
+      Glyph[i].used = ++GlyphTick;
+      return (&Glyph[i]);
+    }
+  }
+  return (0);
+}
+
+
+/*******************************************************************************
+* Expand a glyph into the least recently used cache entry                      *
+*   Parameter:    c:      font bitmap of the character                         *
+*                 cw, ch: character width and height in pixels                 *
+*                 keep:   entries used at or after this stamp are not evicted  *
+*   Return:               cache entry, 0 if all entries are to be kept         *
+*******************************************************************************/
+
+static GLYPH *glyph_add (const unsigned char *c, unsigned int cw, unsigned int ch, unsigned int keep) {
+  unsigned int i, j, pixs;
+  unsigned short *p;
+  GLYPH *g = &Glyph[0];
+
+  for (i = 1; i < GLYPH_CACHE; i++) {
+    if (Glyph[i].used < g->used)
+      g = &Glyph[i];
+  }
+  if (g->bits && g->used >= keep)
+    return (0);
+
+  g->bits = c;
+  g->fg   = Color[TXT_COLOR];
+  g->bg   = Color[BG_COLOR];
+  g->used = ++GlyphTick;
+  p = g->pix;
+  for (j = 0; j < ch; j++) {
+    pixs = font_row(c, cw, j);
+    for (i = 0; i < cw; i++, pixs >>= 1)
+      *p++ = Color[pixs & 1];
+  }
+  return (g);
+}
+#endif
+
+
 /*******************************************************************************
 * Draw character on given position                                             *
 *   Parameter:      x:        horizontal position                              *
@@ -753,35 +1706,29 @@ void GLCD_Clear (unsigned short color) {
 *******************************************************************************/
 
 void GLCD_DrawChar (unsigned int x, unsigned int y, unsigned int cw, unsigned int ch, unsigned char *c) {
-  unsigned int i, j, k, pixs;
+#if (GLYPH_CACHE > 0)
+  GLYPH *g;
+
+  g = glyph_find(c);
+  if (g == 0)
+    g = glyph_add(c, cw, ch, ~0U);
+#else
+  unsigned int j;
+#endif
 
   GLCD_SetWindow(x, y, cw, ch);
 
   wr_cmd(0x22);
   wr_dat_start();
+  ssp16_begin();
 
-  k  = (cw + 7)/8;
-
-  if (k == 1) {
-    for (j = 0; j < ch; j++) {
-      pixs = *(unsigned char  *)c;
-      c += 1;
-      
-      for (i = 0; i < cw; i++) {
-        wr_dat_only (Color[(pixs >> i) & 1]);
-      }
-    }
-  }
-  else if (k == 2) {
-    for (j = 0; j < ch; j++) {
-      pixs = *(unsigned short *)c;
-      c += 2;
-      
-      for (i = 0; i < cw; i++) {
-        wr_dat_only (Color[(pixs >> i) & 1]);
-      }
-    }
-  }
+#if (GLYPH_CACHE > 0)
+  ssp16_write(g->pix, cw*ch);
+#else
+  for (j = 0; j < ch; j++)
+    ssp16_bits(font_row(c, cw, j), cw);
+#endif
+  ssp16_end();
   wr_dat_stop();
 }
 
@@ -819,10 +1766,65 @@ void GLCD_DisplayChar (unsigned int ln, unsigned int col, unsigned char fi, unsi
 *******************************************************************************/
 
 void GLCD_DisplayString (unsigned int ln, unsigned int col, unsigned char fi, unsigned char *s) {
+  const unsigned char *font;
+  unsigned int cw, ch, csz, x, y, w, n, m, j, cols;
+#if (GLYPH_CACHE > 0)
+  unsigned int keep = GlyphTick + 1;
+#endif
 
-  while (*s) {
-    GLCD_DisplayChar(ln, col++, fi, *s++);
+  switch (fi) {
+    case 0:  /* Font 6 x 8 */
+      font = (const unsigned char *)Font_6x8_h;
+      cw = 6;  ch = 8;  csz = 8;
+      break;
+    case 1:  /* Font 16 x 24 */
+      font = (const unsigned char *)Font_16x24_h;
+      cw = 16; ch = 24; csz = 48;
+      break;
+    default:
+      return;
+  }
+  x = col * cw;
+  y = ln  * ch;
+  if (x >= WIDTH || y + ch > HEIGHT)
+    return;
+
+  /* Resolve the glyphs first: cached ones are sent from the cache, the rest
+     are expanded from the font while sending. Glyphs of this line are not
+     evicted by later characters of the same line.                            */
+  for (n = 0; s[n] && n < LINE_MAX && x + n*cw < WIDTH; n++) {
+    LineBits[n] = font + (s[n] - 32) * csz;
+#if (GLYPH_CACHE > 0)
+    LineGlyph[n] = glyph_find(LineBits[n]);
+    if (LineGlyph[n] == 0)
+      LineGlyph[n] = glyph_add(LineBits[n], cw, ch, keep);
+#endif
+  }
+  if (n == 0)
+    return;
+
+  /* Whole line in one window, the last character may be cut at the edge     */
+  w = n * cw;
+  if (x + w > WIDTH)
+    w = WIDTH - x;
+  GLCD_SetWindow(x, y, w, ch);
+  wr_cmd(0x22);
+  wr_dat_start();
+  ssp16_begin();
+  for (j = 0; j < ch; j++) {
+    for (m = 0; m < n; m++) {
+      cols = (m == n-1) ? w - m*cw : cw;
+#if (GLYPH_CACHE > 0)
+      if (LineGlyph[m]) {
+        ssp16_write(&LineGlyph[m]->pix[j*cw], cols);
+        continue;
+      }
+#endif
+      ssp16_bits(font_row(LineBits[m], cw, j), cols);
+    }
   }
+  ssp16_end();
+  wr_dat_stop();
 }
 
 
@@ -957,6 +1959,212 @@ void GLCD_WrCmd (unsigned char cmd) {
 *   Return:                                                                    *
 *******************************************************************************/
 void GLCD_WrReg (unsigned char reg, unsigned short val) {
+  if (reg >= 0x02 && reg <= 0x09)
+    WinValid = 0;                       /* Bypasses the window shadow         */
   wr_reg (reg, val);
 }
+
+
+/*******************************************************************************
+* Select the statistics tag that following SSP1 traffic is charged to          *
+*   Parameter:      tag:      tag number (0 .. SPI_TAGS-1)                     *
+*   Return:                   previously selected tag                          *
+*******************************************************************************/
+unsigned char GLCD_StatsTag (unsigned char tag) {
+#if (SPI_STATS == 1)
+  unsigned char prev = SpiTag;
+
+  if (tag < SPI_TAGS)
+    SpiTag = tag;
+  return (prev);
+#else
+  return (0);
+#endif
+}
+
+
+/*******************************************************************************
+* Read the SSP1 traffic charged to a tag since its last reset. The wire time   *
+* is estimated from the configured SSP1 clock (CCLK/2 / CPSR / (SCR+1)).       *
+*   Parameter:      tag:      tag number (0 .. SPI_TAGS-1)                     *
+*                   st:       statistics output (all 0 if SPI_STATS disabled)  *
+*                   reset:    1 to reset the tag counters after reading them   *
+*   Return:                                                                    *
+*******************************************************************************/
+void GLCD_Stats (unsigned char tag, GLCD_STATS *st, unsigned char reset) {
+#if (SPI_STATS == 1)
+  unsigned long long bits;
+  unsigned int div;
+
+  if (tag >= SPI_TAGS) {
+    st->bytes = st->cs = st->skipped = st->wire_us = 0;
+    return;
+  }
+  st->bytes   = SpiBytes[tag];
+  st->cs      = SpiCs[tag];
+  st->skipped = SpiSkip[tag];
+
+  div  = (LPC_SSP1->CPSR & 0xFF) * (((LPC_SSP1->CR0 >> 8) & 0xFF) + 1);
+  bits = (unsigned long long)st->bytes * 8 * div;
+  st->wire_us = (unsigned int)(bits / (SystemCoreClock / 2 / 1000000));
+
+  if (reset) {
+    SpiBytes[tag] = 0;
+    SpiCs[tag]    = 0;
+    SpiSkip[tag]  = 0;
+  }
+#else
+  st->bytes = st->cs = st->skipped = st->wire_us = 0;
+#endif
+}
+
+
+/*******************************************************************************
+* Number of bytes transferred over SSP1 since the last reset, for all tags     *
+*   Parameter:      reset:    1 to reset the counters after reading them       *
+*   Return:                   byte count (always 0 if SPI_STATS is disabled)   *
+*******************************************************************************/
+unsigned int GLCD_SpiBytes (unsigned char reset) {
+#if (SPI_STATS == 1)
+  unsigned int i, cnt = 0;
+
+  for (i = 0; i < SPI_TAGS; i++) {
+    cnt += SpiBytes[i];
+    if (reset) {
+      SpiBytes[i] = 0;
+      SpiCs[i]    = 0;
+      SpiSkip[i]  = 0;
+    }
+  }
+  return (cnt);
+#else
+  return (0);
+#endif
+}
+
+
+/*******************************************************************************
+* Enable or disable the off-screen frame buffer. When enabled, GLCD_PutPixel,  *
+* GLCD_RemovePixel, GLCD_FillRect and GLCD_Clear only update the buffer and    *
+* GLCD_FB_Flush sends the changed regions. The buffer starts out filled with   *
+* the background color, so enable it right after clearing the screen. Text     *
+* and bitmaps are always written directly to the LCD. If more than 8 colors    *
+* are on screen at once, the buffer is flushed and switched off.               *
+*   Parameter:      on:       1 to enable, 0 to disable (drops pending data)   *
+*   Return:                                                                    *
+*******************************************************************************/
+void GLCD_FB_Enable (unsigned char on) {
+#if (FRAMEBUFFER == 1)
+  unsigned int i, p;
+
+  FbOn      = 0;
+  FbRectCnt = 0;
+  if (on) {
+    FbPalUsed = 0;
+    fb_index(Color[BG_COLOR]);          /* Palette index 0 is the background  */
+    for (p = 0; p < FB_PLANES; p++) {
+      for (i = 0; i < HEIGHT*FB_WPR; i++)
+        FbPlane[p][i] = 0;
+    }
+    FbOn = 1;
+  }
+#endif
+}
+
+
+/*******************************************************************************
+* Send the dirty regions of the frame buffer to the LCD                        *
+*   Parameter:                                                                 *
+*   Return:                                                                    *
+*******************************************************************************/
+void GLCD_FB_Flush (void) {
+#if (FRAMEBUFFER == 1)
+  unsigned int i, x, y, n, idx;
+  FB_RECT *r;
+#if (SPI_DMA == 1)
+  unsigned int len, k;
+  unsigned short c;
+#endif
+
+  for (i = 0; i < FbRectCnt; i++) {
+    r = &FbRect[i];
+    GLCD_SetWindow(r->x0, r->y0, r->x1 - r->x0 + 1, r->y1 - r->y0 + 1);
+    wr_cmd(0x22);
+    wr_dat_start();
+#if (SPI_DMA == 1)
+    if (fb_area(r) >= DMA_MIN) {
+      /* Fill one buffer while the other one is being sent                    */
+      x = r->x0;
+      y = r->y0;
+      k = 0;
+      while (y <= r->y1) {
+        for (len = 0; len < DMA_CHUNK && y <= r->y1; len += 2) {
+          c = FbPal[fb_get(x, y)];
+          DmaBuf[k][len]   = c >>   8;
+          DmaBuf[k][len+1] = c & 0xFF;
+          if (++x > r->x1) {
+            x = r->x0;
+            y++;
+          }
+        }
+        dma_wait();
+        dma_start(DmaBuf[k], len);
+        k ^= 1;
+      }
+      dma_finish();
+      wr_dat_stop();
+      continue;
+    }
+#endif
+    /* Send runs of equal pixels as 16-bit frames                             */
+    ssp16_begin();
+    for (y = r->y0; y <= r->y1; y++) {
+      for (x = r->x0; x <= r->x1; x += n) {
+        idx = fb_get(x, y);
+        for (n = 1; x + n <= r->x1 && fb_get(x + n, y) == idx; n++);
+        ssp16_fill(FbPal[idx], n);
+      }
+    }
+    ssp16_end();
+    wr_dat_stop();
+  }
+  FbRectCnt = 0;
+#endif
+}
+
+
+/*******************************************************************************
+* Let bursts started by the calling task sleep on an RTX event while the DMA   *
+* runs, instead of polling. Has to be called from a task, bursts of other     *
+* tasks keep polling.                                                          *
+*   Parameter:      on:       1 to sleep, 0 to poll                            *
+*   Return:                                                                    *
+*******************************************************************************/
+void GLCD_DMAYield (unsigned char on) {
+#if (SPI_DMA == 1)
+  DmaTid = on ? os_tsk_self() : 0;
+#endif
+}
+
+
+/*******************************************************************************
+* GPDMA interrupt: wakes the task waiting for a DMA burst                      *
+*   Parameter:                                                                 *
+*   Return:                                                                    *
+*******************************************************************************/
+#if (SPI_DMA == 1)
+void DMA_IRQHandler (void) {
+
+  if (IO_RD(LPC_GPDMA->DMACIntTCStat) & 0x01) {
+    IO_WR(LPC_GPDMA->DMACIntTCClear, 0x01);
+    if (DmaTid)
+      isr_evt_set(DMA_EVT, DmaTid);
+  }
+  if (IO_RD(LPC_GPDMA->DMACIntErrStat) & 0x01) {
+    IO_WR(LPC_GPDMA->DMACIntErrClr, 0x01);
+    if (DmaTid)
+      isr_evt_set(DMA_EVT, DmaTid);
+  }
+}
+#endif
 /******************************************************************************/
@@ -9,10 +9,11 @@
 *
 * Copyright (c) 2014. All rights reserved.
 *----------------------------------------------------------------------------*/
-#include <LPC17xx.h>
 #include <stdlib.h>
-#include "glcd.h"
-#include "glcd_scroll.h"
+#include <string.h>
+#include "GLCD.h"
+#include "GLCD_Scroll.h"
+#include "hal.h"
 
 #define SCREEN_SIZE  			(LCD_WIDTH * LCD_HEIGTH)
 
@@ -26,6 +27,9 @@ short int last_col_cahche = 0;
 
 uint32_t window_start = 0, window_size = 0;
 
+//What the screen shows, a space where nothing is drawn
+uint8_t shown[LCD_HEIGTH][LCD_WIDTH];
+
 
 void init_scroll( void ) {
 	GLCD_Init(); 
@@ -33,6 +37,7 @@ void init_scroll( void ) {
 	GLCD_Clear(BGC);
 	GLCD_SetBackColor(BGC);
 	GLCD_SetTextColor(TXC);
+	memset(shown, ' ', sizeof(shown));
 		
 	cache_start = 0;
 	cache_size = 0;
@@ -50,16 +55,46 @@ __inline uint32_t last_window_line( void ) {
 	return (window_start + window_size) % CACHE_LINE_CAP;
 }
 
+/*
+	Draw a window line, padded with spaces to the full width. Only the characters
+	that differ from what the screen shows are drawn, each run of them as one string.
+*/
+void draw_line( uint32_t line, uint8_t *str ) {
+	uint8_t want[LCD_WIDTH];
+	uint8_t buf[LCD_WIDTH + 1];
+	size_t	i = 0, n;
+
+	for ( ; i < LCD_WIDTH && str[i] != 0x0; ++i ) {
+		want[i] = str[i];
+	}
+	for ( ; i < LCD_WIDTH; ++i ) {
+		want[i] = ' ';
+	}
+
+	for ( i = 0; i < LCD_WIDTH; ) {
+		if ( want[i] == shown[line][i] ) {
+			++i;
+			continue;
+		}
+		for ( n = 0; i + n < LCD_WIDTH && want[i + n] != shown[line][i + n]; ++n ) {
+			buf[n] = want[i + n];
+			shown[line][i + n] = want[i + n];
+		}
+		buf[n] = 0x0;
+		GLCD_DisplayString  (line, i, FONT_SIZE, buf);
+		i += n;
+	}
+}
+
 /*
 	Referesh the screen based on the stored characer in the linked list.
 */
 
 void refresh_lcd( void ) {
 	size_t	i = 0;
-	GLCD_Clear(BGC);
 	
-	for (i = 0; i <= window_size; ++i ) {
-		GLCD_DisplayString  (i, 0, 1, chache[(i + window_start) % CACHE_LINE_CAP ]);
+	for (i = 0; i < LCD_HEIGTH; ++i ) {
+		draw_line(i, i <= window_size ? chache[(i + window_start) % CACHE_LINE_CAP ] : (uint8_t *)"");
 	}
 }
 
@@ -79,6 +114,8 @@ void append_char( uint8_t _char ) {
 			cache_start = (cache_start + 1) % CACHE_LINE_CAP;
 			--cache_size;
 		}
+		//The new line may still hold a line that left the cache
+		chache[last_line()][0] = 0x0;
 			
 		if ( window_size >= LCD_HEIGTH - 1 ) {
 			window_start = ( window_start + 1 ) % CACHE_LINE_CAP;
@@ -95,6 +132,7 @@ void append_char( uint8_t _char ) {
 	}else{
 		last_line_to_append = window_size;
 		GLCD_DisplayChar ( last_line_to_append , last_col_cahche, FONT_SIZE, _char);
+		shown[last_line_to_append][last_col_cahche] = _char;
 
 		chache[last_line()][last_col_cahche] = _char;
 		++last_col_cahche;
@@ -183,41 +221,29 @@ void moveLast( void ) {
 
 
 void initJoyStick( void ) {
-	//P1.23 Up
-	LPC_PINCON->PINSEL3 &= ~(0x03<<14); 				// P1.23 is GPIO
-	LPC_GPIO1->FIODIR   &= ~(1<<23); 				// P1.23 is input 
-
-	//P1.25 Down
-	LPC_PINCON->PINSEL3 &= ~(0x03<<18); 				// P1.25 is GPIO
-	LPC_GPIO1->FIODIR   &= ~(1<<25); 				// P1.25 is input 
-
-	//P1.24 Last
-	LPC_PINCON->PINSEL3 &= ~(0x03<<16); 				// P1.24 is GPIO
-	LPC_GPIO1->FIODIR   &= ~(1<<24); 				// P1.24 is input 
-
-	//P1.26 First
-	LPC_PINCON->PINSEL3 &= ~(0x03<<20); 				// P1.26 is GPIO
-	LPC_GPIO1->FIODIR   &= ~(1<<26); 				// P1.26 is input 
+	//P1.23 Up, P1.25 Down, P1.24 Last, P1.26 First
+	HAL_JoystickInit();
 }
 
 
 void joyStickBusyWaitingMonitor( void ) {
-	uint32_t i;
+	uint32_t joy;
 	
 	while ( 1 ) {
+		//One move per debounced joystick change, sleep until the next one
+		if ( !HAL_JoystickEvent(&joy) ) {
+			HAL_Sleep();
+			continue;
+		}
 		
-		if (        ~(LPC_GPIO1->FIOPIN | ~UP   ) ) {
+		if (        joy & UP    ) {
 			moveUp();
-		} else if ( ~(LPC_GPIO1->FIOPIN | ~DOWN ) ) {
+		} else if ( joy & DOWN  ) {
 			moveDown();
-		} else if ( ~(LPC_GPIO1->FIOPIN | ~FIRST) ) {
+		} else if ( joy & FIRST ) {
 			moveFirst();
-		} else if ( ~(LPC_GPIO1->FIOPIN | ~LAST ) ) {
+		} else if ( joy & LAST  ) {
 			moveLast();
 		}
-
-		for ( i = 0; i < 100000; ++i ) {
-			// pause
-		}
 	}
 }
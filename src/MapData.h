@@ -0,0 +1,99 @@
+/******************************************************************************/
+/* MapData.h: Wall and mine set layout of the MineField map                   */
+/******************************************************************************/
+/* Every list holds the (x, y) map cells of one layer, 0 <= x < 20 and        */
+/* 0 <= y < 15, as an X-macro: LIST(M, a) expands to M(a, x, y) per cell.     */
+/* The MAP_LIST_xxx macros turn a list into compile-time constants, so the    */
+/* bit maps, lengths and pixel positions used by main.c all come from the     */
+/* same data and need no start-up code.                                       */
+/******************************************************************************/
+
+#ifndef _MAPDATA_H
+#define _MAPDATA_H
+
+#define MAP_COLS        20              /* Map width in cells                 */
+#define MAP_ROWS        15              /* Map height in cells                */
+#define MAP_SCALE       16              /* Cell size in pixels                */
+
+/* Per cell helpers for the list macros                                       */
+#define MAP_CELL_ONE(a, x, y)   + 1
+#define MAP_CELL_BIT(a, x, y)   | (((x) == (a)) ? (0x1 << (15 - (y))) : 0)
+#define MAP_CELL_PIXEL(a, x, y) { (x) * MAP_SCALE + (a), (y) * MAP_SCALE + (a) },
+
+/* Number of cells in a list                                                  */
+#define MAP_LIST_LEN(LIST)          (0 LIST(MAP_CELL_ONE, 0))
+
+/* Bit map column c of a list: row y is bit (15 - y)                          */
+#define MAP_LIST_COLUMN(LIST, c)    (0 LIST(MAP_CELL_BIT, c))
+
+/* All MAP_COLS bit map columns of a list, as an array initializer            */
+#define MAP_LIST_COLUMNS(LIST) \
+  MAP_LIST_COLUMN(LIST,  0), MAP_LIST_COLUMN(LIST,  1), MAP_LIST_COLUMN(LIST,  2), MAP_LIST_COLUMN(LIST,  3), \
+  MAP_LIST_COLUMN(LIST,  4), MAP_LIST_COLUMN(LIST,  5), MAP_LIST_COLUMN(LIST,  6), MAP_LIST_COLUMN(LIST,  7), \
+  MAP_LIST_COLUMN(LIST,  8), MAP_LIST_COLUMN(LIST,  9), MAP_LIST_COLUMN(LIST, 10), MAP_LIST_COLUMN(LIST, 11), \
+  MAP_LIST_COLUMN(LIST, 12), MAP_LIST_COLUMN(LIST, 13), MAP_LIST_COLUMN(LIST, 14), MAP_LIST_COLUMN(LIST, 15), \
+  MAP_LIST_COLUMN(LIST, 16), MAP_LIST_COLUMN(LIST, 17), MAP_LIST_COLUMN(LIST, 18), MAP_LIST_COLUMN(LIST, 19)
+
+/* 1 if cell (x, y) is in a list, a = x * 32 + y                             */
+#define MAP_CELL_HAS(a, x, y)   | ((a) == (x) * 32 + (y))
+#define MAP_LIST_HAS(LIST, x, y)    (0 LIST(MAP_CELL_HAS, (x) * 32 + (y)))
+
+/* Pixel position of every cell plus offset off, as an array initializer      */
+#define MAP_LIST_PIXELS(LIST, off)  LIST(MAP_CELL_PIXEL, off)
+
+/* Wall blocks (76 cells) */
+#define MAP_WALLS(M, a) \
+  M(a, 3, 3) M(a, 3, 4) M(a, 3, 7) M(a, 3, 8) M(a, 3, 9) M(a, 3,10) M(a, 3,11) M(a, 4, 3) \
+  M(a, 4, 4) M(a, 4, 7) M(a, 4, 8) M(a, 4, 9) M(a, 4,10) M(a, 4,11) M(a, 5, 0) M(a, 6, 0) \
+  M(a, 7, 3) M(a, 7, 4) M(a, 7, 5) M(a, 7, 6) M(a, 7, 7) M(a, 8, 3) M(a, 8, 4) M(a, 8, 5) \
+  M(a, 8, 6) M(a, 8, 7) M(a, 8,10) M(a, 8,13) M(a, 8,14) M(a, 9, 3) M(a, 9, 4) M(a, 9, 5) \
+  M(a, 9, 6) M(a, 9, 7) M(a, 9,10) M(a, 9,13) M(a, 9,14) M(a,10,13) M(a,10,14) M(a,11,13) \
+  M(a,11,14) M(a,12, 0) M(a,12, 1) M(a,12, 2) M(a,12, 3) M(a,12, 4) M(a,12, 7) M(a,12, 8) \
+  M(a,12,13) M(a,12,14) M(a,13, 0) M(a,13, 1) M(a,13, 2) M(a,13, 3) M(a,13, 4) M(a,13, 7) \
+  M(a,13, 8) M(a,13,13) M(a,13,14) M(a,14, 7) M(a,14, 8) M(a,14,13) M(a,14,14) M(a,15, 7) \
+  M(a,15, 8) M(a,16, 2) M(a,16, 3) M(a,16, 4) M(a,16, 7) M(a,16, 8) M(a,16,11) M(a,17, 2) \
+  M(a,17, 3) M(a,17, 4) M(a,17,11) M(a,17,12)
+
+/* Mine set 1 (51 cells) */
+#define MINE_SET1(M, a) \
+  M(a, 0, 0) M(a, 0, 4) M(a, 0, 7) M(a, 0, 9) M(a, 0,10) M(a, 1, 3) M(a, 1,11) M(a, 1,12) \
+  M(a, 1,13) M(a, 2, 1) M(a, 2, 5) M(a, 2, 6) M(a, 2, 8) M(a, 2, 9) M(a, 2,13) M(a, 2,14) \
+  M(a, 3, 2) M(a, 4,13) M(a, 5, 2) M(a, 5,11) M(a, 5,13) M(a, 6, 6) M(a, 6, 9) M(a, 7, 1) \
+  M(a, 7,13) M(a, 8, 9) M(a, 8,12) M(a, 9,11) M(a,10, 1) M(a,10, 4) M(a,10, 7) M(a,11, 4) \
+  M(a,11, 6) M(a,11, 8) M(a,11,10) M(a,12,10) M(a,12,11) M(a,14, 3) M(a,14, 4) M(a,15, 1) \
+  M(a,15, 5) M(a,15, 9) M(a,15,12) M(a,17, 6) M(a,17,14) M(a,18, 0) M(a,18, 8) M(a,18,11) \
+  M(a,19, 3) M(a,19,10) M(a,19,14)
+
+/* Mine set 2 (56 cells) */
+#define MINE_SET2(M, a) \
+  M(a, 0, 1) M(a, 0, 3) M(a, 0, 5) M(a, 0, 6) M(a, 0,12) M(a, 0,13) M(a, 1, 1) M(a, 1, 2) \
+  M(a, 1, 7) M(a, 1, 8) M(a, 1,10) M(a, 2, 4) M(a, 2,11) M(a, 3, 0) M(a, 3, 5) M(a, 3,12) \
+  M(a, 3,13) M(a, 3,14) M(a, 4, 1) M(a, 4, 6) M(a, 5, 3) M(a, 5, 7) M(a, 5,10) M(a, 6, 3) \
+  M(a, 6, 5) M(a, 6,11) M(a, 6,12) M(a, 7, 8) M(a, 8, 0) M(a, 8, 2) M(a,10, 6) M(a,10,10) \
+  M(a,10,12) M(a,11, 1) M(a,11, 3) M(a,11, 7) M(a,12, 9) M(a,12,12) M(a,13, 5) M(a,13, 9) \
+  M(a,13,10) M(a,14, 2) M(a,14,11) M(a,15, 3) M(a,15,14) M(a,16, 5) M(a,16,13) M(a,17, 0) \
+  M(a,18, 2) M(a,18, 6) M(a,18, 9) M(a,18,10) M(a,18,14) M(a,19, 6) M(a,19, 8) M(a,19,12)
+
+/* Mine set 3 (58 cells) */
+#define MINE_SET3(M, a) \
+  M(a, 0, 2) M(a, 0, 8) M(a, 0,11) M(a, 0,14) M(a, 1, 0) M(a, 1, 4) M(a, 1, 5) M(a, 1, 6) \
+  M(a, 1, 9) M(a, 1,14) M(a, 2, 0) M(a, 2, 2) M(a, 2, 3) M(a, 2, 7) M(a, 2,10) M(a, 2,12) \
+  M(a, 3, 1) M(a, 3, 6) M(a, 4, 2) M(a, 4, 5) M(a, 5, 1) M(a, 5, 4) M(a, 5, 5) M(a, 5, 8) \
+  M(a, 5,12) M(a, 6, 2) M(a, 6,13) M(a, 6,14) M(a, 7, 9) M(a, 8,11) M(a, 9, 0) M(a, 9, 9) \
+  M(a,10, 3) M(a,10, 5) M(a,10, 8) M(a,10,11) M(a,11, 2) M(a,11, 9) M(a,11,11) M(a,13,11) \
+  M(a,13,12) M(a,14, 0) M(a,14, 6) M(a,14,10) M(a,15, 2) M(a,15, 4) M(a,15,11) M(a,16,10) \
+  M(a,17, 1) M(a,17, 5) M(a,17, 8) M(a,18, 4) M(a,18, 7) M(a,18,12) M(a,18,13) M(a,19, 1) \
+  M(a,19, 5) M(a,19,13)
+
+/* Mine set 4 (59 cells) */
+#define MINE_SET4(M, a) \
+  M(a, 4, 0) M(a, 4,12) M(a, 4,14) M(a, 5, 6) M(a, 5, 9) M(a, 5,14) M(a, 6, 1) M(a, 6, 4) \
+  M(a, 6, 7) M(a, 6, 8) M(a, 6,10) M(a, 7, 0) M(a, 7, 2) M(a, 7,10) M(a, 7,11) M(a, 7,12) \
+  M(a, 7,14) M(a, 8, 1) M(a, 8, 8) M(a, 9, 1) M(a, 9, 2) M(a, 9, 8) M(a, 9,12) M(a,10, 0) \
+  M(a,10, 2) M(a,10, 9) M(a,11, 0) M(a,11, 5) M(a,11,12) M(a,12, 5) M(a,12, 6) M(a,13, 6) \
+  M(a,14, 1) M(a,14, 5) M(a,14, 9) M(a,14,12) M(a,15, 0) M(a,15, 6) M(a,15,10) M(a,15,13) \
+  M(a,16, 0) M(a,16, 1) M(a,16, 6) M(a,16, 9) M(a,16,12) M(a,16,14) M(a,17, 7) M(a,17, 9) \
+  M(a,17,10) M(a,17,13) M(a,18, 1) M(a,18, 3) M(a,18, 5) M(a,19, 0) M(a,19, 2) M(a,19, 4) \
+  M(a,19, 7) M(a,19, 9) M(a,19,11)
+
+#endif /* _MAPDATA_H */
@@ -10,6 +10,8 @@
  *---------------------------------------------------------------------------*/
 
 #include <RTL.h>
+#include <LPC17xx.h>
+#include "hal.h"
 
 /*----------------------------------------------------------------------------
  *      RTX User configuration part BEGIN
@@ -102,6 +104,21 @@
 
 // </e>
 
+// <q>Sleep in the idle task
+// =========================
+// <i> Enter sleep mode (WFI) when no task is ready to run.
+#ifndef OS_IDLESLEEP
+ #define OS_IDLESLEEP   1
+#endif
+
+// <q>Tickless idle
+// ================
+// <i> Keep the tick interrupt off while idle and wake up for the earliest
+// <i> timeout only. Needs the idle sleep and no user timers.
+#ifndef OS_TICKLESS
+ #define OS_TICKLESS    1
+#endif
+
 //   <o>Number of user timers <0-250>
 //   <i> Define max. number of user timers that will run at the same time.
 //   <i> Default: 0  (User timers disabled)
@@ -139,6 +156,51 @@
 
 #define OS_TRV          ((U32)(((double)OS_CLOCK*(double)OS_TICK)/1E6)-1)
 
+#if (OS_TICKLESS == 1) && ((OS_IDLESLEEP != 1) || (OS_TIMER != 0) || (OS_TIMERCNT != 0))
+ #error "Tickless idle needs OS_IDLESLEEP, the SysTick timer and no user timers"
+#endif
+
+#if (OS_TICKLESS == 1)
+/*----------------------------------------------------------------------------
+ *      Kernel state used by the tickless idle demon
+ *---------------------------------------------------------------------------*/
+
+/* The leading fields of the control blocks of the V4.60 library            */
+/* (rt_TypeDef.h). Tasks waiting with a timeout are linked by p_dlnk into   */
+/* the delay list os_dly, and delta_time of the first one is the number of  */
+/* ticks until the earliest os_dly_wait, os_itv_wait or timeout ends.       */
+struct OS_TCB {
+  U8     cb_type;
+  U8     state;
+  U8     prio;
+  U8     task_id;
+  struct OS_TCB *p_lnk;
+  struct OS_TCB *p_rlnk;
+  struct OS_TCB *p_dlnk;
+  struct OS_TCB *p_blnk;
+  U16    delta_time;
+};
+
+struct OS_XCB {
+  U8     cb_type;
+  struct OS_TCB *p_lnk;
+  struct OS_TCB *p_rlnk;
+  struct OS_TCB *p_dlnk;
+  struct OS_TCB *p_blnk;
+  U16    delta_time;
+};
+
+extern struct OS_XCB os_dly;            /* rt_List.c                          */
+extern U32 os_time;                     /* rt_Time.c                          */
+
+/* SysTick and PendSV run at the lowest priority, masking it holds off the  */
+/* kernel while the other interrupts keep running                           */
+#define OS_MASK_PRIO    (0x1F << (8 - __NVIC_PRIO_BITS))
+
+/* Microseconds since the last tick, from the SysTick counter               */
+#define OS_TICK_PHASE() ((SysTick->LOAD - SysTick->VAL) / (OS_CLOCK / 1000000))
+#endif
+
 /*----------------------------------------------------------------------------
  *      Global Functions
  *---------------------------------------------------------------------------*/
@@ -148,10 +210,53 @@
 __task void os_idle_demon (void) {
   /* The idle demon is a system task, running when no other task is ready */
   /* to run. The 'os_xxx' function calls are not allowed from this task.  */
-
+#if (OS_TICKLESS == 1)
+  U32 ticks, wake, t0, into, us;
+
+  /* The tick interrupt is off until the earliest timeout. The SysTick      */
+  /* counter keeps running and tells the ticks that passed. Interrupts that */
+  /* wake no task only end one HAL_Sleep. Once a task is woken or the       */
+  /* timeout is due, all but the last missed tick go into the kernel time   */
+  /* and the delay list here, and the last one through the tick handler,    */
+  /* which readies the tasks whose timeout ends.                            */
+  for (;;) {
+    __set_BASEPRI(OS_MASK_PRIO);
+    ticks = os_dly.p_dlnk ? os_dly.p_dlnk->delta_time : 0xFFFF;
+    if (ticks < 2 || (SCB->ICSR & (SCB_ICSR_PENDSVSET_Msk | SCB_ICSR_PENDSTSET_Msk))) {
+      __set_BASEPRI(0);
+      HAL_Sleep();                      /* Woken up by the next tick at most  */
+      continue;
+    }
+    SysTick->CTRL &= ~SysTick_CTRL_TICKINT_Msk;
+    t0   = HAL_TimerUs();
+    into = OS_TICK_PHASE();
+    wake = ticks * OS_TICK - into;
+    HAL_WakeupIn(wake);
+    do {
+      HAL_Sleep();
+    } while (!(SCB->ICSR & SCB_ICSR_PENDSVSET_Msk) && HAL_TimerUs() - t0 < wake);
+    HAL_WakeupIn(0);
+
+    /* A tick from now on is pending in SCB->ICSR, and counted below too    */
+    SysTick->CTRL |= SysTick_CTRL_TICKINT_Msk;
+    us    = HAL_TimerUs() - t0;
+    ticks = (into + us - OS_TICK_PHASE() + OS_TICK / 2) / OS_TICK;
+    if (ticks) {
+      os_time += ticks - 1;
+      if (os_dly.p_dlnk)
+        os_dly.p_dlnk->delta_time -= ticks - 1;
+      SCB->ICSR = SCB_ICSR_PENDSTSET_Msk;
+    }
+    __set_BASEPRI(0);
+  }
+#else
   for (;;) {
   /* HERE: include optional user code to be executed when no task runs.*/
+#if (OS_IDLESLEEP == 1)
+    HAL_Sleep();                        /* Woken up by the next tick at most  */
+#endif
   }
+#endif
 }
 
 /*--------------------------- os_tick_init ----------------------------------*/
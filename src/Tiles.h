@@ -0,0 +1,59 @@
+/******************************************************************************/
+/* Tiles.h: Pre-rendered 16x16 RGB565 map tiles for GLCD_BlitTile             */
+/******************************************************************************/
+/* The wall block and the four tank orientations are described once as       */
+/* rectangles below. TILE_PIXELS turns a description into the GLCD_TILE *     */
+/* GLCD_TILE pixel initializer of a tile at compile time, row by row, so a    */
+/* cell is redrawn with one window and 512 bytes of pixel data.               */
+/******************************************************************************/
+
+#ifndef _TILES_H
+#define _TILES_H
+
+#include "GLCD.h"
+
+/* Tile colors                                                                */
+#define TILE_BACK       Black           /* Map background                     */
+#define TILE_WALL       Magenta         /* Wall block                         */
+#define TILE_BODY       Olive           /* Tank body                          */
+#define TILE_NOSE       White           /* Tank nose                          */
+
+/* Tile numbers, the tank tiles are numbered like Directions (game.h)         */
+#define TILE_ID_WALL    0
+#define TILE_ID_TANK(dir) (dir)         /* UP 1, RIGHT 2, LEFT 3, DOWN 4      */
+#define TILE_COUNT      5
+
+/* Rectangles as x0, x1, y0, y1 within the tile (x1, y1 exclusive)            */
+#define TILE_RECT_WALL          0, 15,  0, 15   /* One pixel gap right/bottom */
+#define TILE_BODY_LEFT          0, 15,  4, 15
+#define TILE_NOSE_LEFT          4, 12,  0,  4
+#define TILE_BODY_RIGHT         0, 15,  0, 12
+#define TILE_NOSE_RIGHT         4, 12, 12, 16
+#define TILE_BODY_UP            0, 12,  0, 16
+#define TILE_NOSE_UP           12, 16,  4, 12
+#define TILE_BODY_DOWN          4, 16,  0, 16
+#define TILE_NOSE_DOWN          0,  4,  4, 12
+
+/* 1 if pixel (i, j) lies in rectangle R                                      */
+#define TILE_IN_XY(i, j, x0, x1, y0, y1) \
+  ((i) >= (x0) && (i) < (x1) && (j) >= (y0) && (j) < (y1))
+#define TILE_IN(i, j, R)        TILE_IN_XY(i, j, R)
+
+/* Pixel (i, j) of the wall tile (a unused) and of the tank facing D          */
+#define TILE_WALL_PX(a, i, j) \
+  (TILE_IN(i, j, TILE_RECT_WALL) ? TILE_WALL : TILE_BACK)
+#define TILE_TANK_PX(D, i, j) \
+  (TILE_IN(i, j, TILE_NOSE_##D) ? TILE_NOSE : TILE_IN(i, j, TILE_BODY_##D) ? TILE_BODY : TILE_BACK)
+
+/* Pixels of one tile row and of a whole tile, PX(a, i, j) gives a pixel      */
+#define TILE_ROW(PX, a, j) \
+  PX(a,  0, j), PX(a,  1, j), PX(a,  2, j), PX(a,  3, j), PX(a,  4, j), PX(a,  5, j), PX(a,  6, j), PX(a,  7, j), \
+  PX(a,  8, j), PX(a,  9, j), PX(a, 10, j), PX(a, 11, j), PX(a, 12, j), PX(a, 13, j), PX(a, 14, j), PX(a, 15, j)
+
+#define TILE_PIXELS(PX, a) \
+  TILE_ROW(PX, a,  0), TILE_ROW(PX, a,  1), TILE_ROW(PX, a,  2), TILE_ROW(PX, a,  3), \
+  TILE_ROW(PX, a,  4), TILE_ROW(PX, a,  5), TILE_ROW(PX, a,  6), TILE_ROW(PX, a,  7), \
+  TILE_ROW(PX, a,  8), TILE_ROW(PX, a,  9), TILE_ROW(PX, a, 10), TILE_ROW(PX, a, 11), \
+  TILE_ROW(PX, a, 12), TILE_ROW(PX, a, 13), TILE_ROW(PX, a, 14), TILE_ROW(PX, a, 15)
+
+#endif /* _TILES_H */
@@ -0,0 +1,269 @@
+// MineField game rules (see game.h)
+
+#include <stdint.h>
+#include "game.h"
+
+/*
+	Map defined as an array of bit maps (global constant)
+
+	Map consists of 20 numbers representing the vertical columns
+	of pixels on a 1:16 scale. Each bit reprents a pixel as occupied
+	or unoccupied. Generated from the MAP_WALLS list in MapData.h.
+*/
+const uint32_t mapBitField[MAP_COLS] = {
+	MAP_LIST_COLUMNS(MAP_WALLS)
+};
+
+/*
+	Mine sets generated from the MINE_SETx lists in MapData.h
+
+	The bit maps have the same layout as mapBitField so a cell can be
+	tested without scanning a list.
+*/
+const uint16_t mineSetBitField[MINE_SETS][MAP_COLS] = {
+	{MAP_LIST_COLUMNS(MINE_SET1)},
+	{MAP_LIST_COLUMNS(MINE_SET2)},
+	{MAP_LIST_COLUMNS(MINE_SET3)},
+	{MAP_LIST_COLUMNS(MINE_SET4)}
+};
+
+/*
+	Mine set mask of every cell, built at compile time from the same lists
+	so a cell needs no scan over the sets
+*/
+#define CELL_SETS(x, y) \
+	(MAP_LIST_HAS(MINE_SET1, x, y) << 0 | MAP_LIST_HAS(MINE_SET2, x, y) << 1 | \
+	 MAP_LIST_HAS(MINE_SET3, x, y) << 2 | MAP_LIST_HAS(MINE_SET4, x, y) << 3)
+
+#define ROW_SETS(y) { \
+	CELL_SETS( 0, y), CELL_SETS( 1, y), CELL_SETS( 2, y), CELL_SETS( 3, y), CELL_SETS( 4, y), \
+	CELL_SETS( 5, y), CELL_SETS( 6, y), CELL_SETS( 7, y), CELL_SETS( 8, y), CELL_SETS( 9, y), \
+	CELL_SETS(10, y), CELL_SETS(11, y), CELL_SETS(12, y), CELL_SETS(13, y), CELL_SETS(14, y), \
+	CELL_SETS(15, y), CELL_SETS(16, y), CELL_SETS(17, y), CELL_SETS(18, y), CELL_SETS(19, y) }
+
+const uint8_t mineCellSets[MAP_ROWS][MAP_COLS] = {
+	ROW_SETS( 0), ROW_SETS( 1), ROW_SETS( 2), ROW_SETS( 3), ROW_SETS( 4),
+	ROW_SETS( 5), ROW_SETS( 6), ROW_SETS( 7), ROW_SETS( 8), ROW_SETS( 9),
+	ROW_SETS(10), ROW_SETS(11), ROW_SETS(12), ROW_SETS(13), ROW_SETS(14)
+};
+
+//Rebuilds the per state set masks after mines changed
+static void mineMasks(GameState *g) {
+	int i = 0;
+
+	g->setsPrimed = 0;
+	g->setsExp = 0;
+	for(i=0; i<MINE_SETS; i++) {
+		if(g->mines[i] == PRIMED)
+			g->setsPrimed |= 0x1 << i;
+		else if(g->mines[i] == EXP)
+			g->setsExp |= 0x1 << i;
+	}
+}
+
+//Steps a mine phase of the given length in ticks lasts, at least one
+static uint16_t mineSteps(uint16_t cycle) {
+	uint16_t steps = (cycle + GAME_STEP_TICKS - 1)/GAME_STEP_TICKS;
+
+	return steps ? steps : 1;
+}
+
+//A set is primed for two phases (the second one while the previous set
+//is cleared), exploded for one and then hands over to the next set
+static void mineAdvance(GameState *g) {
+	uint8_t next = (g->mineSet + 1) % MINE_SETS;
+
+	switch(g->minePhase) {
+		case 0:
+			g->mines[g->mineSet] = EXP;
+			break;
+		case 1:
+			g->mines[g->mineSet] = INVIS;
+			g->mines[next] = PRIMED;
+			break;
+		case 2:
+			g->mineSet = next;
+			break;
+	}
+	g->minePhase = (g->minePhase + 1) % 3;
+	g->mineLeft = mineSteps(g->mineCycle);
+	mineMasks(g);
+}
+
+//Drives the tank one cell in its direction, or stops it at an edge or wall
+static void tankMove(GameState *g) {
+	int x = g->x;
+	int y = g->y;
+
+	switch(g->dir) {
+		case(LEFT):
+			y--;
+			break;
+		case(UP):
+			x++;
+			break;
+		case(RIGHT):
+			y++;
+			break;
+		case(DOWN):
+			x--;
+			break;
+		default:
+			break;
+	}
+
+	if(x < 0 || x >= MAP_COLS || y < 0 || y >= MAP_ROWS || (mapBitField[x] & (0x1 << (15-y)))) {
+		g->moving = 0;
+		return;
+	}
+	g->x = x;
+	g->y = y;
+}
+
+void Game_Init(GameState *g) {
+	int i = 0;
+
+	g->step = 0;
+	g->gameOver = 0;
+	g->score = 0;
+
+	g->dir = UP;
+	g->moving = 0;
+	g->x = 0;
+	g->y = 14;
+
+	for(i=0; i<MINE_SETS; i++)
+		g->mines[i] = INVIS;
+	g->mines[0] = PRIMED;
+	mineMasks(g);
+	g->mineSet = 0;
+	g->minePhase = 0;
+	g->mineCycle = GAME_MINE_CYCLE;
+	g->mineLeft = mineSteps(g->mineCycle);
+	//the first increment (and speed-up) comes with the first step, the
+	//next ones every GAME_SCORE_STEPS
+	g->scoreLeft = 1;
+}
+
+/*
+	Advances the game by one step of GAME_STEP_TICKS with the given input
+	and returns the GAME_CHG_xxx bits of what changed. Once the game is
+	over the state no longer changes.
+*/
+uint8_t Game_Step(GameState *g, uint8_t input) {
+	GameState prev = *g;
+	uint8_t changed = 0;
+	int i = 0;
+
+	if(g->gameOver)
+		return 0;
+	g->step++;
+
+	//tank: steer while stopped, drive while moving
+	if(input & GAME_IN_STOP)
+		g->moving = 0;
+
+	if(g->moving == 0) {
+		switch(input & GAME_IN_DIR) {
+			case GAME_IN_LEFT:
+				g->dir = LEFT;
+				break;
+			case GAME_IN_RIGHT:
+				g->dir = RIGHT;
+				break;
+			case GAME_IN_DOWN:
+				g->dir = DOWN;
+				break;
+			case GAME_IN_UP:
+				g->dir = UP;
+				break;
+		}
+		if(input & GAME_IN_PRESS)
+			g->moving = 1;
+	}
+	else {
+		tankMove(g);
+	}
+
+	//mine cycle
+	if(--g->mineLeft == 0)
+		mineAdvance(g);
+
+	//score, every increment speeds up the mines
+	if(--g->scoreLeft == 0) {
+		g->score += 10;
+		g->mineCycle = (uint32_t)g->mineCycle*GAME_SPEEDUP_NUM/GAME_SPEEDUP_DEN;
+		g->scoreLeft = GAME_SCORE_STEPS;
+	}
+
+	//game over if the tank is on a mine of an exploded set
+	if(Game_CellState(g, g->x, g->y) == EXP)
+		g->gameOver = 1;
+
+	if(g->dir != prev.dir || g->x != prev.x || g->y != prev.y)
+		changed |= GAME_CHG_TANK;
+	for(i=0; i<MINE_SETS; i++) {
+		if(g->mines[i] != prev.mines[i])
+			changed |= GAME_CHG_MINES;
+	}
+	if(g->score != prev.score)
+		changed |= GAME_CHG_SCORE;
+	if(g->gameOver)
+		changed |= GAME_CHG_OVER;
+
+	return changed;
+}
+
+//Mine state shown on cell (x, y): exploded if any of its sets is, then
+//primed, else invisible
+MineState Game_CellState(const GameState *g, int x, int y) {
+	uint8_t sets = mineCellSets[y][x];
+
+	if(sets & g->setsExp)
+		return EXP;
+	if(sets & g->setsPrimed)
+		return PRIMED;
+	return INVIS;
+}
+
+//Runs a new game on one input byte per step, until the inputs run out or
+//the game is over, and returns the number of steps run
+uint32_t Game_Replay(GameState *g, const uint8_t *inputs, uint32_t n) {
+	uint32_t i = 0;
+
+	Game_Init(g);
+	for(i=0; i<n && !g->gameOver; i++)
+		Game_Step(g, inputs[i]);
+
+	return i;
+}
+
+//Runs a new game on input change records as game_task sends them, sorted
+//by step, each input held until the next record (0 before the first one),
+//until the game is over or maxSteps steps have run, and returns the number
+//of steps run
+uint32_t Game_ReplayInputs(GameState *g, const GameInput *rec, uint32_t n, uint32_t maxSteps) {
+	uint32_t i = 0, r = 0;
+	uint8_t input = 0;
+
+	Game_Init(g);
+	for(i=0; i<maxSteps && !g->gameOver; i++) {
+		while(r < n && rec[r].step <= i)
+			input = rec[r++].input;
+		Game_Step(g, input);
+	}
+
+	return i;
+}
+
+//Runs a new game with the inputs chosen by agent, until the game is over
+//or maxSteps steps have run, and returns the number of steps run
+uint32_t Game_Run(GameState *g, GAME_AGENT agent, void *ctx, uint32_t maxSteps) {
+	uint32_t i = 0;
+
+	Game_Init(g);
+	for(i=0; i<maxSteps && !g->gameOver; i++)
+		Game_Step(g, agent(g, ctx));
+
+	return i;
+}
@@ -0,0 +1,115 @@
+// MineField game rules as a deterministic state machine
+//
+// The whole game is a GameState advanced by Game_Step once per fixed step
+// with that step's input byte. Nothing here touches the RTX kernel, the
+// LCD or the board, so a recorded input stream (TLM_INPUT records) replays
+// to exactly the same game on the board or in a host build of game.c.
+// All state is in the GameState passed in, so separate games can run on
+// separate threads.
+
+#ifndef _GAME_H
+#define _GAME_H
+
+#include <stdint.h>
+#include "MapData.h"
+
+// Timing in RTX ticks, the step is the fixed timestep of the game
+#define GAME_ONE_SECOND    (200)
+#define GAME_MINE_CYCLE    (GAME_ONE_SECOND*2)      // ticks per mine phase at the start
+#define GAME_SCORE_CYCLE   (GAME_ONE_SECOND*2*2)    // ticks between score increments
+#define GAME_STEP_TICKS    (GAME_MINE_CYCLE/20)     // ticks per Game_Step
+
+#define GAME_SCORE_STEPS   (GAME_SCORE_CYCLE/GAME_STEP_TICKS)
+
+// Mine phase length is scaled by NUM/DEN on every score increment
+#ifndef GAME_SPEEDUP_NUM
+#define GAME_SPEEDUP_NUM   (4)
+#endif
+#ifndef GAME_SPEEDUP_DEN
+#define GAME_SPEEDUP_DEN   (5)
+#endif
+
+#define MINE_SETS (4)
+
+// Input byte of one step
+#define GAME_IN_DIR        (0x07)  // direction code, see below
+#define GAME_IN_LEFT       (0x01)
+#define GAME_IN_RIGHT      (0x02)
+#define GAME_IN_DOWN       (0x03)
+#define GAME_IN_UP         (0x04)
+#define GAME_IN_PRESS      (0x01 << 4)  // joystick push, start moving
+#define GAME_IN_STOP       (0x01 << 5)  // push button, stop moving
+
+// Game_Step return bits, what has to be redrawn
+#define GAME_CHG_TANK      (0x01)
+#define GAME_CHG_MINES     (0x02)
+#define GAME_CHG_SCORE     (0x04)
+#define GAME_CHG_OVER      (0x08)
+
+// Unscoped enum type
+typedef enum Directions {
+	NO_DIR = 0,
+	UP = 1,
+	RIGHT = 2,
+	LEFT = 3,
+	DOWN = 4
+}Directions;
+
+typedef enum MineState {
+	INVIS = 0,
+	PRIMED = 1,
+	EXP = 2,
+
+	//Test states
+	T1 = 3,
+	T2 = 4,
+	T3 = 5,
+	T4 = 6
+} MineState;
+
+typedef struct GameState {
+	uint32_t step;        //steps run since Game_Init
+	uint8_t gameOver;
+	uint16_t score;
+
+	//tank
+	Directions dir;
+	uint8_t moving;
+	uint8_t x;
+	uint8_t y;
+
+	//mine sets
+	MineState mines[MINE_SETS];
+	uint8_t setsPrimed;   //bit s set while set s is PRIMED
+	uint8_t setsExp;      //bit s set while set s is EXP
+	uint8_t mineSet;      //set going through its cycle
+	uint8_t minePhase;    //0 primed, 1 exploded, 2 next set primed
+	uint16_t mineCycle;   //ticks per phase, shrinks as the score goes up
+	uint16_t mineLeft;    //steps left in the current phase
+	uint16_t scoreLeft;   //steps left to the next score increment
+} GameState;
+
+// Input from step on, until the next record (TLM_INPUT without the sequence)
+typedef struct GameInput {
+	uint32_t step;
+	uint8_t input;
+} GameInput;
+
+// Returns the input byte for the next step of the given game
+typedef uint8_t (*GAME_AGENT)(const GameState *g, void *ctx);
+
+// Map layout in cells, row y is bit (15 - y) of column x
+extern const uint32_t mapBitField[MAP_COLS];
+extern const uint16_t mineSetBitField[MINE_SETS][MAP_COLS];
+
+// Mine sets covering each cell, bit s for set s (sets can overlap)
+extern const uint8_t mineCellSets[MAP_ROWS][MAP_COLS];
+
+void     Game_Init(GameState *g);
+uint8_t  Game_Step(GameState *g, uint8_t input);
+MineState Game_CellState(const GameState *g, int x, int y);
+uint32_t Game_Replay(GameState *g, const uint8_t *inputs, uint32_t n);
+uint32_t Game_ReplayInputs(GameState *g, const GameInput *rec, uint32_t n, uint32_t maxSteps);
+uint32_t Game_Run(GameState *g, GAME_AGENT agent, void *ctx, uint32_t maxSteps);
+
+#endif /* _GAME_H */
@@ -0,0 +1,198 @@
+// Board hardware abstraction for the MCB1700 (LPC1768)
+
+#include <lpc17xx.h>
+#include "hal.h"
+
+#define LED_ALL_G1 ((0x1 << 28) | (0x1 << 29) | (0x1 << 31))
+#define LED_ALL_G2 ((0x1 << 2) | (0x1 << 3) | (0x1 << 4) | (0x1 << 5) | (0x1 << 6))
+
+#define PIN_BUTTON (0x1 << 10)  // INT0 push button is P2.10
+
+// Time spent in HAL_Sleep, in microseconds
+static volatile uint32_t sleepUs = 0;
+
+// Debounced joystick state and its change events, written by the TIMER1
+// interrupt and read by one consumer at a time
+static uint32_t joyRaw = 0;
+static uint8_t  joyStable = 0;
+static volatile uint32_t joyState = 0;
+static uint32_t joyQueue[HAL_JOY_QUEUE];
+static volatile uint32_t joyHead = 0, joyTail = 0;
+
+void HAL_Init(void) {
+	SystemInit();
+}
+
+void HAL_LedInit(void) {
+	//set LEDs to output
+	LPC_GPIO1->FIODIR |= 0xB0000000;
+	LPC_GPIO2->FIODIR |= 0x0000007C;
+	//clear all LEDs
+	LPC_GPIO1->FIOCLR |= LED_ALL_G1;
+	LPC_GPIO2->FIOCLR |= LED_ALL_G2;
+}
+
+// Shows num on the 8 LEDs, MSB on P1.28
+void HAL_LedWrite(uint8_t num) {
+	uint32_t buffer = 0;
+	
+	//Clear all LEDs
+	LPC_GPIO1->FIOCLR |= LED_ALL_G1;
+	LPC_GPIO2->FIOCLR |= LED_ALL_G2;
+	
+	//Build buffer for GPIO1
+	buffer |= ((num >> 7) & 0x1) << 28;
+	buffer |= ((num >> 6) & 0x1) << 29;
+	buffer |= ((num >> 5) & 0x1) << 31;
+	LPC_GPIO1->FIOSET |= buffer;
+	
+	//Build buffer for GPIO2
+	buffer  = ((num >> 4) & 0x1) << 2;
+	buffer |= num & (0x1 << 3);
+	buffer |= ((num >> 2) & 0x1) << 4;
+	buffer |= ((num >> 1) & 0x1) << 5;
+	buffer |= (num & 0x1) << 6;
+	LPC_GPIO2->FIOSET |= buffer;
+}
+
+// Port 1 has no GPIO interrupts, so the joystick is sampled from a TIMER1
+// match interrupt instead of being polled by the tasks
+void HAL_JoystickInit(void) {
+	//P1.20 and P1.23 to P1.26 are GPIO inputs
+	LPC_PINCON->PINSEL3 &= ~((0x03 << 8) | (0x03 << 14) | (0x03 << 16) | (0x03 << 18) | (0x03 << 20));
+	LPC_GPIO1->FIODIR   &= ~HAL_JOY_ALL;
+	
+	//periodic sample on match 1 of the free running TIMER1
+	HAL_TimerInit();
+	LPC_TIM1->MR1 = LPC_TIM1->TC + HAL_JOY_SAMPLE_US;
+	LPC_TIM1->IR = 0x2;
+	LPC_TIM1->MCR |= (0x1 << 3);
+	NVIC_EnableIRQ(TIMER1_IRQn);
+}
+
+// Joystick lines are active low, return them as 1 = pressed
+uint32_t HAL_JoystickRead(void) {
+	return (~LPC_GPIO1->FIOPIN) & HAL_JOY_ALL;
+}
+
+// Debounced joystick lines (1 = pressed)
+uint32_t HAL_JoystickState(void) {
+	return joyState;
+}
+
+// Takes the oldest debounced change from the queue, state is the joystick
+// lines after the change. Returns 0 if there was none.
+uint8_t HAL_JoystickEvent(uint32_t *state) {
+	uint32_t tail = joyTail;
+	
+	if(tail == joyHead)
+		return 0;
+	*state = joyQueue[tail & (HAL_JOY_QUEUE - 1)];
+	joyTail = tail + 1;
+	return 1;
+}
+
+// Called every HAL_JOY_SAMPLE_US from the TIMER1 interrupt
+static void joySample(void) {
+	uint32_t raw = HAL_JoystickRead();
+	
+	if(raw != joyRaw) {
+		joyRaw = raw;
+		joyStable = 0;
+		return;
+	}
+	if(joyStable >= HAL_JOY_STABLE)
+		return;
+	if(++joyStable == HAL_JOY_STABLE && raw != joyState) {
+		joyState = raw;
+		//drop the change if the consumer fell behind
+		if(joyHead - joyTail < HAL_JOY_QUEUE) {
+			joyQueue[joyHead & (HAL_JOY_QUEUE - 1)] = raw;
+			joyHead++;
+		}
+	}
+}
+
+void HAL_ButtonInit(void) {
+	//set push button connected to GPIO
+	LPC_PINCON->PINSEL4 &= ~(3 << 20);
+	//set as input
+	LPC_GPIO2->FIODIR &= ~PIN_BUTTON;
+	//setup read on falling edge interrupt
+	LPC_GPIOINT->IO2IntEnF |= PIN_BUTTON;
+	//enable IRQ
+	NVIC_EnableIRQ(EINT3_IRQn);
+}
+
+// Returns 1 while the push button is held down
+uint8_t HAL_ButtonRead(void) {
+	return (LPC_GPIO2->FIOPIN & PIN_BUTTON) == 0;
+}
+
+void HAL_ButtonIntClear(void) {
+	LPC_GPIOINT->IO2IntClr |= PIN_BUTTON;
+}
+
+// TIMER1 runs free at 1 MHz as the time base for measurements, calling
+// this again once it runs has no effect
+void HAL_TimerInit(void) {
+	if(LPC_TIM1->TCR & 0x1)
+		return;
+	
+	//power up TIMER1 and clock it with CCLK
+	LPC_SC->PCONP |= (0x1 << 2);
+	LPC_SC->PCLKSEL0 = (LPC_SC->PCLKSEL0 & ~(0x3 << 4)) | (0x1 << 4);
+	LPC_TIM1->TCR = 0x2;
+	LPC_TIM1->CTCR = 0;
+	LPC_TIM1->PR = SystemCoreClock / 1000000 - 1;
+	LPC_TIM1->MCR = 0;
+	LPC_TIM1->TCR = 0x1;
+}
+
+// Microseconds since HAL_TimerInit, wraps after about 71 minutes
+uint32_t HAL_TimerUs(void) {
+	return LPC_TIM1->TC;
+}
+
+// Sleeps until the next interrupt and adds the time to the sleep counter
+void HAL_Sleep(void) {
+	uint32_t t0 = LPC_TIM1->TC;
+	
+	__WFI();
+	sleepUs += LPC_TIM1->TC - t0;
+}
+
+// Raises a TIMER1 interrupt in us microseconds to end a HAL_Sleep, 0 cancels
+// the one armed
+void HAL_WakeupIn(uint32_t us) {
+	LPC_TIM1->MCR &= ~0x1;
+	LPC_TIM1->IR = 0x1;
+	if(!us)
+		return;
+	LPC_TIM1->MR0 = LPC_TIM1->TC + us;
+	LPC_TIM1->MCR |= 0x1;
+	NVIC_EnableIRQ(TIMER1_IRQn);
+}
+
+// Microseconds spent in HAL_Sleep since the last reset
+uint32_t HAL_SleepUs(uint8_t reset) {
+	uint32_t us = sleepUs;
+	
+	if(reset)
+		sleepUs = 0;
+	return us;
+}
+
+void TIMER1_IRQHandler(void) {
+	//match 0: one-shot wake-up, the counter keeps running
+	if(LPC_TIM1->IR & 0x1) {
+		LPC_TIM1->MCR &= ~0x1;
+		LPC_TIM1->IR = 0x1;
+	}
+	//match 1: joystick sample
+	if(LPC_TIM1->IR & 0x2) {
+		LPC_TIM1->IR = 0x2;
+		LPC_TIM1->MR1 += HAL_JOY_SAMPLE_US;
+		joySample();
+	}
+}
@@ -0,0 +1,50 @@
+// Board hardware abstraction for the MCB1700 (LPC1768)
+//
+// Game code goes through these calls instead of touching LPC_GPIOx,
+// LPC_GPIOINT or NVIC registers directly. The LCD (SSP1) and the UARTs are
+// reached through GLCD.h and uart.h, and the RTX kernel through RTL.h.
+//
+// The host build (HAL_HOST) swaps all three layers: host/hal_host.c for
+// this file, peripheral models behind the IO_RD/IO_WR register accesses of
+// the drivers (hal_io.h), and host/rtx_host.c for the RTX library.
+
+#ifndef _HAL_H
+#define _HAL_H
+
+#include <stdint.h>
+
+// Joystick bits returned by HAL_JoystickRead (P1 pin positions, 1 = pressed)
+#define HAL_JOY_PRESS  (0x1 << 20)
+#define HAL_JOY_P23    (0x1 << 23)
+#define HAL_JOY_P24    (0x1 << 24)
+#define HAL_JOY_P25    (0x1 << 25)
+#define HAL_JOY_P26    (0x1 << 26)
+#define HAL_JOY_ALL    (HAL_JOY_PRESS | HAL_JOY_P23 | HAL_JOY_P24 | HAL_JOY_P25 | HAL_JOY_P26)
+
+void     HAL_Init(void);
+
+void     HAL_LedInit(void);
+void     HAL_LedWrite(uint8_t num);
+
+// Joystick sampling period and samples a change has to be stable for
+#define HAL_JOY_SAMPLE_US  (5000)
+#define HAL_JOY_STABLE     (3)
+#define HAL_JOY_QUEUE      (16)     // event queue length, power of 2
+
+void     HAL_JoystickInit(void);
+uint32_t HAL_JoystickRead(void);
+uint32_t HAL_JoystickState(void);
+uint8_t  HAL_JoystickEvent(uint32_t *state);
+
+void     HAL_ButtonInit(void);
+uint8_t  HAL_ButtonRead(void);
+void     HAL_ButtonIntClear(void);
+
+void     HAL_TimerInit(void);
+uint32_t HAL_TimerUs(void);
+
+void     HAL_Sleep(void);
+void     HAL_WakeupIn(uint32_t us);
+uint32_t HAL_SleepUs(uint8_t reset);
+
+#endif /* _HAL_H */
@@ -0,0 +1,36 @@
+// Peripheral register access with side effects
+//
+// The drivers touch data, status and interrupt registers (SSP1 DR/SR/ICR,
+// UART THR/RBR/LSR/IIR/IER, GPDMA channel enable and interrupt clear,
+// GPIO set/clear) through IO_RD and IO_WR. On the board these are plain
+// register accesses. The host build (HAL_HOST, see host/) routes them to
+// the peripheral models instead, which act on the access the way the
+// hardware does. Configuration registers are accessed directly.
+//
+// IO_ADDR gives the 32-bit bus address of a buffer or register for the
+// GPDMA address registers.
+
+#ifndef _HAL_IO_H
+#define _HAL_IO_H
+
+#include <stdint.h>
+
+#ifdef HAL_HOST
+
+uint32_t SIM_IoRead(const volatile void *reg, unsigned int size);
+void     SIM_IoWrite(volatile void *reg, unsigned int size, uint32_t val);
+uint32_t SIM_Addr(const volatile void *p);
+
+#define IO_RD(reg)        SIM_IoRead(&(reg), sizeof(reg))
+#define IO_WR(reg, val)   SIM_IoWrite(&(reg), sizeof(reg), (val))
+#define IO_ADDR(p)        SIM_Addr(p)
+
+#else
+
+#define IO_RD(reg)        (reg)
+#define IO_WR(reg, val)   ((reg) = (val))
+#define IO_ADDR(p)        ((uint32_t)(p))
+
+#endif
+
+#endif /* _HAL_IO_H */
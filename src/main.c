@@ -1,9 +1,13 @@
-#include <lpc17xx.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
 #include <rtl.h>
 #include "GLCD.h"
+#include "hal.h"
+#include "MapData.h"
+#include "Tiles.h"
+#include "game.h"
+#include "telemetry.h"
 
 // Bit Masks
 #define BIT0 (0x1)
@@ -27,45 +31,51 @@
 #define BIT29 (0x1 << 29)
 #define BIT30 (0x1 << 30)
 #define BIT31 (0x1 << 31)
-#define LED_ALL_G1 (BIT28 | BIT29 | BIT31)
-#define LED_ALL_G2 (BIT2 | BIT3 | BIT4 | BIT5 | BIT6)
 
 // Improves readability
 #define TIMEOUT_INDEFINITE (0xffff)
-#define ONE_SECOND (200)
+
+// Sends the SSP1 cost of each frame per caller as TLM_BUS records (build
+// with SPI_STATS=1)
+#ifndef PROFILE_BUS
+#define PROFILE_BUS (0)
+#endif
+
+// SSP1 statistics tags (see GLCD_StatsTag)
+typedef enum BusTag {
+	BUS_OTHER = 0,
+	BUS_MAP = 1,
+	BUS_TANK = 2,
+	BUS_MINES = 3,
+	BUS_FLUSH = 4,
+	BUS_TAGS = 5
+} BusTag;
 
 // SYNCHRONIZATION VARIABLES //
-OS_MUT tankTaskMtx; //Ensures that either tank_task or joy_task runs
 
-//Condition variables
-OS_SEM minesSem;
-OS_SEM tankSem;
-OS_SEM collSem;
-OS_SEM dispSem;
-OS_SEM scoreSem;
+//game_task -> display_task
+#define EVT_RENDER (0x0004) //display_task: something to draw
+
+//Set by the push button ISR, handed to the next game step as GAME_IN_STOP
+static volatile uint8_t stopPending = 0;
 
-OS_MUT dataMTX;
+OS_MUT dataMTX; //guards gameState
 
-OS_TID tskMine;
-OS_TID tskTank;
-OS_TID tskColl;
+OS_TID tskGame;
 OS_TID tskDisp;
-OS_TID tskScore;
 
 // FUNCTION PROTOTYPES //
-__task void mines_task(void);
-__task void tank_task(void);
-__task void coll_task(void);
+__task void game_task(void);
 __task void display_task(void);
-__task void score_task(void);
 
 //////////////////////////////////////////////////////////////////////////
 //												GAME CHARACTERISTICS													//
 //////////////////////////////////////////////////////////////////////////
 
+//Game rules and state, advanced only by game_task
+GameState gameState;
+
 struct gameCharacs {
-	uint8_t gameOver;
-	uint8_t score;
 	char* startMessage;
 	char* endMessage;
 	char endScore[20];
@@ -75,14 +85,6 @@ struct gameCharacs game;
 struct mapCharacs {
 	uint8_t scaleFactor;
 	uint16_t mapBackColor;
-	uint16_t mapBlockColor;
-	
-	//tank color characteristics
-	uint16_t tankBodyColor;
-	uint16_t tankNoseColor;
-	
-	//mine characteristics
-	uint16_t minesCycleSpeed;
 	
 	//mine color characteristics
 	uint16_t minesInvis;
@@ -94,104 +96,52 @@ struct mapCharacs {
 	uint16_t minesBlue;
 	uint16_t minesYellow;
 	uint16_t minesRed;
-	
-	//score characteristics
-	uint16_t scoreCycleSpeed;
-	
-	//tank characteristics
-	uint16_t tankRefreshRate;
 };
 struct mapCharacs map;
 
-// Unscoped enum type
-typedef enum Directions { 
-	NO_DIR = 0,
-	UP = 1,
-	RIGHT = 2,
-	LEFT = 3,
-	DOWN = 4
-}Directions;
+// Pixel position (top left) of every wall block
+typedef struct PixelPos {
+	uint16_t x;
+	uint16_t y;
+} PixelPos;
 
-struct tankCharacs {
-	Directions dirCur;
-	Directions dirNext;
-	uint8_t isMoving;
-	uint8_t xCur;
-	uint8_t yCur;
-	uint8_t xNext;
-	uint8_t yNext;
+static const PixelPos mapWallPos[MAP_LIST_LEN(MAP_WALLS)] = {
+	MAP_LIST_PIXELS(MAP_WALLS, 0)
 };
-struct tankCharacs tank;
-
-/*
-	Map defined as an array of bit maps (global constant)
-	
-	Map consists of 10, 32-bit numbers representing the vertical
-	columns of pixels on a 1:16 scale. Each bit reprents a pixel
-	as occupied or unoccupied.
-*/
-static const uint32_t mapBitField[20] = {
-	0,0,0,0x19F0,0x19F0,0x8000,0x8000,0x1F00,0x1F26,0x1F26,0x0006,0x0006,
-	0xF986,0xF986,0x0186,0x0180,0x3990,0x3818,0,0
-};
-
-typedef enum MineState {
-	INVIS = 0,
-	PRIMED = 1,
-	EXP = 2,
-	
-	//Test states
-	T1 = 3,
-	T2 = 4,
-	T3 = 5,
-	T4 = 6
-} MineState;
 
-// Array of four mine sets (0 to 3)
-static MineState minesCur[4];
-static MineState minesNext[4];
-
-struct mineCharacs {
-	uint8_t setCur;
+// Wall and tank tiles, indexed by TILE_ID_xxx (see Tiles.h)
+static const uint16_t tileAtlas[TILE_COUNT][GLCD_TILE*GLCD_TILE] = {
+	{TILE_PIXELS(TILE_WALL_PX, 0)},
+	{TILE_PIXELS(TILE_TANK_PX, UP)},
+	{TILE_PIXELS(TILE_TANK_PX, RIGHT)},
+	{TILE_PIXELS(TILE_TANK_PX, LEFT)},
+	{TILE_PIXELS(TILE_TANK_PX, DOWN)}
 };
-struct mineCharacs mines;
 
-static const uint8_t mineSet1X[51] = {
-	0,0,0,0,0,1,1,1,1,2,2,2,2,2,2,2,3,4,5,5,5,6,6,7,7,8,8,9,10,10,10,11,11,
-	11,11,12,12,14,14,15,15,15,15,17,17,18,18,18,19,19,19
-};
-static const uint8_t mineSet1Y[51] = {
-	0,4,7,9,10,3,11,12,13,1,5,6,8,9,13,14,2,13,2,11,13,6,9,1,13,9,12,11,1,
-	4,7,4,6,8,10,10,11,3,4,1,5,9,12,6,14,0,8,11,3,10,14
-};
+// 1-bpp mine sprite for one cell, row y bit x (built by mineSpriteInit)
+static uint16_t mineSprite[MAP_SCALE];
 
-static const uint8_t mineSet2X[56] = {
-	0,0,0,0,0,0,1,1,1,1,1,2,2,3,3,3,3,3,4,4,5,5,5,6,6,6,6,7,8,8,10,10,10,11,
-	11,11,12,12,13,13,13,14,14,15,15,16,16,17,18,18,18,18,18,19,19,19
-};
-static const uint8_t mineSet2Y[56] = {
-	1,3,5,6,12,13,1,2,7,8,10,4,11,0,5,12,13,14,1,6,3,7,10,3,5,11,12,8,0,2,6,
-	10,12,1,3,7,9,12,5,9,10,2,11,3,14,5,13,0,2,6,9,10,14,6,8,12
-};
+/*
+	Scene model: what each map cell shows, one byte per cell. The low
+	nibble is the cell itself, the high nibble the direction of the tank
+	standing on it (0 for none).
+	
+	display_task builds scene from the game state every frame and draws
+	only the cells that differ from sceneDrawn, the copy of what the LCD
+	shows.
+*/
+#define CELL_EMPTY (0)
+#define CELL_WALL (1)
+#define CELL_PRIMED (2)
+#define CELL_EXP (3)
+#define CELL_BASE (0x0F)
+#define CELL_TANK(dir) ((dir) << 4)
 
-static const uint8_t mineSet3X[58] = {
-	0,0,0,0,1,1,1,1,1,1,2,2,2,2,2,2,3,3,4,4,5,5,5,5,5,6,6,6,7,8,9,9,10,10,10,
-	10,11,11,11,13,13,14,14,14,15,15,15,16,17,17,17,18,18,18,18,19,19,19
-};
-static const uint8_t mineSet3Y[58] = {
-	2,8,11,14,0,4,5,6,9,14,0,2,3,7,10,12,1,6,2,5,1,4,5,8,12,2,13,14,9,11,0,9,
-	3,5,8,11,2,9,11,11,12,0,6,10,2,4,11,10,1,5,8,4,7,12,13,1,5,13
-};
+static uint8_t scene[MAP_ROWS][MAP_COLS];
+static uint8_t sceneDrawn[MAP_ROWS][MAP_COLS];
 
-static const uint8_t mineSet4X[59] = {
-	4,4,4,5,5,5,6,6,6,6,6,7,7,7,7,7,7,8,8,9,9,9,9,10,10,10,11,11,11,12,12,13,
-	14,14,14,14,15,15,15,15,16,16,16,16,16,16,17,17,17,17,18,18,18,19,19,19,
-	19,19,19
-};
-static const uint8_t mineSet4Y[59] = {
-	0,12,14,6,9,14,1,4,7,8,10,0,2,10,11,12,14,1,8,1,2,8,12,0,2,9,0,5,12,5,6,6,
-	1,5,9,12,0,6,10,13,0,1,6,9,12,14,7,9,10,13,1,3,5,0,2,4,7,9,11
-};
+//Cells drawn by the last sceneDraw
+static uint16_t cellsDrawn;
 
 
 
@@ -200,12 +150,7 @@ static const uint8_t mineSet4Y[59] = {
 //////////////////////////////////////////////////////////////////////////
 
 void ledInit(void) {
-	//set LEDs to output
-	LPC_GPIO1->FIODIR |= 0xB0000000;
-	LPC_GPIO2->FIODIR |= 0x0000007C;
-	//clear all LEDs
-	LPC_GPIO1->FIOCLR |= LED_ALL_G1;
-	LPC_GPIO2->FIOCLR |= LED_ALL_G2;
+	HAL_LedInit();
 }
 
 void lcdInit(void) {
@@ -216,16 +161,8 @@ void lcdInit(void) {
 
 void mapCharacsInit(void) {
 	//map characteristics
-	map.scaleFactor = 16;
-	map.mapBackColor = Black;
-	map.mapBlockColor = Magenta;
-	
-	//tank color characteristics
-	map.tankBodyColor = Olive;
-	map.tankNoseColor = White;
-	
-	//mine characteristics
-	map.minesCycleSpeed = ONE_SECOND*2;
+	map.scaleFactor = MAP_SCALE;
+	map.mapBackColor = TILE_BACK; //walls and tank come from tileAtlas
 	
 	//mine color characteristics
 	map.minesInvis = Black;
@@ -237,76 +174,73 @@ void mapCharacsInit(void) {
 	map.minesBlue = Blue;
 	map.minesYellow = Yellow;
 	map.minesRed = Red;
-	
-	//score characteristics
-	map.scoreCycleSpeed = ONE_SECOND*2*2;
-	
-	//tank characteristics
-	map.tankRefreshRate = map.minesCycleSpeed/20;
 }
 
 void gameCharacsInit(void) {
-	game.gameOver = 0;
-	game.score = 0;
+	Game_Init(&gameState);
 	game.endMessage = "GAME OVER";
 	game.startMessage = "MINEFIELD";
 }
 
-void mineCharacsInit(void) {
-	mines.setCur = 0;
-}
-
-void tankCharacsInit(void) {
-	tank.dirCur = UP;
-	tank.dirNext = UP;
-	tank.isMoving = 0;
-	tank.xCur = 0;
-	tank.yCur = 14;
-	tank.xNext = 0;
-	tank.yNext = 14;
+//The LCD starts with the map only (see mapPrint)
+void sceneInit(void) {
+	int x = 0;
+	int y = 0;
+	
+	for(y=0; y<MAP_ROWS; y++) {
+		for(x=0; x<MAP_COLS; x++)
+			sceneDrawn[y][x] = (mapBitField[x] & (0x1 << (15-y))) ? CELL_WALL : CELL_EMPTY;
+	}
 }
 
-void mineStatesInit(void) {
-	//counter variable
-	int i=0;
+//Renders the mine shape once into mineSprite
+void mineSpriteInit(void) {
+	int i = 0;
+	int j = 0;
+	int c = MAP_SCALE/2;
 	
-	//initalize all mine sets to invisible state
-	for(i=0; i<4; i++) {
-		minesCur[i] = INVIS;
-		minesNext[i] = INVIS;
+	for(i=0; i<MAP_SCALE; i++)
+		mineSprite[i] = 0;
+	
+	//four plus signs on a radius 4 circle around the cell centre
+	for (i=8;i >= -8;i-=2)  {	
+		for (j=-8;j <= 8;j++)  {
+			if(i*i+j*j == 16)
+			{
+				mineSprite[c+j]   |= (0x1 << (c+i)) | (0x1 << (c+i+1)) | (0x1 << (c+i-1));
+				mineSprite[c+j+1] |= (0x1 << (c+i));
+				mineSprite[c+j-1] |= (0x1 << (c+i));
+			}
+		}
 	}
 }
 
 void pushButtonInit(void) {
-	
-	//set push button connected to GPIO
-	LPC_PINCON->PINSEL4 &= ~(3<<20);
-	//set as input
-	LPC_GPIO2->FIODIR &= ~(1<<10);
-	//setup read on falling edge interrupt
-	LPC_GPIOINT->IO2IntEnF |= (1<<10);
-	//enable IRQ
-	NVIC_EnableIRQ(EINT3_IRQn);
+	//falling edge interrupt on the push button
+	HAL_ButtonInit();
 }
 
 //ISR for push button
 void EINT3_IRQHandler(void) {
 	//set push button 'state' to 'pushed'
-	tank.isMoving = 0;
+	stopPending = 1;
 	
 	//clear interrupt
-	LPC_GPIOINT->IO2IntClr |= (1<<10);
+	HAL_ButtonIntClear();
 }
 
 void initialization(void) {
-	SystemInit();
+	HAL_Init();
 	ledInit();
 	lcdInit();
 	mapCharacsInit();
 	gameCharacsInit();
-	mineCharacsInit();
-	tankCharacsInit();
+	mineSpriteInit();
+	sceneInit();
+	HAL_TimerInit();
+	HAL_JoystickInit();
 	pushButtonInit();
+	TLM_Init();
 }
 
 ////////////////////////////////////////////////////////////////////////////
@@ -316,233 +250,161 @@ void initialization(void) {
 /*Prints a 16 pixel square block with parameters 
   as X and Y which represent scaled co-ordinates */
 void blockPrint(int x, int y){
-	int i = 0;
-	int j = 0;
-	
-	//set block color
-	GLCD_SetTextColor(map.mapBlockColor);
-	
-	//scale the coordinates
-	x = x*(map.scaleFactor);
-	y = y*(map.scaleFactor);
-	
-	//print the block
-	for(i=x;i<(x+(map.scaleFactor)-1);i++) {
-		for(j=y;j<(y+(map.scaleFactor)-1);j++) {
-			GLCD_PutPixel(i, j);
-		}
-	}
+	//print the block and its gap in a single burst
+	GLCD_BlitTile(x*MAP_SCALE, y*MAP_SCALE, tileAtlas[TILE_ID_WALL]);
 }
 
 /*Prints a 16 pixel mine with parameters 
-  as X and Y which represent scaled co-ordinates */
-void minePrint(int x, int y){
-	int i = 0;
-	int j = 0;
-	
-	//scale the coordinates
-	x = x*(map.scaleFactor) + (map.scaleFactor/2);
-	y = y*(map.scaleFactor) + (map.scaleFactor/2);
-	
-	//print the mine
-	for (i=8;i >= -8;i-=2)  {	
-			for (j=-8;j <= 8;j++)  {
-				
-				if(i*i+j*j == 16)
-				{
-					GLCD_PutPixel(i+x, j+y);
-					GLCD_PutPixel(i+x+1, j+y);
-					GLCD_PutPixel(i+x, j+y+1);
-					GLCD_PutPixel(i+x-1, j+y);
-					GLCD_PutPixel(i+x, j+y-1);
-				}
-					
-			 }
-  }
+  as X and Y which represent the pixel centre of the cell.
+  Opaque mines redraw the whole cell in one burst, transparent
+  ones leave the rest of the cell (e.g. the tank) untouched */
+void minePrint(int x, int y, uint8_t opaque){
+	GLCD_DrawSprite(x - MAP_SCALE/2, y - MAP_SCALE/2, MAP_SCALE, MAP_SCALE, mineSprite, opaque);
 }
 
 
-//Prints a mine set in a given state
-void mineSetPrint(uint8_t setNum, MineState mState) {
-	//variables
-	int i = 0;
-	int j = 0;
-	
-	//store mine state in global array
-	minesCur[setNum] = mState;
-	
-	switch(mState) {
-		case INVIS:
-			GLCD_SetTextColor(map.minesInvis);
-			break;
-		case PRIMED:
-			GLCD_SetTextColor(map.minesPrimed);
-			break;
-		case EXP:
-			GLCD_SetTextColor(map.minesExp);
-			break;
-		case T1:
-			GLCD_SetTextColor(map.minesGreen);
-			break;
-		case T2:
-			GLCD_SetTextColor(map.minesBlue);
-			break;
-		case T3:
-			GLCD_SetTextColor(map.minesYellow);
-			break;
-		case T4:
-			GLCD_SetTextColor(map.minesRed);
-	}
-	
+/*Prints the tank facing dir on cell X, Y (scaled co-ordinates),
+  including the cell background, in a single burst */
+void tankPrint(int x, int y, Directions dir) {
+	GLCD_BlitTile(x*MAP_SCALE, y*MAP_SCALE, tileAtlas[TILE_ID_TANK(dir)]);
+}
+
+
+
+//Fills scene with the cells of the given game state
+void sceneBuild(const GameState* g) {
+	int x = 0;
+	int y = 0;
 	
-	if(setNum == 0) {
-		for(i=0; i<51; i++) {
-			minePrint(mineSet1X[i],mineSet1Y[i]);
-		}
-	}
-	else if(setNum == 1) {
-		for(i=0; i<56; i++) {
-			minePrint(mineSet2X[i],mineSet2Y[i]);
-		}
-	}
-	else if(setNum == 2) {
-		for(i=0; i<58; i++) {
-			minePrint(mineSet3X[i],mineSet3Y[i]);
-		}
-	}
-	else if(setNum == 3) {
-		for(i=0; i<59; i++) {
-			minePrint(mineSet4X[i],mineSet4Y[i]);
+	for(y=0; y<MAP_ROWS; y++) {
+		for(x=0; x<MAP_COLS; x++) {
+			if(mapBitField[x] & (0x1 << (15-y))) {
+				scene[y][x] = CELL_WALL;
+				continue;
+			}
+			
+			switch(Game_CellState(g, x, y)) {
+				case EXP:
+					scene[y][x] = CELL_EXP;
+					break;
+				case PRIMED:
+					scene[y][x] = CELL_PRIMED;
+					break;
+				default:
+					scene[y][x] = CELL_EMPTY;
+			}
 		}
 	}
+	
+	scene[g->y][g->x] |= CELL_TANK(g->dir);
 }
 
-
-/*Clears a 16 pixel square block with parameters 
-  as X and Y which represent scaled co-ordinates */
-void blockClear(int x, int y){
+//Draws len cells of the same kind starting at cell (x, y), without a tank
+void cellRunPrint(int x, int y, int len, uint8_t cell) {
 	int i = 0;
-	int j = 0;
 	
-	//scaling the co-ordinates
-	x = x*(map.scaleFactor);
-	y = y*(map.scaleFactor);
-	
-	//clearing the block
-	for(i=x;i<(x+(map.scaleFactor));i++) {
-		for(j=y;j<(y+(map.scaleFactor));j++) {
-			GLCD_RemovePixel(i, j);
-		}
+	switch(cell) {
+		case CELL_EMPTY:
+			GLCD_FillRect(x*MAP_SCALE, y*MAP_SCALE, len*MAP_SCALE, MAP_SCALE, map.mapBackColor);
+			break;
+		case CELL_WALL:
+			for(i=0; i<len; i++)
+				blockPrint(x+i, y);
+			break;
+		case CELL_PRIMED:
+		case CELL_EXP:
+			//mine cells only hold the mine, so the run is drawn opaque in one burst
+			GLCD_SetTextColor(cell == CELL_EXP ? map.minesExp : map.minesPrimed);
+			GLCD_DrawSpriteRun(x*MAP_SCALE, y*MAP_SCALE, MAP_SCALE, MAP_SCALE, mineSprite, len);
+			break;
 	}
 }
 
-
-void tankPrint(int x, int y, Directions dir) {
-	int i=0;
-	int j=0;
-	
-	//scale coordinates
-	x = x*(map.scaleFactor);
-	y = y*(map.scaleFactor);
+//Draws the tank cell (x, y), with its mine drawn transparent on top
+void cellTankPrint(int x, int y, uint8_t cell) {
+	tankPrint(x, y, (Directions)(cell >> 4));
 	
-	//print tank body
-	GLCD_SetTextColor(map.tankBodyColor);
-	if(dir == LEFT) {
-		for(i=x;i<(x+(map.scaleFactor)-1);i++) {
-			for(j=(y+((map.scaleFactor)/4)); j<(y+(map.scaleFactor)-1); j++) {
-				GLCD_PutPixel(i,j);
-			}
-		}
-	}
-	else if(dir == RIGHT) {
-		for(i=x; i<x+((map.scaleFactor)-1); i++) {
-			for(j=y; j<y+(((map.scaleFactor)/4)*3); j++) {
-				GLCD_PutPixel(i,j);
-			}
-		}
-	}
-	else if(dir == UP) {
-		for(i=x; i<x+(((map.scaleFactor)/4)*3); i++) {
-			for(j=y; j<y+(map.scaleFactor); j++) {
-				GLCD_PutPixel(i,j);
-			}
-		}
+	if((cell & CELL_BASE) == CELL_PRIMED || (cell & CELL_BASE) == CELL_EXP) {
+		GLCD_SetTextColor((cell & CELL_BASE) == CELL_EXP ? map.minesExp : map.minesPrimed);
+		minePrint(x*MAP_SCALE + MAP_SCALE/2, y*MAP_SCALE + MAP_SCALE/2, 0);
 	}
-	else if(dir == DOWN) {
-		for(i=x+((map.scaleFactor)/4); i<x+(map.scaleFactor); i++) {
-			for(j=y; j<y+(map.scaleFactor); j++) {
-				GLCD_PutPixel(i,j);
-			}
-		}
-	}
-	
-	//print tank nose
-	GLCD_SetTextColor(map.tankNoseColor);
+}
 
-	if(dir == LEFT) {
-		for(i=(x+((map.scaleFactor)/4)); i<(x+(((map.scaleFactor)/4)*3)); i++) {
-			for(j=y; j<(y+4);j++) {
-				GLCD_PutPixel(i,j);
-			}
-		}
-	}
-	else if(dir == RIGHT) {
-		for(i=(x+((map.scaleFactor)/4)); i<(x+(((map.scaleFactor)/4)*3)); i++) {
-			for(j=y+(((map.scaleFactor)/4)*3); j<y+(map.scaleFactor); j++) {
-				GLCD_PutPixel(i,j);
+/*
+	Draws the cells of scene that differ from sceneDrawn. Changed cells
+	of the same kind next to each other in a row are drawn as one run.
+*/
+void sceneDraw(void) {
+	int x = 0;
+	int y = 0;
+	int len = 0;
+	uint8_t cell;
+	
+	cellsDrawn = 0;
+	for(y=0; y<MAP_ROWS; y++) {
+		x = 0;
+		while(x < MAP_COLS) {
+			cell = scene[y][x];
+			if(cell == sceneDrawn[y][x]) {
+				x++;
+				continue;
 			}
-		}
-	}
-	else if(dir == UP) {
-		for(i=x+(((map.scaleFactor)/4)*3); i<x+(map.scaleFactor); i++) {
-			for(j=y+((map.scaleFactor)/4); j<y+((((map.scaleFactor)/4)*3)); j++) {
-				GLCD_PutPixel(i,j);
+			
+			len = 1;
+			if(cell & ~CELL_BASE) {
+				GLCD_StatsTag(BUS_TANK);
+				cellTankPrint(x, y, cell);
 			}
-		}
-	}
-	else if(dir == DOWN) {
-		for(i=x; i<x+((map.scaleFactor)/4); i++) {
-			for(j=y+((map.scaleFactor)/4); j<y+((((map.scaleFactor)/4)*3)); j++) {
-				GLCD_PutPixel(i,j);
+			else {
+				while(x+len < MAP_COLS && scene[y][x+len] == cell && sceneDrawn[y][x+len] != cell)
+					len++;
+				GLCD_StatsTag(BUS_MINES);
+				cellRunPrint(x, y, len, cell);
 			}
+			
+			cellsDrawn += len;
+			for(; len>0; len--, x++)
+				sceneDrawn[y][x] = cell;
 		}
 	}
+	GLCD_StatsTag(BUS_OTHER);
 }
 
-
-
 void mapPrint(void) {
 	//Variables
 	int i=0;
-	int j=0;
-	uint16_t column = 0;
 	
-	for(i=0;i<20;i++) { //20 columns in a 1:16 scale
-		column = mapBitField[i];
-		
-		for(j=0;j<15;j++) {
-			if(column & (0x1 << (15-j))) //check if area should be occupied
-				blockPrint(i,j);
-		}
+	//same as blockPrint on every wall cell, with pre-scaled positions
+	for(i=0; i<MAP_LIST_LEN(MAP_WALLS); i++) {
+		GLCD_BlitTile(mapWallPos[i].x, mapWallPos[i].y, tileAtlas[TILE_ID_WALL]);
 	}
 }
 
+#if (PROFILE_BUS == 1)
+//Sends the SSP1 cost charged to each tag since the last report. This goes
+//through telemetry rather than printf, which would re-init UART0 at the
+//Retarget.c baud rate and mix text into the record stream
+void busReport(uint16_t frame) {
+	GLCD_STATS st;
+	int i=0;
+	
+	for(i=0; i<BUS_TAGS; i++) {
+		GLCD_Stats(i, &st, 1);
+		TLM_Bus(frame, i, st.bytes, st.cs, st.skipped, st.wire_us);
+	}
+}
+#endif
+
 // PERIPHERAL FUNCTIONS //
 
 void pushBtnRead(void) {
-	//VARIABLES
-	uint32_t buffer = 0;
-	
-	//Read from GPIO2
-	buffer |= LPC_GPIO2->FIOPIN;
-	
-	if((buffer & BIT10) == 0) 
-		tank.isMoving = 0;
+	if(HAL_ButtonRead()) 
+		stopPending = 1;
 }
 
 /*
 	joyStickRead function returns a uint8_t bit vector which signify
-	direction:
+	direction (GAME_IN_xxx):
 	0000 0001 LEFT = 0x01
 	0000 0100 UP = 0x04
 	0000 0010	RIGHT = 0x02
@@ -553,63 +415,38 @@ void pushBtnRead(void) {
 uint8_t joyStickRead(void) {
 	//VARIABLES
 	uint32_t buffer = 0;
+	uint32_t event = 0;
 	uint8_t output = 0;
 	
-	//Read from GPIO1
-	buffer |= LPC_GPIO1->FIOPIN;
+	//Debounced joystick lines (1 = pressed), plus changes since the last
+	//call so that a short tap between two ticks is not lost
+	buffer = HAL_JoystickState();
+	while(HAL_JoystickEvent(&event))
+		buffer |= event;
 	
-	if((buffer & BIT23) == 0) { //left
-		output = 0x01;
+	if(buffer & BIT23) { //left
+		output = GAME_IN_LEFT;
   }
-	else if((buffer & BIT24) == 0) { //up
-		output = 0x04;
+	else if(buffer & BIT24) { //up
+		output = GAME_IN_UP;
 	}
-	else if((buffer & BIT25) == 0) { //right
-		output = 0x02;
+	else if(buffer & BIT25) { //right
+		output = GAME_IN_RIGHT;
 	}
-	else if((buffer & BIT26) == 0) { //down
-		output = 0x03;
+	else if(buffer & BIT26) { //down
+		output = GAME_IN_DOWN;
 	}
 	else
 		output = 0;
 	
-	if((buffer & BIT20) == 0) //pressed
-		output |= (0x01 << 4);
+	if(buffer & BIT20) //pressed
+		output |= GAME_IN_PRESS;
 	
 	return output;
 }
 
 void ledDisplay(uint8_t num) {
-	//VARIABLES
-	uint32_t buffer = 0;
-	
-	//Check for invalid input
-	if(num > 255 || num < 0)
-		return;
-	
-	//Clear all LEDs
-	LPC_GPIO1->FIOCLR |= LED_ALL_G1;
-	LPC_GPIO2->FIOCLR |= LED_ALL_G2;
-	
-	//Build buffer for GPIO1
-	buffer |= ((num & BIT7) >> 7) << 28;
-	buffer |= ((num & BIT6) >> 6) << 29;
-	buffer |= ((num & BIT5) >> 5) << 31;
-	
-	//Write to register for GPIO1
-	LPC_GPIO1->FIOSET |= buffer;
-	buffer = 0;
-	
-	//Build buffer for GPIO2
-	buffer |= ((num & BIT4) >> 4) << 2;
-	buffer |= (num & BIT3); //(Right shift three, left shift three)
-	buffer |= ((num & BIT2) >> 2) << 4;
-	buffer |= ((num & BIT1) >> 1) << 5;
-	buffer |= (num & BIT0) << 6; 
-	
-	//Write to register for GPIO1
-	LPC_GPIO2->FIOSET |= buffer;
-	buffer = 0;
+	HAL_LedWrite(num);
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -618,22 +455,18 @@ void ledDisplay(uint8_t num) {
 
 //initializes all tasks and then deletes self
 __task void init_tasks(void) {
-	//initialize condition variables
-	os_sem_init(&minesSem,1);
-	os_sem_init(&tankSem,0);
-	os_sem_init(&collSem,0);
-	os_sem_init(&dispSem,0);
-	os_sem_init(&scoreSem,0);
+	//create all tasks before any of them runs, they signal each other by id
+	os_tsk_prio_self(2);
 	
 	//initialize mutex
 	os_mut_init(&dataMTX);
 	
 	//initialize tasks
-	tskMine = os_tsk_create(mines_task,1);
-	tskTank = os_tsk_create(tank_task,1);
-	tskColl = os_tsk_create(coll_task,1);
+	tskGame = os_tsk_create(game_task,1);
 	tskDisp = os_tsk_create(display_task,1);
-	tskScore = os_tsk_create(score_task,1);
+	
+	//draw the starting tank and mine states
+	os_evt_set(EVT_RENDER, tskDisp);
 	
 	//init_tasks self delete
 	os_tsk_delete_self();
@@ -641,178 +474,60 @@ __task void init_tasks(void) {
 
 //deletes all tasks
 void del_tasks(void) {
-	os_tsk_delete(tskMine);
-	os_tsk_delete(tskTank);
-	os_tsk_delete(tskColl);
-	os_tsk_delete(tskScore);
+	os_tsk_delete(tskGame);
 }
 
-//updates mine set states
-__task void mines_task(void) {
-	//mine state tracking variable
-	int i = 0;
-	//set cycle speed
-	//os_itv_set(map.minesCycleSpeed);
+/*
+	Runs the game: one Game_Step per GAME_STEP_TICKS with the input read
+	at that step. The step only depends on its input, so the TLM_INPUT
+	records sent here replay the game exactly whatever the scheduling.
+*/
+__task void game_task(void) {
+	uint8_t input = 0;
+	uint8_t lastInput = 0xFF;
+	uint8_t changed = 0;
+	uint32_t tWait, tStart;
+	os_itv_set(GAME_STEP_TICKS);
 	
 	while(1) {
-		os_itv_set(map.minesCycleSpeed);
-		//os_sem_wait(&minesSem, TIMEOUT_INDEFINITE); //wait on previous task
-		
-		//change state of current mine set to PRIMED
-		minesNext[i] = PRIMED; //*
-		
-		os_sem_send(&tankSem); //signal next task
+		tWait = HAL_TimerUs();
 		os_itv_wait();
+		tStart = HAL_TimerUs();
 		
-		//os_sem_wait(&minesSem, TIMEOUT_INDEFINITE); //wait on previous task
-		
-		//change state of current mine set to EXP
-		minesNext[i] = EXP; //*
-		
-		//os_sem_send(&tankSem); //signal next task
-		os_itv_wait();
-		
-		//change state of current mine set to INVIS
-		//change state of next mine set to PRIMED
-		//os_sem_wait(&minesSem, TIMEOUT_INDEFINITE); //wait on previous task
-		
-		minesNext[i] = INVIS; //*
-		if(i==3) minesNext[0] = PRIMED;
-			else minesNext[i+1] = PRIMED;
-		
-		//os_sem_send(&tankSem); //signal next task
-		os_itv_wait();
+		input = joyStickRead();
+		if(stopPending) {
+			stopPending = 0;
+			input |= GAME_IN_STOP;
+		}
 		
-		//increment state counter
-		if(i==3) i=0;
-			else i++;
-			
+		//record the input of every step it changed on, and send what the
+		//UART had no room for before
+		if(input != lastInput) {
+			TLM_Input(gameState.step, input);
+			lastInput = input;
+		}
+		else
+			TLM_InputRetry();
 		
-	}
-}
-
-//updates tank position data
-__task void tank_task(void) {
-	uint8_t state = 0;
-	os_itv_set(map.tankRefreshRate);
-	
-	while(1) {
 		os_mut_wait(&dataMTX, TIMEOUT_INDEFINITE);
-		os_itv_wait();
-		if(tank.isMoving == 0) {
-			os_sem_wait(&tankSem, TIMEOUT_INDEFINITE);
-			
-			
-			state = joyStickRead();
-			if((state & 0x07) == 0x01) {
-				tank.dirNext = LEFT;
-			}
-			else if((state & 0x07) == 0x02) {
-				tank.dirNext = RIGHT;
-			}
-			else if((state & 0x07) == 0x03) {
-				tank.dirNext = DOWN;
-			}
-			else if((state & 0x07) == 0x04) {
-				tank.dirNext = UP;
-			}
-			
-				
-			if((state & (0x01 << 4)) > 0)
-				tank.isMoving = 1;
-			
-			
-			os_sem_send(&collSem);
-			os_sem_send(&tankSem);
-		}
-		else if(tank.isMoving == 1) {
-			os_sem_wait(&tankSem, TIMEOUT_INDEFINITE);
-			
-			
-			switch(tank.dirCur) {
-				case(LEFT):
-					tank.yNext = tank.yCur-1;
-					break;
-				case(UP):
-					tank.xNext = tank.xCur+1;
-					break;
-				case(RIGHT):
-					tank.yNext = tank.yCur+1;
-					break;
-				case(DOWN):
-					tank.xNext = tank.xCur-1;
-			}
-			
-			os_sem_send(&collSem);
-			os_sem_send(&tankSem);
-		}
+		changed = Game_Step(&gameState, input);
 		os_mut_release(&dataMTX);
-	}
-}
-
-__task void coll_task(void) {
-	int i=0;
-	uint16_t column = 0;
-	uint8_t setNum = 0;
-	game.gameOver = 0;
-	while(1) {
-		//os_sem_wait(&collSem, TIMEOUT_INDEFINITE);
-		os_mut_wait(&dataMTX, TIMEOUT_INDEFINITE);
 		
-		//If next co-ordinate is on the edge then shift back to prev. co-ordinate and stop
-		if(tank.xNext>19 || tank.xNext < 0 || tank.yNext > 14 || tank.yNext < 0){
-			tank.xNext = tank.xCur;
-			tank.yNext = tank.yCur;
-			tank.isMoving = 0;
-		}
-		//If next co-ordinate is on the wall then shift back to prev. co-ordinate and stop
-		else{
-			column = mapBitField[tank.xNext]; 
-			if(column & (0x1 << (15-tank.yNext))){ //IF TANK NEXT IS ON A WALL
-				tank.xNext = tank.xCur;
-				tank.yNext = tank.yCur;
-				tank.isMoving = 0;
-			}
-		}
+		if(changed & GAME_CHG_SCORE)
+			ledDisplay(gameState.score);
 		
-		for(i=0; i<4; i++) {
-			if(minesCur[i] == EXP){
-				setNum = i;
-				if(setNum == 0) {
-					for(i=0; i<51; i++) {
-						if(tank.xNext == mineSet1X[i] && tank.yNext == mineSet1Y[i])
-							game.gameOver = 1;
-					}
-				}
-				else if(setNum == 1) {
-					for(i=0; i<56; i++) {
-						if(tank.xNext == mineSet2X[i] && tank.yNext == mineSet2Y[i])
-							game.gameOver = 1;
-					}
-				}
-				else if(setNum == 2) {
-					for(i=0; i<58; i++) {
-						if(tank.xNext == mineSet3X[i] && tank.yNext == mineSet3Y[i])
-							game.gameOver = 1;
-					}
-				}
-				else if(setNum == 3) {
-					for(i=0; i<59; i++) {
-						if(tank.xNext == mineSet4X[i] && tank.yNext == mineSet4Y[i])
-							game.gameOver = 1;
-					}
-				}
-			}
-		}
-				
-		os_sem_send(&dispSem);
-		os_mut_release(&dataMTX);
-		//os_sem_send(&collSem);
+		//only wake the display if there is something new
+		if(changed)
+			os_evt_set(EVT_RENDER, tskDisp);
+		TLM_Task(TLM_ID_GAME, tWait, tStart, HAL_TimerUs());
 	}
 }
 
 void endScreenPrint(void) {
-	snprintf(game.endScore, 20, "SCORE: %d Pts", game.score);
+	//text is drawn straight to the LCD, so stop buffering
+	GLCD_FB_Enable(0);
+	
+	snprintf(game.endScore, 20, "SCORE: %d Pts", gameState.score);
 	GLCD_Clear(White);
 	GLCD_SetBackColor(White);
 	GLCD_SetTextColor(Black);
@@ -820,65 +535,54 @@ void endScreenPrint(void) {
 	GLCD_DisplayString(16,20,0, game.endScore);
 }
 
-//Uses tank data and mine data to print display
+//Draws what changed between the game state and the LCD
 __task void display_task(void) {
-	int i=0;
-	int setNum =0;
-	//print tank starting position
-	tankPrint(tank.xCur, tank.yCur, tank.dirCur);
+	GameState view;
+	uint16_t frame = 0;
+	uint32_t tWait, tStart, tEnd;
+	//sleep on DMA bursts instead of spinning
+	GLCD_DMAYield(1);
 	
 	while(1) {
-		os_sem_wait(&dispSem, TIMEOUT_INDEFINITE);
+		tWait = HAL_TimerUs();
+		os_evt_wait_or(EVT_RENDER, TIMEOUT_INDEFINITE);
+		tStart = HAL_TimerUs();
+		
+		//draw from a copy so game_task is not held up by the LCD
+		os_mut_wait(&dataMTX, TIMEOUT_INDEFINITE);
+		view = gameState;
+		os_mut_release(&dataMTX);
 		
 		//check for gameOver
-		if(game.gameOver) {
+		if(view.gameOver) {
 			endScreenPrint();
 			del_tasks();
+			//game_task is gone, send the input records still waiting for
+			//room on the UART so the recording is complete
+			while(TLM_InputRetry())
+				os_dly_wait(1);
 			break;
 		}
 		
-		//print tank if direction/position changed
-		if(tank.dirNext != tank.dirCur || tank.xNext != tank.xCur || tank.yNext != tank.yCur) {
-			
-			blockClear(tank.xCur,tank.yCur);
-			
-			//store new tank data
-			tank.dirCur = tank.dirNext;
-			tank.xCur = tank.xNext;
-			tank.yCur = tank.yNext;
-			
-			tankPrint(tank.xCur,tank.yCur,tank.dirNext);
-			
-			//Reprint PRIMED mine set in case tank drove over them
-			for(i=0;i<4;i++) {
-				if(minesNext[i] == PRIMED)
-					mineSetPrint(i, minesNext[i]);
-			}
-		}
+		//draw the cells that changed since the last frame
+		sceneBuild(&view);
+		sceneDraw();
 		
-		//print mines if state changed
-		for(i=0; i<4; i++) {
-			if(minesNext[i] != minesCur[i])
-				mineSetPrint(i, minesNext[i]);
-		}
+		//send the regions that changed during this frame
+		GLCD_StatsTag(BUS_FLUSH);
+		GLCD_FB_Flush();
+		GLCD_StatsTag(BUS_OTHER);
 		
-		os_sem_send(&scoreSem);
-		//os_sem_send(&minesSem);
-	}
-}
-
-__task void score_task(void) {
-	os_itv_set(map.scoreCycleSpeed);
-	while(1) {
-		os_sem_wait(&scoreSem, TIMEOUT_INDEFINITE);
-		
-		(game.score)+=10;
-		ledDisplay(game.score);
+		//frame timing, read the SSP1 bytes before busReport resets them
+		tEnd = HAL_TimerUs();
+		TLM_Frame(frame, tStart, tEnd, GLCD_SpiBytes(PROFILE_BUS == 0), cellsDrawn);
+		TLM_Task(TLM_ID_DISP, tWait, tStart, tEnd);
+		TLM_Idle(tEnd, HAL_SleepUs(1));
 		
-		map.minesCycleSpeed = map.minesCycleSpeed*0.8;
-		
-		os_itv_wait();
-		os_sem_send(&minesSem);
+#if (PROFILE_BUS == 1)
+		busReport(frame);
+#endif
+		frame++;
 	}
 }
 
@@ -976,7 +680,7 @@ void startScreen(void) {
 	char* m4;
 	char* m5;
 	char* m6;
-	uint32_t bufferJoystick = 0;
+	uint32_t joy;
 	
 	m1 = "Avoid landing on exploded mines";
 	m2 = "About to explode = yellow, exploded = red";
@@ -985,11 +689,7 @@ void startScreen(void) {
 	m5 = "Use push button to stop tank";
 	m6 = "PUSH JOYSTICK BUTTON TO START";
 	
-	//Buffer for Joystick button press	
-	bufferJoystick = 0;
-	bufferJoystick |= LPC_GPIO1->FIOPIN;
-	
-	snprintf(game.endScore, 20, "SCORE: %d Pts", game.score);
+	snprintf(game.endScore, 20, "SCORE: %d Pts", gameState.score);
 	GLCD_Clear(White);
 	GLCD_SetBackColor(White);
 	GLCD_SetTextColor(Black);
@@ -1001,9 +701,11 @@ void startScreen(void) {
 	GLCD_DisplayString(17,2,0, m5);
 	GLCD_DisplayString(25,2,0, m6);
 	
-	//Waiting for joystick button press	
-	while(!((LPC_GPIO1->FIOPIN & BIT20) == 0)){
-		
+	//Waiting for joystick button press, sleeping between samples
+	while(1) {
+		if(HAL_JoystickEvent(&joy) && (joy & BIT20))
+			break;
+		HAL_Sleep();
 	}
 	
 	//Configuring screen settings for the game	
@@ -1046,8 +748,13 @@ int main(void) {
 	initialization();
 	//start screen
 	startScreen();
+	//buffer the game screen from here on
+	GLCD_FB_Enable(1);
 	//printing map after the start screen
+	GLCD_StatsTag(BUS_MAP);
 	mapPrint();
+	GLCD_FB_Flush();
+	GLCD_StatsTag(BUS_OTHER);
 	//initialization of tasks
 	os_sys_init(init_tasks);
 }
@@ -0,0 +1,181 @@
+// Binary telemetry over UART (record layout in telemetry.h)
+
+#include <stdint.h>
+#include "telemetry.h"
+#include "uart.h"
+
+#define TLM_MAX_PAYLOAD (16)
+#define TLM_INPUT_QUEUE (16)   // input records waiting for room on the UART
+
+typedef struct {
+	uint16_t seq;
+	uint32_t step;
+	uint8_t input;
+} INPUT_REC;
+
+static uint32_t dropped = 0;
+
+// Input records not sent yet, owned by game_task, and by display_task
+// once del_tasks() has removed game_task
+static INPUT_REC inputQueue[TLM_INPUT_QUEUE];
+static uint8_t inputHead = 0, inputTail = 0;
+static uint16_t inputSeq = 0;
+
+static uint8_t crc8(uint8_t crc, uint8_t data) {
+	uint8_t i;
+
+	crc ^= data;
+	for(i=0; i<8; i++)
+		crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+	return crc;
+}
+
+static uint8_t *put32(uint8_t *p, uint32_t val) {
+	p[0] = val;
+	p[1] = val >> 8;
+	p[2] = val >> 16;
+	p[3] = val >> 24;
+	return p + 4;
+}
+
+void TLM_Init(void) {
+#if (TLM_ENABLE == 1)
+	UARTInit(TLM_PORT, TLM_BAUD);
+#endif
+}
+
+// Frames a record and queues it on the UART as a whole, returns 0 if there
+// was no room for it
+static uint8_t tlmFrame(uint8_t type, const uint8_t *payload, uint8_t len) {
+	uint8_t buf[TLM_MAX_PAYLOAD + 4];
+	uint8_t crc = 0;
+	uint8_t i;
+
+	if(TLM_ENABLE == 0 || len > TLM_MAX_PAYLOAD)
+		return 0;
+
+	buf[0] = TLM_SYNC;
+	buf[1] = type;
+	buf[2] = len;
+	crc = crc8(crc, type);
+	crc = crc8(crc, len);
+	for(i=0; i<len; i++) {
+		buf[3+i] = payload[i];
+		crc = crc8(crc, payload[i]);
+	}
+	buf[3+len] = crc;
+
+	return UARTSendAll(TLM_PORT, buf, len + 4) != 0;
+}
+
+// Sends a record, returns 0 if it was dropped
+uint8_t TLM_Send(uint8_t type, const uint8_t *payload, uint8_t len) {
+	if(TLM_ENABLE == 0)
+		return 0;
+	if(!tlmFrame(type, payload, len)) {
+		dropped++;
+		return 0;
+	}
+	return 1;
+}
+
+// Records dropped because the UART ring was full
+uint32_t TLM_Dropped(void) {
+	return dropped;
+}
+
+// One pass of a task loop: blocked from waitStart to start, ran until end
+void TLM_Task(uint8_t id, uint32_t waitStart, uint32_t start, uint32_t end) {
+	uint8_t rec[13];
+	uint8_t *p = rec;
+
+	*p++ = id;
+	p = put32(p, start);
+	p = put32(p, start - waitStart);
+	p = put32(p, end - start);
+	TLM_Send(TLM_TASK, rec, sizeof(rec));
+}
+
+// One display frame, the SSP1 bytes it took and the map cells it drew
+void TLM_Frame(uint16_t frame, uint32_t start, uint32_t end, uint32_t spiBytes, uint16_t cells) {
+	uint8_t rec[16];
+	uint8_t *p = rec;
+
+	*p++ = frame;
+	*p++ = frame >> 8;
+	p = put32(p, start);
+	p = put32(p, end - start);
+	p = put32(p, spiBytes);
+	*p++ = cells;
+	*p++ = cells >> 8;
+	TLM_Send(TLM_FRAME, rec, sizeof(rec));
+}
+
+// Time the core spent asleep in the idle task since the last record
+void TLM_Idle(uint32_t now, uint32_t sleepUs) {
+	uint8_t rec[8];
+	uint8_t *p = rec;
+
+	p = put32(p, now);
+	p = put32(p, sleepUs);
+	TLM_Send(TLM_IDLE, rec, sizeof(rec));
+}
+
+// Sends the queued input records in order, up to the first one the UART
+// has no room for yet, and returns the number still queued
+uint8_t TLM_InputRetry(void) {
+	INPUT_REC *q;
+	uint8_t rec[7];
+	uint8_t *p;
+
+	while(inputTail != inputHead) {
+		q = &inputQueue[inputTail % TLM_INPUT_QUEUE];
+		p = rec;
+		*p++ = q->seq;
+		*p++ = q->seq >> 8;
+		p = put32(p, q->step);
+		*p++ = q->input;
+		if(!tlmFrame(TLM_INPUT, rec, sizeof(rec)))
+			break;
+		inputTail++;
+	}
+	return inputHead - inputTail;
+}
+
+// Game input from this step on, enough to replay the game with
+// Game_ReplayInputs. The record waits in a queue until the UART has room
+// for it (TLM_InputRetry); if the queue is full it is lost, which the gap
+// in the sequence numbers shows.
+void TLM_Input(uint32_t step, uint8_t input) {
+	INPUT_REC *q;
+
+	if(TLM_ENABLE == 0)
+		return;
+	if((uint8_t)(inputHead - inputTail) < TLM_INPUT_QUEUE) {
+		q = &inputQueue[inputHead++ % TLM_INPUT_QUEUE];
+		q->seq = inputSeq;
+		q->step = step;
+		q->input = input;
+	} else {
+		dropped++;
+	}
+	inputSeq++;
+	TLM_InputRetry();
+}
+
+// SSP1 cost charged to one GLCD_StatsTag tag during a frame
+void TLM_Bus(uint16_t frame, uint8_t tag, uint32_t bytes, uint16_t cs, uint16_t skipped, uint32_t wireUs) {
+	uint8_t rec[15];
+	uint8_t *p = rec;
+
+	*p++ = frame;
+	*p++ = frame >> 8;
+	*p++ = tag;
+	p = put32(p, bytes);
+	*p++ = cs;
+	*p++ = cs >> 8;
+	*p++ = skipped;
+	*p++ = skipped >> 8;
+	p = put32(p, wireUs);
+	TLM_Send(TLM_BUS, rec, sizeof(rec));
+}
@@ -0,0 +1,50 @@
+// Binary telemetry over UART
+//
+// Every record is sent as one frame:
+//
+//   0xA5 | type | len | payload (len bytes) | crc
+//
+// crc is a CRC-8 (polynomial 0x07, initial value 0) over type, len and the
+// payload. Multi-byte fields are little endian, times are in microseconds
+// from HAL_TimerUs. Records are queued with UARTSendAll and dropped as a
+// whole when the UART ring has no room for them, so sending never blocks a
+// task and the stream never holds a cut-off record. TLM_Dropped counts them.
+// TLM_INPUT records are needed for a replay, so they are queued and sent
+// again until the UART takes them, and numbered so a lost one shows.
+
+#ifndef _TELEMETRY_H
+#define _TELEMETRY_H
+
+#include <stdint.h>
+
+// 0 to turn the calls below into no-ops
+#ifndef TLM_ENABLE
+#define TLM_ENABLE     (1)
+#endif
+
+#define TLM_SYNC       (0xA5)
+#define TLM_PORT       (0)
+#define TLM_BAUD       (115200)
+
+// Record types
+#define TLM_TASK       (0x01)  // id u8, start u32, wait u32, run u32
+#define TLM_FRAME      (0x02)  // frame u16, start u32, render u32, spi bytes u32, cells u16
+#define TLM_IDLE       (0x03)  // time u32, sleep u32 (asleep since last record)
+#define TLM_INPUT      (0x04)  // seq u16, step u32, input u8 (held until the next record)
+#define TLM_BUS        (0x05)  // frame u16, tag u8, bytes u32, cs u16, skipped u16, wire u32
+
+// Task ids of TLM_TASK records
+#define TLM_ID_GAME    (1)
+#define TLM_ID_DISP    (3)
+
+void TLM_Init(void);
+uint8_t TLM_Send(uint8_t type, const uint8_t *payload, uint8_t len);
+uint32_t TLM_Dropped(void);
+void TLM_Task(uint8_t id, uint32_t waitStart, uint32_t start, uint32_t end);
+void TLM_Frame(uint16_t frame, uint32_t start, uint32_t end, uint32_t spiBytes, uint16_t cells);
+void TLM_Idle(uint32_t now, uint32_t sleepUs);
+void TLM_Input(uint32_t step, uint8_t input);
+uint8_t TLM_InputRetry(void);
+void TLM_Bus(uint16_t frame, uint8_t tag, uint32_t bytes, uint16_t cs, uint16_t skipped, uint32_t wireUs);
+
+#endif /* _TELEMETRY_H */
@@ -19,7 +19,9 @@
  * use without further testing or modification.
 ****************************************************************************/
 #include "lpc17xx.h"
+#include <rtl.h>
 //#include "type.h"
+#include "hal_io.h"
 #include "uart.h"
 
 extern uint32_t SystemCoreClock;
@@ -29,54 +31,88 @@ volatile int ITM_RxBuffer = ITM_RXBUFFER_EMPTY;  /*  CMSIS Debug Input        */
 //#endif
 
 volatile uint32_t UART0Status, UART1Status;
-volatile uint8_t UART0TxEmpty = 1, UART1TxEmpty = 1;
-volatile uint8_t UART0Buffer[BUFSIZE], UART1Buffer[BUFSIZE];
-volatile uint32_t UART0Count = 0, UART1Count = 0;
 
-volatile uint8_t RcvLock0; 
-volatile uint8_t SndLock0; 
+/* TX ring per port: UARTSend writes Head, the THRE interrupt moves Tail */
+typedef struct {
+	uint8_t  Buffer[TXBUFSIZE];
+	volatile uint32_t Head;
+	volatile uint32_t Tail;
+	uint32_t Dropped;		/* bytes that did not fit into the ring */
+	uint32_t Overruns;		/* sends that were cut short or dropped */
+} UART_TX;
+
+UART_TX UARTTx[2];
+
+/* RX ring per port: the interrupt writes Head, UARTRecieve moves Tail */
+typedef struct {
+	uint8_t  Buffer[RXBUFSIZE];
+	volatile uint32_t Head;
+	volatile uint32_t Tail;
+	volatile OS_TID Waiter;	/* task sleeping in UARTRecieve, 0 if none */
+	OS_MUT   Readers;		/* one reading task at a time */
+	uint32_t Dropped;		/* bytes lost because the ring was full */
+	uint32_t Overruns;		/* hardware RX FIFO overruns (LSR_OE) */
+} UART_RX;
+
+UART_RX UARTRx[2];
 
-volatile uint8_t RcvLock1; 
-volatile uint8_t SndLock1; 
-
-volatile int i = 0;
-
-void Free(volatile uint8_t *tbl){
-	*tbl = 0;
-}
+/*****************************************************************************
+** Function name:		UARTTxFill
+**
+** Descriptions:		Move up to one FIFO worth of bytes from the TX ring
+**						into the UART. Only call when THR is empty.
+**
+** parameters:			UART registers and TX ring of the port
+** Returned value:		None
+** 
+*****************************************************************************/
+void UARTTxFill( LPC_UART_TypeDef *LPC_UART, UART_TX *tx )
+{
+	uint32_t n = 0;
 
-uint8_t Lock(volatile uint8_t *tbl){
-	// Get the lock status and see if it is already locked
-	if (__LDREXW(tbl) == 0) {
-		// if not locked, try set lock to 1
-		return  (__STREXW(1, tbl) != 0) ;
-	} else {
-		return(1); // return fail status
+	while ( tx->Tail != tx->Head && n < TXFIFOSIZE ){
+		IO_WR(LPC_UART->THR, tx->Buffer[tx->Tail & (TXBUFSIZE - 1)]);
+		tx->Tail++;
+		n++;
 	}
 }
 
-uint8_t LockRcv(uint8_t portNum){
-	if(portNum > 1)
-		return 0x1;
-	return Lock(portNum == 0? &RcvLock0 : &RcvLock1);
-}
 
-uint8_t LockSnd(uint8_t portNum){
-	if(portNum > 1)
-		return 0x1;
-	return Lock(portNum == 0? &SndLock0 : &SndLock1);
-}
+/*****************************************************************************
+** Function name:		UARTRxDrain
+**
+** Descriptions:		Move all bytes from the UART RX FIFO into the RX
+**						ring and wake the task waiting for them
+**
+** parameters:			UART registers, RX ring and LSR value of the port
+** Returned value:		None
+** 
+*****************************************************************************/
+void UARTRxDrain( LPC_UART_TypeDef *LPC_UART, UART_RX *rx, uint8_t LSRValue )
+{
+	uint32_t head = rx->Head;
 
-void FreeRcv(uint8_t portNum){
-	if(portNum > 1)
-		return;
-	Free( portNum == 0? &RcvLock0 : &RcvLock1 );
-}
+	if ( LSRValue & LSR_OE )
+		rx->Overruns++;
 
-void FreeSnd(uint8_t portNum){
-	if(portNum > 1)
-		return;
-	Free( portNum == 0? &SndLock0 : &SndLock1 );
+	/* Note: read RBR will clear the interrupt */
+	while ( LSRValue & LSR_RDR ){
+		if ( head - rx->Tail < RXBUFSIZE ){
+			rx->Buffer[head & (RXBUFSIZE - 1)] = IO_RD(LPC_UART->RBR);
+			head++;
+		}
+		else{
+			IO_RD(LPC_UART->RBR);
+			rx->Dropped++;
+		}
+		LSRValue = IO_RD(LPC_UART->LSR);
+	}
+
+	if ( head != rx->Head ){
+		rx->Head = head;
+		if ( rx->Waiter )
+			isr_evt_set(UART_RX_EVT, rx->Waiter);
+	}
 }
 
 
@@ -93,36 +129,20 @@ void UART0_IRQHandler (void)
 {
 	uint8_t IIRValue, LSRValue;
 
-	IIRValue = LPC_UART0->IIR;
+	IIRValue = IO_RD(LPC_UART0->IIR);
 
 	IIRValue >>= 1;			/* skip pending bit in IIR */
 	IIRValue &= 0x07;			/* check bit 1~3, interrupt identification */
 
-	LSRValue = LPC_UART0->LSR;
+	LSRValue = IO_RD(LPC_UART0->LSR);
 
-	if ( LSRValue & LSR_RDR )	/* Receive Data Ready */	
-	{
-		/* If no error on RLS, normal ready, save into the data buffer. */
-		/* Note: read RBR will clear the interrupt */
-		UART0Buffer[UART0Count] = LPC_UART0->RBR;
-		UART0Count++;
-		if ( UART0Count == BUFSIZE )
-		{
-		UART0Count = 0;		/* buffer overflow */
-		}
-	}
+	/* Receive Data Ready or line status */
+	UARTRxDrain((LPC_UART_TypeDef *)LPC_UART0, &UARTRx[0], LSRValue);
 
 	if ( IIRValue == IIR_THRE )	/* THRE, transmit holding register empty */
 	{
-	/* THRE interrupt */
-		LSRValue = LPC_UART0->LSR;		/* Check status in the LSR to see if
-									valid data in U0THR or not */
-		if ( LSRValue & LSR_THRE ){
-			UART0TxEmpty = 1;
-		}
-		else{
-			UART0TxEmpty = 0;
-		}
+	/* THRE interrupt: refill the FIFO from the TX ring */
+		UARTTxFill((LPC_UART_TypeDef *)LPC_UART0, &UARTTx[0]);
 	}
 
 }
@@ -141,35 +161,20 @@ void UART1_IRQHandler (void)
 
 	uint8_t IIRValue, LSRValue;
 
-	IIRValue = LPC_UART1->IIR;
+	IIRValue = IO_RD(LPC_UART1->IIR);
 
 	IIRValue >>= 1;			/* skip pending bit in IIR */
 	IIRValue &= 0x07;			/* check bit 1~3, interrupt identification */
 
-	LSRValue = LPC_UART1->LSR;
+	LSRValue = IO_RD(LPC_UART1->LSR);
 
-	if ( LSRValue & LSR_RDR )	/* Receive Data Ready */	
-	{
-		/* If no error on RLS, normal ready, save into the data buffer. */
-		/* Note: read RBR will clear the interrupt */
-		UART1Buffer[UART1Count] = LPC_UART1->RBR;
-		UART1Count++;
-		if ( UART1Count == BUFSIZE ){
-		UART0Count = 0;		/* buffer overflow */
-		}
-	}
+	/* Receive Data Ready or line status */
+	UARTRxDrain((LPC_UART_TypeDef *)LPC_UART1, &UARTRx[1], LSRValue);
 
 	if ( IIRValue == IIR_THRE )	/* THRE, transmit holding register empty */
 	{
-	/* THRE interrupt */
-		LSRValue = LPC_UART1->LSR;		/* Check status in the LSR to see if
-									valid data in U0THR or not */
-		if ( LSRValue & LSR_THRE ){
-			UART1TxEmpty = 1;
-		}
-		else{
-			UART1TxEmpty = 0;
-		}
+	/* THRE interrupt: refill the FIFO from the TX ring */
+		UARTTxFill((LPC_UART_TypeDef *)LPC_UART1, &UARTTx[1]);
 	}
 
 }
@@ -232,15 +237,14 @@ uint32_t UARTInit( uint32_t PortNum, uint32_t baudrate )
 		LPC_UART0->DLL = Fdiv % 256;
 
 		LPC_UART0->LCR = 0x03;		/* DLAB = 0 */
-		LPC_UART0->FCR = 0x07;		/* Enable and reset TX and RX FIFO. */
+		IO_WR(LPC_UART0->FCR, 0x07);		/* Enable and reset TX and RX FIFO. */
 
 	 	NVIC_EnableIRQ(UART0_IRQn);
 
 		//LPC_UART0->IER = IER_RBR | IER_THRE | IER_RLS;	/* Enable UART0 interrupt */
-		//LPC_UART0->IER =  IER_THRE ;//| IER_RLS;			/* Disable RBR */
+		IO_WR(LPC_UART0->IER, IER_RBR | IER_RLS);	/* Receive into the RX ring from now on */
 
-		FreeRcv(0);
-		FreeSnd(0);
+		os_mut_init(&UARTRx[0].Readers);
 		return (TRUE);
 	}
 	else if ( PortNum == 1 )
@@ -260,14 +264,14 @@ uint32_t UARTInit( uint32_t PortNum, uint32_t baudrate )
 		LPC_UART1->DLL = Fdiv % 256;
 
 		LPC_UART1->LCR = 0x03;		/* DLAB = 0 */
-		LPC_UART1->FCR = 0x07;		/* Enable and reset TX and RX FIFO. */
+		IO_WR(LPC_UART1->FCR, 0x07);		/* Enable and reset TX and RX FIFO. */
 
 	 	NVIC_EnableIRQ(UART1_IRQn);
 
 		//LPC_UART1->IER = IER_RBR | IER_THRE | IER_RLS;	/* Enable UART1 interrupt */
+		IO_WR(LPC_UART1->IER, IER_RBR | IER_RLS);	/* Receive into the RX ring from now on */
 
-		FreeRcv(1);
-		FreeSnd(1);
+		os_mut_init(&UARTRx[1].Readers);
 
 		return (TRUE);
 	}
@@ -275,133 +279,243 @@ uint32_t UARTInit( uint32_t PortNum, uint32_t baudrate )
 }
 
 /*****************************************************************************
-** Function name:		UARTSend
+** Function name:		UARTTxQueue
 **
-** Descriptions:		Send a block of data to the UART 0 port based
-**						on the data length
+** Descriptions:		Copy a block into the TX ring of UART 0-1 and start
+**						sending. With Whole set the block is queued only if
+**						all of it fits, otherwise it is dropped as a whole.
 **
-** parameters:			portNum, buffer pointer, and data length
-** Returned value:		None
+** parameters:			portNum, buffer pointer, data length, whole flag
+** Returned value:		number of bytes queued
 ** 
 *****************************************************************************/
 
-void UARTSend( uint32_t portNum, uint8_t *BufferPtr, uint32_t Length )
+static uint32_t UARTTxQueue( uint32_t portNum, uint8_t *BufferPtr, uint32_t Length, uint8_t Whole )
 {
 	LPC_UART_TypeDef *LPC_UART;
-	volatile unsigned char *UARTTxEmpty;				//ASK Douglas
-	uint8_t *localBufferPtr;
-	uint32_t localLength;
+	UART_TX *tx;
+	uint32_t head, n = 0;
 
 	if((portNum >> 1 ) != 0)
-		return;
+		return 0;
 
-	localLength = Length;
-	localBufferPtr = BufferPtr;
-	UARTTxEmpty = (portNum == 0 ? &UART0TxEmpty : &UART1TxEmpty);
+	tx = &UARTTx[portNum];
 	LPC_UART = (portNum == 0 ? (LPC_UART_TypeDef *)LPC_UART0 : (LPC_UART_TypeDef *)LPC_UART1 );
 
-	//Enable interupt
-	LPC_UART->IER |=  IER_THRE;
+	//One task at a time copies into the ring. The scheduler lock only
+	//holds off task switches for the copy, interrupts keep running.
+	tsk_lock();
 
-	while( LockSnd(portNum));
+	head = tx->Head;
+	if ( !Whole || TXBUFSIZE - (head - tx->Tail) >= Length ){
+		for ( ; n < Length && head - tx->Tail < TXBUFSIZE; ++n ){
+			tx->Buffer[head & (TXBUFSIZE - 1)] = BufferPtr[n];
+			head++;
+		}
+		tx->Head = head;
+	}
 
-	while ( localLength != 0 ){
-		/* THRE status, contain valid data */
-		while ( !(*UARTTxEmpty & 0x01) );
-		LPC_UART->THR = *localBufferPtr;
-		*UARTTxEmpty = 0;	/* not empty in the THR until it shifts out */
-		localBufferPtr++;
-		localLength--;
+	if ( n < Length ){
+		tx->Dropped += Length - n;
+		tx->Overruns++;
 	}
 
-	FreeSnd(portNum);
+	//Start sending if the transmitter is idle, the THRE interrupt takes
+	//over from there
+	IO_WR(LPC_UART->IER, LPC_UART->IER & ~IER_THRE);
+	if ( IO_RD(LPC_UART->LSR) & LSR_THRE )
+		UARTTxFill(LPC_UART, tx);
+	IO_WR(LPC_UART->IER, LPC_UART->IER | IER_THRE);
 
-	//Reanble other interpts
-	LPC_UART->IER &= ~IER_THRE;
+	tsk_unlock();
 
-	return;
+	return n;
 }
 
-void UARTSendChar( uint32_t portNum, uint8_t character)
-{
-	#ifdef __RTGT_UART
-		LPC_UART_TypeDef *LPC_UART;
-		LPC_UART = (portNum == 0 ? (LPC_UART_TypeDef *)LPC_UART0 : (LPC_UART_TypeDef *)LPC_UART1 );
-		while (!(LPC_UART->LSR & 0x20));
-		LPC_UART->THR = character;
-	#else
-		ITM_SendChar(character);
-	#endif
+/*****************************************************************************
+** Function name:		UARTSend
+**
+** Descriptions:		Queue a block of data for sending on the UART 0-1
+**						port. Returns without waiting for the data to go
+**						out; what does not fit into the TX ring is dropped
+**						and counted.
+**
+** parameters:			portNum, buffer pointer, and data length
+** Returned value:		number of bytes queued
+** 
+*****************************************************************************/
 
+uint32_t UARTSend( uint32_t portNum, uint8_t *BufferPtr, uint32_t Length )
+{
+	return UARTTxQueue( portNum, BufferPtr, Length, FALSE );
 }
 
-
 /*****************************************************************************
-** Function name:		UARTRecieve
+** Function name:		UARTSendAll
 **
-** Descriptions:		Recieve a block of data to the UART 0-1 port based
-**						on the data length
+** Descriptions:		Like UARTSend, but the block is queued only if all
+**						of it fits into the TX ring, so framed records are
+**						never cut short. A block that does not fit is
+**						dropped and counted as a whole.
 **
 ** parameters:			portNum, buffer pointer, and data length
-** Returned value:		integer showing status
+** Returned value:		Length if queued, 0 if dropped
 ** 
 *****************************************************************************/
-uint32_t UARTRecieve( uint32_t portNum, uint8_t *BufferPtr, uint32_t Length )
+
+uint32_t UARTSendAll( uint32_t portNum, uint8_t *BufferPtr, uint32_t Length )
 {
+	return UARTTxQueue( portNum, BufferPtr, Length, TRUE );
+}
 
+/*****************************************************************************
+** Function name:		UARTFlush
+**
+** Descriptions:		Wait until the TX ring and the UART are empty
+**
+** parameters:			portNum
+** Returned value:		None
+** 
+*****************************************************************************/
+void UARTFlush( uint32_t portNum )
+{
 	LPC_UART_TypeDef *LPC_UART;
-	volatile uint32_t *UARTCount;				//ASK Douglas
-	volatile uint8_t *UARTBuffer;
-	uint8_t *rcvdBufferPtr;
-	uint32_t rcvd_len, i;
 
 	if((portNum >> 1 ) != 0)
-		return 0;
+		return;
 
-	rcvd_len = 0x0;
-	rcvdBufferPtr = BufferPtr;
-	UARTCount = (portNum == 0 ? &UART0Count : &UART1Count);
-	UARTBuffer = (portNum == 0 ? UART0Buffer : UART1Buffer);
 	LPC_UART = (portNum == 0 ? (LPC_UART_TypeDef *)LPC_UART0 : (LPC_UART_TypeDef *)LPC_UART1 );
 
-	*UARTCount = 0x0;
+	//The THRE interrupt empties the ring, LSR is polled in the meantime.
+	//LSR goes first so every pass touches the UART, also on the host.
+	while ( !(IO_RD(LPC_UART->LSR) & LSR_TEMT) || UARTTx[portNum].Tail != UARTTx[portNum].Head );
+}
 
-	//Enable interupt
-	LPC_UART->IER |=  IER_RBR;
+/*****************************************************************************
+** Function name:		UARTTxStats
+**
+** Descriptions:		Read the TX drop counters of the UART 0-1 port
+**
+** parameters:			portNum, bytes dropped and UARTSend calls cut short
+**						(either pointer may be NULL)
+** Returned value:		None
+** 
+*****************************************************************************/
+void UARTTxStats( uint32_t portNum, uint32_t *Dropped, uint32_t *Overruns )
+{
+	if((portNum >> 1 ) != 0)
+		return;
 
-	//busy waiting
+	if ( Dropped )
+		*Dropped = UARTTx[portNum].Dropped;
+	if ( Overruns )
+		*Overruns = UARTTx[portNum].Overruns;
+}
 
-	while( *UARTCount == 0 );
+void UARTSendChar( uint32_t portNum, uint8_t character)
+{
+	#ifdef __RTGT_UART
+		UARTSend(portNum, &character, 1);
+	#else
+		ITM_SendChar(character);
+	#endif
 
+}
 
-	//This part has to be put in the critical section
-	while(LockRcv(portNum));
 
-	//Reanble other interpts
-	LPC_UART->IER &= ~IER_RBR;			/* Disable RBR */
+/*****************************************************************************
+** Function name:		UARTRecieve
+**
+** Descriptions:		Recieve a block of data from the UART 0-1 port.
+**						Waits for at least one byte, sleeping on an RTX
+**						event when called from a task, then returns what
+**						is buffered up to Length bytes. Other tasks reading
+**						the port meanwhile sleep until it is done.
+**
+** parameters:			portNum, buffer pointer, and data length
+** Returned value:		number of bytes received
+** 
+*****************************************************************************/
+uint32_t UARTRecieve( uint32_t portNum, uint8_t *BufferPtr, uint32_t Length )
+{
+	UART_RX *rx;
+	OS_TID self;
+	uint32_t rcvd_len, tail, held = 0;
 
+	if((portNum >> 1 ) != 0)
+		return 0;
 
-	for(i = 0; i < *UARTCount; ++i)
-		rcvdBufferPtr[rcvd_len++] = UARTBuffer[i];
+	rx = &UARTRx[portNum];
+	self = os_tsk_self();
+
+	for ( ;; ){
+		//One task at a time copies out of the ring, the scheduler lock
+		//holds off the other readers, interrupts keep running
+		if ( self )
+			tsk_lock();
+		tail = rx->Tail;
+		for ( rcvd_len = 0; rcvd_len < Length && tail != rx->Head; ++rcvd_len ){
+			BufferPtr[rcvd_len] = rx->Buffer[tail & (RXBUFSIZE - 1)];
+			tail++;
+		}
+		rx->Tail = tail;
+		if ( self )
+			tsk_unlock();
+		if ( rcvd_len || Length == 0 )
+			break;
+
+		if ( self && !held ){
+			//One task at a time waits for data, the others sleep on the
+			//mutex, which lends the waiting one their priority
+			os_mut_wait(&rx->Readers, 0xFFFF);
+			held = 1;
+			continue;
+		}
 
-	*UARTCount = 0;
+		//Register before checking again, so data arriving now wakes us up.
+		//A flag left over from an earlier wait only costs one more check
+		rx->Waiter = self;
+		while ( rx->Head == rx->Tail ){
+			if ( rx->Waiter )
+				os_evt_wait_or(UART_RX_EVT, 0xFFFF);
+		}
+		rx->Waiter = 0;
+	}
 
-	FreeRcv(portNum);
+	if ( held )
+		os_mut_release(&rx->Readers);
 
 	return rcvd_len;
 }
 
+/*****************************************************************************
+** Function name:		UARTRxStats
+**
+** Descriptions:		Read the RX loss counters of the UART 0-1 port
+**
+** parameters:			portNum, bytes dropped on a full ring and hardware
+**						FIFO overruns (either pointer may be NULL)
+** Returned value:		None
+** 
+*****************************************************************************/
+void UARTRxStats( uint32_t portNum, uint32_t *Dropped, uint32_t *Overruns )
+{
+	if((portNum >> 1 ) != 0)
+		return;
+
+	if ( Dropped )
+		*Dropped = UARTRx[portNum].Dropped;
+	if ( Overruns )
+		*Overruns = UARTRx[portNum].Overruns;
+}
+
 uint8_t UARTReceiveChar( uint32_t portNum)
 {
 	#ifdef __RTGT_UART
-		/*uint8_t ret[1];
+		uint8_t ret[1];
 		if (UARTRecieve(portNum, ret, 1) == 1)
 			return ret[0];
-		return 0x0;	*/
-		LPC_UART_TypeDef *LPC_UART;
-		LPC_UART = (portNum == 0 ? (LPC_UART_TypeDef *)LPC_UART0 : (LPC_UART_TypeDef *)LPC_UART1 );
-		while (!(LPC_UART->LSR & 0x01));
-		return (LPC_UART->RBR);
+		return 0x0;
 	#else
 		while (ITM_CheckChar() != 1) __NOP();
 		return (ITM_ReceiveChar());
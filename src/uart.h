@@ -41,7 +41,10 @@
 #define LSR_TEMT	0x40
 #define LSR_RXFE	0x80
 
-#define BUFSIZE		0x40
+#define TXBUFSIZE	0x100		/* TX ring size, power of 2 */
+#define RXBUFSIZE	0x100		/* RX ring size, power of 2 */
+#define UART_RX_EVT	0x4000		/* RTX event flag for received data */
+#define TXFIFOSIZE	16			/* UART hardware TX FIFO depth */
 
 #ifndef FALSE
 #define FALSE   (0)
@@ -57,7 +60,11 @@ void UART1_IRQHandler( void );
 
 uint32_t UARTInit( uint32_t portNum, uint32_t Baudrate );
 
-void     UARTSend(    uint32_t portNum, uint8_t *BufferPtr, uint32_t Length );
+uint32_t UARTSend(    uint32_t portNum, uint8_t *BufferPtr, uint32_t Length );
+uint32_t UARTSendAll( uint32_t portNum, uint8_t *BufferPtr, uint32_t Length );
+void     UARTFlush(   uint32_t portNum );
+void     UARTTxStats( uint32_t portNum, uint32_t *Dropped, uint32_t *Overruns );
+void     UARTRxStats( uint32_t portNum, uint32_t *Dropped, uint32_t *Overruns );
 uint32_t UARTRecieve( uint32_t portNum, uint8_t *BufferPtr, uint32_t Length );
 
 void     UARTSendChar(    uint32_t portNum, uint8_t character );
@@ -0,0 +1,136 @@
+// GPDMA bursts of the LCD driver (GLCD_SPI_LPC1700.c) under RTX
+//
+// Checks that fills around the DMA size limits end up in GRAM, and that a
+// task drawing with GLCD_DMAYield sleeps while the DMA runs so a lower
+// priority task gets the CPU, where polling starves it. A burst from another
+// task while GLCD_DMAYield is on must still complete, by polling.
+
+#include <stdio.h>
+#include <RTL.h>
+#include "LPC17xx.h"
+#include "GLCD.h"
+#include "sim.h"
+
+static int failed = 0;
+
+#define CHECK(c) do { if(!(c)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #c); failed++; } } while(0)
+
+static volatile uint32_t work = 0;
+static volatile int stop = 0;
+static volatile int burstDone = 0;
+
+typedef struct {
+	uint64_t ns;
+	uint32_t work;
+	uint32_t irqs;
+} CLEAR_COST;
+
+static int filled(unsigned int x, unsigned int y, unsigned int w, unsigned int h, uint16_t c) {
+	unsigned int i, j;
+
+	for(j=y; j<y+h; j++)
+		for(i=x; i<x+w; i++)
+			if(SIM_LcdPixel(i, j) != c)
+				return 0;
+	return 1;
+}
+
+static CLEAR_COST timedClear(uint16_t color) {
+	CLEAR_COST c;
+	uint64_t t = SIM_Now();
+	uint32_t n = work, irqs = SIM_IrqCount(DMA_IRQn);
+
+	GLCD_Clear(color);
+	c.ns = SIM_Now() - t;
+	c.work = work - n;
+	c.irqs = SIM_IrqCount(DMA_IRQn) - irqs;
+	CHECK(filled(0, 0, SIM_LCD_W, SIM_LCD_H, color));
+	return c;
+}
+
+// Runs whenever the drawing task does not need the CPU
+__task void workTask(void) {
+	while(!stop) {
+		work++;
+		os_tsk_pass();
+	}
+}
+
+// Draws while drawTask has GLCD_DMAYield on
+__task void burstTask(void) {
+	GLCD_Clear(Cyan);
+	burstDone = 1;
+	os_tsk_delete_self();
+}
+
+__task void drawTask(void) {
+	// Pixel counts around DMA_MIN and a DMA_CHUNK boundary, and a full row
+	static const unsigned int sizes[] = {1, 63, 64, 65, 255, 256, 257, 320};
+	CLEAR_COST poll, yield;
+	SIM_SSP_STATS ssp;
+	OS_TID burst;
+	unsigned int i;
+
+	os_tsk_prio_self(2);
+	GLCD_Init();
+	os_tsk_create(workTask, 1);
+
+	poll = timedClear(Red);
+
+	GLCD_DMAYield(1);
+	yield = timedClear(Green);
+
+	for(i=0; i<sizeof(sizes)/sizeof(sizes[0]); i++) {
+		GLCD_FillRect(0, 10+i, sizes[i], 1, Blue);
+		CHECK(filled(0, 10+i, sizes[i], 1, Blue));
+		CHECK(sizes[i] == SIM_LCD_W || SIM_LcdPixel(sizes[i], 10+i) == Green);
+	}
+	GLCD_FillRect(17, 100, 100, 50, Yellow);
+	CHECK(filled(17, 100, 100, 50, Yellow));
+	CHECK(SIM_LcdPixel(16, 100) == Green && SIM_LcdPixel(117, 149) == Green);
+
+	// The DMA interrupt signals drawTask, the burst task has to poll
+	burst = os_tsk_create(burstTask, 3);
+	for(i=0; !burstDone && i<100; i++)
+		os_dly_wait(1);
+	CHECK(burstDone);
+	if(!burstDone)
+		os_tsk_delete(burst);
+	else
+		CHECK(filled(0, 0, SIM_LCD_W, SIM_LCD_H, Cyan));
+	GLCD_DMAYield(0);
+
+	// Polling keeps the worker out, yielding hands it the wire time
+	CHECK(poll.work == 0);
+	CHECK(yield.work > 0);
+	CHECK(yield.irqs > 0);
+	CHECK(yield.ns < poll.ns + poll.ns/10);
+
+	SIM_SspStats(&ssp, 0);
+	CHECK(ssp.dmaBytes > 0);
+	CHECK(ssp.txOverflow == 0);
+	CHECK(SIM_LcdErrors() == 0);
+
+	printf("dma: clear polling %.2f ms, worker passes %u\n", poll.ns/1e6, poll.work);
+	printf("dma: clear yielding %.2f ms, worker passes %u, %u DMA interrupts\n",
+	       yield.ns/1e6, yield.work, yield.irqs);
+
+	stop = 1;
+	os_tsk_delete_self();
+}
+
+static void entry(void) {
+	os_sys_init(drawTask);
+}
+
+int main(void) {
+	int r = SIM_Run(entry, 10*SIM_S);
+
+	CHECK(r == 0);
+	if(failed) {
+		printf("%d check(s) failed\n", failed);
+		return 1;
+	}
+	printf("dma: all checks passed\n");
+	return 0;
+}
@@ -0,0 +1,157 @@
+// Game rules (game.c) on the host: timing, tank moves, game over, replay
+
+#include <stdio.h>
+#include "game.h"
+
+static int failed = 0;
+
+#define CHECK(c) do { if(!(c)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #c); failed++; } } while(0)
+
+#define MAX_STEPS  (100000)
+
+static uint8_t record[MAX_STEPS];
+static GameInput changes[MAX_STEPS];
+
+// Field by field, the struct has padding
+static int sameState(const GameState *a, const GameState *b) {
+	int i;
+
+	for(i=0; i<MINE_SETS; i++) {
+		if(a->mines[i] != b->mines[i])
+			return 0;
+	}
+	return a->step == b->step && a->gameOver == b->gameOver && a->score == b->score &&
+	       a->dir == b->dir && a->moving == b->moving && a->x == b->x && a->y == b->y &&
+	       a->setsPrimed == b->setsPrimed && a->setsExp == b->setsExp &&
+	       a->mineSet == b->mineSet && a->minePhase == b->minePhase &&
+	       a->mineCycle == b->mineCycle && a->mineLeft == b->mineLeft &&
+	       a->scoreLeft == b->scoreLeft;
+}
+
+static uint8_t idleAgent(const GameState *g, void *ctx) {
+	return 0;
+}
+
+// Random steering, recording every input for the replay check
+static uint8_t randomAgent(const GameState *g, void *ctx) {
+	uint32_t *seed = ctx;
+	uint8_t in;
+
+	*seed = *seed*1103515245 + 12345;
+	in = (*seed >> 16) % 5;
+	if(!((*seed >> 24) & 3))
+		in |= GAME_IN_PRESS;
+	record[g->step] = in;
+	return in;
+}
+
+static void testInit(void) {
+	GameState g;
+
+	Game_Init(&g);
+	CHECK(g.step == 0);
+	CHECK(g.score == 0);
+	CHECK(!g.gameOver);
+	CHECK(!g.moving);
+	CHECK(g.mines[0] == PRIMED);
+	CHECK(g.mineCycle == GAME_MINE_CYCLE);
+}
+
+static void testScore(void) {
+	GameState g;
+	uint32_t i;
+
+	Game_Init(&g);
+	CHECK(Game_Step(&g, 0) & GAME_CHG_SCORE);
+	CHECK(g.score == 10);
+	CHECK(g.mineCycle == GAME_MINE_CYCLE*GAME_SPEEDUP_NUM/GAME_SPEEDUP_DEN);
+	for(i=1; i<GAME_SCORE_STEPS && !g.gameOver; i++)
+		Game_Step(&g, 0);
+	CHECK(g.score == 10);
+	Game_Step(&g, 0);
+	CHECK(g.gameOver || g.score == 20);
+}
+
+static void testTank(void) {
+	GameState g;
+
+	Game_Init(&g);
+	Game_Step(&g, GAME_IN_UP | GAME_IN_PRESS);
+	CHECK(g.moving);
+	CHECK(g.dir == UP);
+	CHECK(g.x == 0);
+	Game_Step(&g, 0);
+	CHECK(g.x == 1 || !g.moving);
+	Game_Step(&g, GAME_IN_STOP);
+	CHECK(!g.moving);
+
+	// Right from the bottom row runs into the edge
+	Game_Init(&g);
+	Game_Step(&g, GAME_IN_RIGHT | GAME_IN_PRESS);
+	Game_Step(&g, 0);
+	CHECK(!g.moving);
+	CHECK(g.y == 14);
+}
+
+static void testGameOver(void) {
+	GameState g, end;
+	uint32_t n;
+
+	n = Game_Run(&g, idleAgent, 0, MAX_STEPS);
+	CHECK(g.gameOver);
+	CHECK(n < MAX_STEPS);
+	CHECK(Game_CellState(&g, g.x, g.y) == EXP);
+
+	end = g;
+	CHECK(Game_Step(&g, GAME_IN_PRESS) == 0);
+	CHECK(sameState(&g, &end));
+}
+
+static void testReplay(void) {
+	GameState run, replay;
+	uint32_t seed, n, m, i;
+
+	for(seed=1; seed<=20; seed++) {
+		i = seed;
+		n = Game_Run(&run, randomAgent, &i, MAX_STEPS);
+		m = Game_Replay(&replay, record, n);
+		CHECK(m == n);
+		CHECK(sameState(&run, &replay));
+	}
+}
+
+// Only the steps the input changed on, as game_task records them
+static void testReplayInputs(void) {
+	GameState run, replay;
+	uint32_t seed, n, m, i, k;
+
+	for(seed=1; seed<=20; seed++) {
+		i = seed;
+		n = Game_Run(&run, randomAgent, &i, MAX_STEPS);
+		for(k=0, i=0; i<n; i++) {
+			if(i == 0 || record[i] != record[i-1]) {
+				changes[k].step = i;
+				changes[k++].input = record[i];
+			}
+		}
+		m = Game_ReplayInputs(&replay, changes, k, MAX_STEPS);
+		CHECK(m == n);
+		CHECK(sameState(&run, &replay));
+	}
+}
+
+int main(void) {
+	testInit();
+	testScore();
+	testTank();
+	testGameOver();
+	testReplay();
+	testReplayInputs();
+
+	if(failed) {
+		printf("%d check(s) failed\n", failed);
+		return 1;
+	}
+	printf("game: all checks passed\n");
+	return 0;
+}
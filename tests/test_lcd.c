@@ -0,0 +1,159 @@
+// LCD driver (GLCD_SPI_LPC1700.c) against the SSP1/GPDMA and HX8347-D models
+//
+// Checks that every transaction is well formed, that the drawing calls end
+// up in GRAM where they should, and that drawing through the frame buffer
+// gives the same screen as drawing straight to the LCD, also when more
+// colors are drawn than the buffer palette holds: first with the old colors
+// painted over, so entries can be freed and the buffer stays on, then with
+// more colors on screen at once, where it has to fall back to the LCD.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "GLCD.h"
+#include "sim.h"
+
+static int failed = 0;
+
+#define CHECK(c) do { if(!(c)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #c); failed++; } } while(0)
+
+static uint16_t direct[SIM_LCD_H][SIM_LCD_W];
+
+static const unsigned short sprite[16] = {
+	0x0000, 0x0FF0, 0x1008, 0x2004, 0x4002, 0x4002, 0x4002, 0x4002,
+	0x4002, 0x4002, 0x4002, 0x4002, 0x2004, 0x1008, 0x0FF0, 0x0000
+};
+
+static unsigned short tile[GLCD_TILE*GLCD_TILE];
+
+// The same drawing, once straight to the LCD and once buffered
+static void scene(void) {
+	GLCD_SetBackColor(Blue);
+	GLCD_SetTextColor(White);
+	GLCD_FillRect(10, 20, 30, 40, Red);
+	GLCD_FillRect(300, 230, 40, 40, Green);
+	GLCD_PutPixel(100, 100);
+	GLCD_DrawSprite(120, 60, 16, 16, sprite, 1);
+	GLCD_DrawSprite(140, 60, 16, 16, sprite, 0);
+	GLCD_BlitTile(160, 96, tile);
+	GLCD_FillRect(0, 200, 320, 8, Yellow);
+}
+
+// Twelve colors in one place, then nine side by side
+static void paint(int phase) {
+	unsigned int i;
+
+	for(i=0; i<(phase ? 9 : 12); i++) {
+		if(phase)
+			GLCD_FillRect(20 + i*30, 150, 20, 20, 0x1082*(i + 3));
+		else
+			GLCD_FillRect(20, 150, 20, 20, 0x1082*(i + 3));
+	}
+}
+
+static void snapshot(uint16_t img[SIM_LCD_H][SIM_LCD_W]) {
+	unsigned int x, y;
+
+	for(y=0; y<SIM_LCD_H; y++)
+		for(x=0; x<SIM_LCD_W; x++)
+			img[y][x] = SIM_LcdPixel(x, y);
+}
+
+static unsigned int differences(uint16_t img[SIM_LCD_H][SIM_LCD_W]) {
+	unsigned int x, y, n = 0;
+
+	for(y=0; y<SIM_LCD_H; y++)
+		for(x=0; x<SIM_LCD_W; x++)
+			n += img[y][x] != SIM_LcdPixel(x, y);
+	return n;
+}
+
+static void body(void) {
+	SIM_SSP_STATS ssp;
+	SIM_LCD_STATS lcd;
+	unsigned int i, x, y, white;
+
+	for(i=0; i<GLCD_TILE*GLCD_TILE; i++)
+		tile[i] = (i & 1) ? Magenta : ((i/GLCD_TILE) & 1) ? Cyan : Black;
+
+	GLCD_Init();
+	SIM_LcdStats(&lcd, 0);
+	CHECK(lcd.regWrites > 0);
+
+	// Clear goes by DMA
+	SIM_SspStats(0, 1);
+	GLCD_Clear(Blue);
+	SIM_SspStats(&ssp, 0);
+	CHECK(ssp.dmaBytes > 0);
+	CHECK(SIM_LcdPixel(0, 0) == Blue);
+	CHECK(SIM_LcdPixel(319, 239) == Blue);
+	CHECK(SIM_LcdPixel(160, 120) == Blue);
+
+	scene();
+	CHECK(SIM_LcdPixel(10, 20) == Red);
+	CHECK(SIM_LcdPixel(39, 59) == Red);
+	CHECK(SIM_LcdPixel(40, 59) == Blue);
+	CHECK(SIM_LcdPixel(9, 20) == Blue);
+	CHECK(SIM_LcdPixel(319, 239) == Green);
+	CHECK(SIM_LcdPixel(100, 100) == White);
+	CHECK(SIM_LcdPixel(161, 96) == Magenta);
+	CHECK(SIM_LcdPixel(0, 200) == Yellow);
+
+	GLCD_DisplayString(0, 0, 1, (unsigned char *)"MINEFIELD");
+	for(white=0, y=0; y<24; y++)
+		for(x=0; x<16; x++)
+			white += SIM_LcdPixel(x, y) == White;
+	CHECK(white > 0);
+	snapshot(direct);
+
+	// Buffered drawing only reaches the LCD on flush
+	GLCD_Clear(Blue);
+	GLCD_FB_Enable(1);
+	scene();
+	CHECK(SIM_LcdPixel(10, 20) == Blue);
+	GLCD_FB_Flush();
+	GLCD_FB_Enable(0);
+	GLCD_DisplayString(0, 0, 1, (unsigned char *)"MINEFIELD");
+	CHECK(differences(direct) == 0);
+
+	// Palette overflow
+	GLCD_Clear(Blue);
+	paint(0);
+	paint(1);
+	GLCD_FillRect(0, 0, 8, 8, Red);
+	snapshot(direct);
+
+	GLCD_Clear(Blue);
+	GLCD_FB_Enable(1);
+	paint(0);
+	GLCD_FillRect(0, 0, 8, 8, Red);
+	CHECK(SIM_LcdPixel(0, 0) == Blue);
+	CHECK(SIM_LcdPixel(20, 150) != 0x1082*14);
+	paint(1);
+	GLCD_FillRect(0, 0, 8, 8, Red);
+	CHECK(SIM_LcdPixel(0, 0) == Red);
+	GLCD_FB_Flush();
+	GLCD_FB_Enable(0);
+	CHECK(differences(direct) == 0);
+
+	SIM_SspStats(&ssp, 0);
+	SIM_LcdStats(&lcd, 0);
+	CHECK(ssp.txOverflow == 0);
+	CHECK(lcd.badStart == 0);
+	CHECK(lcd.outsideCs == 0);
+	CHECK(lcd.partial == 0);
+
+	if(getenv("LCD_DUMP"))
+		SIM_LcdDump(getenv("LCD_DUMP"));
+}
+
+int main(void) {
+	int r = SIM_Run(body, 10*SIM_S);
+
+	CHECK(r == 0);
+	if(failed) {
+		printf("%d check(s) failed\n", failed);
+		return 1;
+	}
+	printf("lcd: all checks passed\n");
+	return 0;
+}
@@ -0,0 +1,119 @@
+// Replay of a game recorded on the simulated board (user-021)
+//
+// Plays the firmware (main.c) with the joystick changing every few steps,
+// while the link (-Wl,--wrap=UARTSendAll) turns away every third record
+// as if the UART ring were full. Checks that no TLM_INPUT record is lost
+// for good: the sequence numbers have no gap, and Game_ReplayInputs on
+// the records rebuilds exactly the final game state of the board.
+
+#include <stdio.h>
+#include <RTL.h>
+#include "game.h"
+#include "hal.h"
+#include "telemetry.h"
+#include "uart.h"
+#include "sim.h"
+
+#define MAX_INPUTS (4096)
+#define MOVES      (60)
+
+int MinefieldMain(void);
+uint32_t __real_UARTSendAll(uint32_t portNum, uint8_t *BufferPtr, uint32_t Length);
+extern GameState gameState;
+
+static int failed = 0;
+
+#define CHECK(c) do { if(!(c)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #c); failed++; } } while(0)
+
+static GameInput inputs[MAX_INPUTS];
+static uint32_t calls = 0, refused = 0, inputRefused = 0;
+
+uint32_t __wrap_UARTSendAll(uint32_t portNum, uint8_t *BufferPtr, uint32_t Length) {
+	if(++calls % 3 == 0) {
+		refused++;
+		if(Length > 1 && BufferPtr[1] == TLM_INPUT)
+			inputRefused++;
+		return 0;
+	}
+	return __real_UARTSendAll(portNum, BufferPtr, Length);
+}
+
+// Field by field, the struct has padding
+static int sameState(const GameState *a, const GameState *b) {
+	int i;
+
+	for(i=0; i<MINE_SETS; i++) {
+		if(a->mines[i] != b->mines[i])
+			return 0;
+	}
+	return a->step == b->step && a->gameOver == b->gameOver && a->score == b->score &&
+	       a->dir == b->dir && a->moving == b->moving && a->x == b->x && a->y == b->y &&
+	       a->setsPrimed == b->setsPrimed && a->setsExp == b->setsExp &&
+	       a->mineSet == b->mineSet && a->minePhase == b->minePhase &&
+	       a->mineCycle == b->mineCycle && a->mineLeft == b->mineLeft &&
+	       a->scoreLeft == b->scoreLeft;
+}
+
+// TLM_INPUT records of UART0 into inputs[], returns their number, -1 on a
+// broken record or a gap in the sequence
+static int decode(const uint8_t *d, uint32_t n) {
+	uint32_t i = 0;
+	int k = 0;
+
+	while(i < n) {
+		if(d[i] != TLM_SYNC || i + 4 > n || i + 4 + d[i+2] > n)
+			return -1;
+		if(d[i+1] == TLM_INPUT && d[i+2] == 7) {
+			if(k >= MAX_INPUTS || (d[i+3] | d[i+4] << 8) != k)
+				return -1;
+			inputs[k].step = d[i+5] | d[i+6] << 8 | d[i+7] << 16 | (uint32_t)d[i+8] << 24;
+			inputs[k++].input = d[i+9];
+		}
+		i += 4 + d[i+2];
+	}
+	return k;
+}
+
+static void entry(void) {
+	MinefieldMain();
+}
+
+int main(void) {
+	static const uint32_t dirs[] = {HAL_JOY_P24, HAL_JOY_P25, HAL_JOY_P23, HAL_JOY_P26};
+	GameState replay;
+	const uint8_t *out;
+	uint32_t len, t, steps, seed = 7;
+	int i, n, r;
+
+	// Leave the start screen, then push a new direction every 250 to 550 ms
+	SIM_JoyAt(200*SIM_MS, HAL_JOY_PRESS);
+	SIM_JoyAt(300*SIM_MS, 0);
+	for(t=1000, i=0; i<MOVES; i++) {
+		seed = seed*1103515245 + 12345;
+		SIM_JoyAt(t*SIM_MS, dirs[(seed >> 16) & 3] | ((seed >> 20) & 1 ? HAL_JOY_PRESS : 0));
+		SIM_JoyAt((t + 100)*SIM_MS, 0);
+		t += 250 + (seed >> 8) % 300;
+	}
+
+	r = SIM_Run(entry, 300*SIM_S);
+	CHECK(r == 0 || r == -1);
+
+	out = SIM_UartOutput(0, &len);
+	n = decode(out, len);
+	CHECK(n > 1);
+	CHECK(inputRefused > 0);
+	steps = Game_ReplayInputs(&replay, inputs, n > 0 ? n : 0, gameState.step);
+	CHECK(steps == gameState.step);
+	CHECK(sameState(&replay, &gameState));
+
+	printf("replay: %s after %u steps, score %u\n", gameState.gameOver ? "game over" : "still running",
+	       gameState.step, gameState.score);
+	printf("replay: %d input records, %u of %u records turned away (%u input, sent again), %u dropped\n",
+	       n, refused, calls, inputRefused, TLM_Dropped());
+	if(failed) {
+		printf("%d check(s) failed\n", failed);
+		return 1;
+	}
+	printf("replay: all checks passed\n");
+	return 0;
+}
@@ -0,0 +1,157 @@
+// Whole firmware (main.c) on the simulated board
+//
+// Plays a scripted game from the start screen to the end screen and checks
+// that the LCD traffic is well formed, that every telemetry record on UART0
+// is intact, that the TLM_INPUT records replay to the game the board
+// played, and that the TLM_IDLE records add up to the time the kernel was
+// idle.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "game.h"
+#include "hal.h"
+#include "telemetry.h"
+#include "GLCD.h"
+#include "sim.h"
+
+static int failed = 0;
+
+#define CHECK(c) do { if(!(c)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #c); failed++; } } while(0)
+
+#define MAX_STEPS  (100000)
+#define MAX_INPUTS (4096)
+
+int MinefieldMain(void);
+extern GameState gameState;
+
+static GameInput inputs[MAX_INPUTS];
+
+static void entry(void) {
+	MinefieldMain();
+}
+
+static uint8_t crc8(uint8_t crc, uint8_t data) {
+	uint8_t i;
+
+	crc ^= data;
+	for(i=0; i<8; i++)
+		crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+	return crc;
+}
+
+static uint32_t get32(const uint8_t *p) {
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// Walks the records on UART0, fills inputs[] from the TLM_INPUT records,
+// adds up the TLM_IDLE sleep times and returns the number of records, -1 on
+// a broken one or a missing TLM_INPUT record
+static int decode(const uint8_t *d, uint32_t n, uint32_t *frames, uint32_t *nInputs, uint64_t *sleepUs) {
+	uint32_t i = 0, j;
+	uint8_t crc, len;
+	int records = 0;
+
+	*frames = 0;
+	*nInputs = 0;
+	*sleepUs = 0;
+	while(i < n) {
+		if(d[i] != TLM_SYNC || i + 4 > n || i + 4 + d[i+2] > n)
+			return -1;
+		len = d[i+2];
+		crc = crc8(crc8(0, d[i+1]), len);
+		for(j=0; j<len; j++)
+			crc = crc8(crc, d[i+3+j]);
+		if(crc != d[i+3+len])
+			return -1;
+
+		if(d[i+1] == TLM_FRAME)
+			(*frames)++;
+		if(d[i+1] == TLM_IDLE && len == 8)
+			*sleepUs += get32(&d[i+7]);
+		if(d[i+1] == TLM_INPUT && len == 7) {
+			if(*nInputs >= MAX_INPUTS || (d[i+3] | d[i+4] << 8) != *nInputs)
+				return -1;
+			inputs[*nInputs].step = get32(&d[i+5]);
+			inputs[(*nInputs)++].input = d[i+9];
+		}
+		records++;
+		i += 4 + len;
+	}
+	return records;
+}
+
+int main(void) {
+	SIM_SSP_STATS ssp;
+	SIM_LCD_STATS lcd;
+	SIM_RTX_STATS rtx;
+	SIM_UART_STATS uart;
+	GameState replay;
+	const uint8_t *out;
+	uint32_t len, frames, nInputs, dark, x, y;
+	uint64_t sleepUs, idleUs;
+	int r, records;
+
+	// Start on a joystick push, drive up, stop with the button, turn right
+	// and go again
+	SIM_JoyAt(200*SIM_MS, HAL_JOY_PRESS);
+	SIM_JoyAt(300*SIM_MS, 0);
+	SIM_JoyAt(1000*SIM_MS, HAL_JOY_P24 | HAL_JOY_PRESS);
+	SIM_JoyAt(1100*SIM_MS, 0);
+	SIM_ButtonAt(1800*SIM_MS);
+	SIM_JoyAt(2500*SIM_MS, HAL_JOY_P25);
+	SIM_JoyAt(2600*SIM_MS, HAL_JOY_P25 | HAL_JOY_PRESS);
+	SIM_JoyAt(2700*SIM_MS, 0);
+
+	r = SIM_Run(entry, 300*SIM_S);
+	CHECK(r == 0);
+	CHECK(gameState.gameOver);
+
+	SIM_SspStats(&ssp, 0);
+	SIM_LcdStats(&lcd, 0);
+	SIM_RtxStats(&rtx);
+	SIM_UartStats(0, &uart);
+	CHECK(ssp.txOverflow == 0);
+	CHECK(ssp.dmaBytes > 0);
+	CHECK(SIM_LcdErrors() == 0);
+	CHECK(uart.txOverflow == 0);
+
+	// End screen: black text on white
+	CHECK(SIM_LcdPixel(0, 0) == White);
+	for(dark=0, y=0; y<SIM_LCD_H; y++)
+		for(x=0; x<SIM_LCD_W; x++)
+			dark += SIM_LcdPixel(x, y) == Black;
+	CHECK(dark > 100);
+
+	out = SIM_UartOutput(0, &len);
+	records = decode(out, len, &frames, &nInputs, &sleepUs);
+	CHECK(records > 0);
+	CHECK(frames > 0);
+
+	// Asleep as reported, plus since the last report, against the idle
+	// demon. The first report also holds the start screen, which waits for
+	// the joystick push at 200 ms before the kernel runs.
+	sleepUs += HAL_SleepUs(0);
+	idleUs = rtx.idleNs/1000;
+	CHECK(sleepUs >= idleUs && sleepUs <= idleUs + 200000);
+	CHECK(Game_ReplayInputs(&replay, inputs, nInputs, MAX_STEPS) == gameState.step);
+	CHECK(replay.score == gameState.score);
+	CHECK(replay.x == gameState.x && replay.y == gameState.y);
+	CHECK(TLM_Dropped() == 0);
+
+	printf("sim_game: %.2f s simulated, %u steps, score %u, %d records, %u frames\n",
+	       SIM_Now()/1e9, gameState.step, gameState.score, records, frames);
+	printf("sim_game: %llu SSP bytes (%llu by DMA), %llu task switches, %.1f%% idle\n",
+	       (unsigned long long)ssp.bytes, (unsigned long long)ssp.dmaBytes,
+	       (unsigned long long)rtx.switches, 100.0*rtx.idleNs/SIM_Now());
+	printf("sim_game: %.3f s asleep by TLM_IDLE, %.3f s idle in the kernel\n",
+	       sleepUs/1e6, idleUs/1e6);
+
+	if(getenv("LCD_DUMP"))
+		SIM_LcdDump(getenv("LCD_DUMP"));
+	if(failed) {
+		printf("%d check(s) failed\n", failed);
+		return 1;
+	}
+	printf("sim_game: all checks passed\n");
+	return 0;
+}
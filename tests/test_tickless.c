@@ -0,0 +1,141 @@
+// Tickless idle of the RTX idle demon (RTX_config.c OS_TICKLESS, user-019)
+//
+// Runs a task on os_itv_wait every 100 ms, one on os_dly_wait and one
+// woken from the push button interrupt at odd times, with the joystick
+// sampled every 5 ms as in the firmware. Checks that the kernel time still
+// follows the simulated clock tick for tick, that the periodic and the
+// delayed task wake on their tick, that the button wakes its task at once,
+// and that while idle the tick interrupt is off: far fewer SysTick
+// interrupts than ticks, and most of the time spent in HAL_Sleep.
+
+#include <stdio.h>
+#include <RTL.h>
+#include "LPC17xx.h"
+#include "hal.h"
+#include "sim.h"
+
+#define TICK_NS    (10*SIM_MS)
+#define PERIOD     (10)        // ticks
+#define PERIODS    (30)
+#define DELAY      (37)        // ticks
+#define PRESSES    (5)
+
+static int failed = 0;
+
+#define CHECK(c) do { if(!(c)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #c); failed++; } } while(0)
+
+static uint64_t start;         // time of tick 0
+static OS_TID buttonTid;
+static volatile int done = 0;
+static uint32_t lateItv = 0, wrongTime = 0, lateButton = 0, presses = 0;
+static uint64_t pressAt[PRESSES];
+
+void EINT3_IRQHandler(void) {
+	HAL_ButtonIntClear();
+	isr_evt_set(0x0001, buttonTid);
+}
+
+// Kernel time against the simulated clock
+static void checkTime(void) {
+	if(os_time_get() != (SIM_Now() - start)/TICK_NS)
+		wrongTime++;
+}
+
+__task void itvTask(void) {
+	uint64_t due;
+	U32 time0 = os_time_get();
+	int i;
+
+	os_itv_set(PERIOD);
+	for(i=1; i<=PERIODS; i++) {
+		os_itv_wait();
+		checkTime();
+		due = start + (time0 + i*PERIOD)*TICK_NS;
+		if(SIM_Now() < due || SIM_Now() - due > 100000)
+			lateItv++;
+	}
+	done = 1;
+	os_tsk_delete_self();
+}
+
+__task void buttonTask(void) {
+	while(1) {
+		os_evt_wait_or(0x0001, 0xFFFF);
+		checkTime();
+		if(presses < PRESSES && SIM_Now() - pressAt[presses] > 100000)
+			lateButton++;
+		presses++;
+	}
+}
+
+__task void mainTask(void) {
+	SIM_RTX_STATS s0, s1;
+	uint32_t ticks, irqs, sleepUs;
+	uint64_t t0, ns;
+	U32 time0;
+
+	os_tsk_prio_self(3);
+	HAL_JoystickInit();
+	HAL_ButtonInit();
+	buttonTid = os_tsk_create(buttonTask, 2);
+	os_tsk_create(itvTask, 1);
+	os_dly_wait(1);
+
+	SIM_RtxStats(&s0);
+	irqs = SIM_IrqCount(SysTick_IRQn);
+	HAL_SleepUs(1);
+	t0 = SIM_Now();
+	time0 = os_time_get();
+
+	os_dly_wait(DELAY);
+	checkTime();
+	CHECK(os_time_get() - time0 == DELAY);
+	CHECK(SIM_Now() - (start + (time0 + DELAY)*TICK_NS) < 100000);
+
+	while(!done)
+		os_dly_wait(PERIOD);
+	checkTime();
+	ns = SIM_Now() - t0;
+	sleepUs = HAL_SleepUs(0);
+	SIM_RtxStats(&s1);
+	ticks = os_time_get() - time0;
+	irqs = SIM_IrqCount(SysTick_IRQn) - irqs;
+
+	CHECK(wrongTime == 0);
+	CHECK(lateItv == 0);
+	CHECK(presses == PRESSES && lateButton == 0);
+	CHECK(ticks == ns/TICK_NS || ticks == ns/TICK_NS + 1);
+	CHECK(s1.ticks - s0.ticks == irqs);
+	CHECK(irqs < ticks/4);
+	CHECK(sleepUs > ns/1000*9/10);
+
+	printf("tickless: %u ticks in %.2f s, %u tick interrupts, %.1f%% asleep\n",
+	       ticks, ns/1e9, irqs, sleepUs/(ns/1e5));
+	printf("tickless: %d interval waits, a %d tick delay, %d button presses on time\n",
+	       PERIODS, DELAY, presses);
+	SIM_Exit(0);
+}
+
+static void entry(void) {
+	start = SIM_Now();
+	os_sys_init(mainTask);
+}
+
+int main(void) {
+	int r, i;
+
+	// Between ticks and some right on a tick
+	for(i=0; i<PRESSES; i++) {
+		pressAt[i] = (700 + i*431)*SIM_MS + i*3*SIM_MS + (i == 2 ? 0 : 1234000);
+		SIM_ButtonAt(pressAt[i]);
+	}
+	r = SIM_Run(entry, 10*SIM_S);
+
+	CHECK(r == 0);
+	if(failed) {
+		printf("%d check(s) failed\n", failed);
+		return 1;
+	}
+	printf("tickless: all checks passed\n");
+	return 0;
+}
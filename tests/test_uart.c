@@ -0,0 +1,121 @@
+// UART driver (uart.c) against the UART0 model under RTX
+//
+// Checks that UARTSend queues into the TX ring and returns without waiting
+// for the wire, that the THRE interrupt drains the ring while other tasks
+// run, that UARTFlush returns once the last byte is out, and that what does
+// not fit into the ring is dropped and counted, by UARTSendAll as a whole.
+
+#include <stdio.h>
+#include <string.h>
+#include <RTL.h>
+#include "LPC17xx.h"
+#include "uart.h"
+#include "sim.h"
+
+#define BAUD       (115200)
+#define BLOCK      (200)
+#define OVERSIZE   (TXBUFSIZE + 100)
+
+static int failed = 0;
+
+#define CHECK(c) do { if(!(c)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #c); failed++; } } while(0)
+
+static volatile uint32_t work = 0;
+static volatile int stop = 0;
+
+static uint8_t data[BLOCK + OVERSIZE];
+
+// Runs whenever the sending task does not need the CPU
+__task void workTask(void) {
+	while(!stop) {
+		work++;
+		os_tsk_pass();
+	}
+}
+
+__task void sendTask(void) {
+	uint64_t t, byteNs, sendNs, flushNs;
+	uint32_t n, len, dropped, overruns, passes, irqs;
+	const uint8_t *out;
+	unsigned int i;
+
+	os_tsk_prio_self(2);
+	for(i=0; i<sizeof(data); i++)
+		data[i] = i*7 + (i >> 8);
+	UARTInit(0, BAUD);
+	byteNs = SIM_UartByteNs(0);
+	os_tsk_create(workTask, 1);
+
+	// Queued, then drained by the interrupt while the worker runs
+	irqs = SIM_IrqCount(UART0_IRQn);
+	t = SIM_Now();
+	n = UARTSend(0, data, BLOCK);
+	sendNs = SIM_Now() - t;
+	CHECK(n == BLOCK);
+	CHECK(sendNs < byteNs);
+	passes = work;
+	os_dly_wait((BLOCK*byteNs)/(10*SIM_MS) + 2);
+	passes = work - passes;
+	CHECK(passes > 0);
+	SIM_UartOutput(0, &len);
+	CHECK(len == BLOCK);
+	irqs = SIM_IrqCount(UART0_IRQn) - irqs;
+	CHECK(irqs >= BLOCK/TXFIFOSIZE - 1 && irqs <= BLOCK/TXFIFOSIZE + 2);
+
+	// More than the ring holds: the rest is dropped, the flush waits for
+	// what was queued
+	t = SIM_Now();
+	n = UARTSend(0, data + BLOCK, OVERSIZE);
+	CHECK(n == TXBUFSIZE);
+	UARTFlush(0);
+	flushNs = SIM_Now() - t;
+	CHECK(flushNs >= TXBUFSIZE*byteNs);
+	CHECK(flushNs < (TXBUFSIZE + 2)*byteNs);
+	UARTTxStats(0, &dropped, &overruns);
+	CHECK(dropped == OVERSIZE - TXBUFSIZE);
+	CHECK(overruns == 1);
+
+	out = SIM_UartOutput(0, &len);
+	CHECK(len == BLOCK + TXBUFSIZE);
+	CHECK(len == BLOCK + TXBUFSIZE && memcmp(out, data, len) == 0);
+
+	// Whole blocks: the first fill of the FIFO leaves TXFIFOSIZE + 10 free
+	n = UARTSend(0, data, TXBUFSIZE - 10);
+	CHECK(n == TXBUFSIZE - 10);
+	CHECK(UARTSendAll(0, data, TXFIFOSIZE + 11) == 0);
+	CHECK(UARTSendAll(0, data, TXFIFOSIZE + 10) == TXFIFOSIZE + 10);
+	UARTFlush(0);
+	UARTTxStats(0, &dropped, &overruns);
+	CHECK(dropped == OVERSIZE - TXBUFSIZE + TXFIFOSIZE + 11);
+	CHECK(overruns == 2);
+	SIM_UartOutput(0, &len);
+	CHECK(len == BLOCK + 2*TXBUFSIZE + TXFIFOSIZE);
+
+	printf("uart: %d bytes queued in %.1f us, %.1f us per byte on the wire\n",
+	       BLOCK, sendNs/1e3, byteNs/1e3);
+	printf("uart: %u worker passes and %u THRE interrupts while they went out\n", passes, irqs);
+	printf("uart: %d bytes sent, %u dropped, flush took %.2f ms\n",
+	       OVERSIZE, OVERSIZE - TXBUFSIZE, flushNs/1e6);
+
+	stop = 1;
+	os_tsk_delete_self();
+}
+
+static void entry(void) {
+	os_sys_init(sendTask);
+}
+
+int main(void) {
+	int r = SIM_Run(entry, 10*SIM_S);
+	SIM_UART_STATS st;
+
+	CHECK(r == 0);
+	SIM_UartStats(0, &st);
+	CHECK(st.txOverflow == 0);
+	if(failed) {
+		printf("%d check(s) failed\n", failed);
+		return 1;
+	}
+	printf("uart: all checks passed\n");
+	return 0;
+}
@@ -0,0 +1,214 @@
+// UART receive rings (uart.c) under load
+//
+// Streams data into UART0 and UART1 at once at the highest baud rate
+// UARTInit can set with the reset clocking (PCLK = CCLK/4, divisor 1) and
+// checks that two tasks reading with UARTRecieve get every byte in order
+// while sleeping in between, so a lower priority task still runs. Then
+// has two tasks of different priorities read one port at once: the one
+// that comes second must sleep until the first is done, not spin on the
+// port while the first waits for data, and between them they must get
+// every byte. Then checks the loss accounting: bytes that find the ring
+// full are counted as dropped, and a hardware FIFO overrun while the
+// interrupt is held off is counted once.
+
+#include <stdio.h>
+#include <string.h>
+#include <RTL.h>
+#include "LPC17xx.h"
+#include "uart.h"
+#include "sim.h"
+
+#define BAUD       (SystemCoreClock/4/16)
+#define STREAM     (8192)
+#define BURST      (RXBUFSIZE + 144)
+#define FLOOD      (40)
+
+static int failed = 0;
+
+#define CHECK(c) do { if(!(c)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #c); failed++; } } while(0)
+
+static volatile uint32_t work = 0;
+static volatile int stop = 0;
+
+typedef struct {
+	uint8_t sent[STREAM];
+	uint8_t got[STREAM];
+	uint32_t calls;
+	volatile int done;
+} STREAM_RX;
+
+static STREAM_RX rx[2];
+
+// Two readers sharing port 1
+typedef struct {
+	uint32_t bytes;
+	uint32_t sum;
+	uint32_t calls;
+} SHARED_RX;
+
+static SHARED_RX shared[2];
+static volatile uint32_t sharedBytes = 0;
+static uint8_t burst[BURST];
+
+// Runs whenever the readers do not need the CPU
+__task void workTask(void) {
+	while(!stop) {
+		work++;
+		os_tsk_pass();
+	}
+}
+
+static void reader(int port) {
+	STREAM_RX *s = &rx[port];
+	uint32_t n = 0;
+
+	while(n < STREAM) {
+		n += UARTRecieve(port, s->got + n, STREAM - n);
+		s->calls++;
+	}
+	s->done = 1;
+}
+
+__task void read0Task(void) {
+	reader(0);
+	os_tsk_delete_self();
+}
+
+__task void read1Task(void) {
+	reader(1);
+	os_tsk_delete_self();
+}
+
+static void sharedReader(SHARED_RX *s) {
+	uint8_t buf[16];
+	uint32_t n, i;
+
+	while(sharedBytes < STREAM) {
+		n = UARTRecieve(1, buf, sizeof(buf));
+		for(i=0; i<n; i++)
+			s->sum += buf[i];
+		s->bytes += n;
+		s->calls++;
+		sharedBytes += n;
+	}
+}
+
+__task void lowReadTask(void) {
+	sharedReader(&shared[0]);
+	os_tsk_delete_self();
+}
+
+__task void highReadTask(void) {
+	sharedReader(&shared[1]);
+	os_tsk_delete_self();
+}
+
+// Waits for n bytes on the wire of the port
+static void waitBytes(int port, uint32_t n) {
+	os_dly_wait((n*SIM_UartByteNs(port))/(10*SIM_MS) + 2);
+}
+
+__task void mainTask(void) {
+	uint32_t dropped, overruns, n, passes;
+	uint8_t buf[RXBUFSIZE];
+	SIM_UART_STATS st;
+	uint64_t t, ns;
+	uint32_t sum;
+	OS_TID low, high;
+	unsigned int i, p;
+
+	os_tsk_prio_self(3);
+	for(p=0; p<2; p++) {
+		CHECK(UARTInit(p, BAUD));
+		for(i=0; i<STREAM; i++)
+			rx[p].sent[i] = i*(p ? 13 : 7) + (i >> 8);
+	}
+	for(i=0; i<BURST; i++)
+		burst[i] = ~i;
+
+	// Both ports back to back, the readers sleep between interrupts
+	os_tsk_create(workTask, 1);
+	os_tsk_create(read0Task, 2);
+	os_tsk_create(read1Task, 2);
+	t = SIM_Now();
+	passes = work;
+	SIM_UartFeed(0, rx[0].sent, STREAM, t);
+	SIM_UartFeed(1, rx[1].sent, STREAM, t);
+	while(!rx[0].done || !rx[1].done)
+		os_dly_wait(1);
+	ns = SIM_Now() - t;
+	passes = work - passes;
+	stop = 1;
+
+	for(p=0; p<2; p++) {
+		CHECK(memcmp(rx[p].got, rx[p].sent, STREAM) == 0);
+		UARTRxStats(p, &dropped, &overruns);
+		CHECK(dropped == 0 && overruns == 0);
+		SIM_UartStats(p, &st);
+		CHECK(st.rxBytes == STREAM && st.rxOverrun == 0);
+	}
+	CHECK(passes > 0);
+	printf("uart rx: %d bytes on each port at %u baud in %.2f ms\n", STREAM, BAUD, ns/1e6);
+	printf("uart rx: %u and %u UARTRecieve calls, %u worker passes meanwhile\n",
+	       rx[0].calls, rx[1].calls, passes);
+
+	// Two readers on one port, the low priority one waiting for data first
+	low = os_tsk_create(lowReadTask, 2);
+	os_dly_wait(2);
+	high = os_tsk_create(highReadTask, 4);
+	t = SIM_Now();
+	SIM_UartFeed(1, rx[1].sent, STREAM, t);
+	while(sharedBytes < STREAM && SIM_Now() - t < 2*SIM_S)
+		os_dly_wait(1);
+	ns = SIM_Now() - t;
+	// The one that came away empty still waits for data
+	os_tsk_delete(low);
+	os_tsk_delete(high);
+	for(i=0, sum=0; i<STREAM; i++)
+		sum += rx[1].sent[i];
+	CHECK(shared[0].bytes + shared[1].bytes == STREAM);
+	CHECK(shared[0].sum + shared[1].sum == sum);
+	CHECK(shared[0].bytes > 0 && shared[1].bytes > 0);
+	printf("uart rx: two readers on one port: %u and %u bytes in %u and %u calls, %.2f ms\n",
+	       shared[0].bytes, shared[1].bytes, shared[0].calls, shared[1].calls, ns/1e6);
+
+	// Nobody reading: the ring fills and the rest is dropped
+	SIM_UartFeed(0, burst, BURST, SIM_Now());
+	waitBytes(0, BURST);
+	UARTRxStats(0, &dropped, &overruns);
+	CHECK(dropped == BURST - RXBUFSIZE);
+	CHECK(overruns == 0);
+	n = UARTRecieve(0, buf, sizeof(buf));
+	CHECK(n == RXBUFSIZE && memcmp(buf, burst, n) == 0);
+
+	// Interrupt held off: the hardware FIFO overruns, once
+	NVIC_DisableIRQ(UART0_IRQn);
+	SIM_UartFeed(0, burst, FLOOD, SIM_Now());
+	waitBytes(0, FLOOD);
+	NVIC_EnableIRQ(UART0_IRQn);
+	n = UARTRecieve(0, buf, sizeof(buf));
+	CHECK(n == TXFIFOSIZE && memcmp(buf, burst, n) == 0);
+	UARTRxStats(0, &dropped, &overruns);
+	CHECK(overruns == 1);
+	SIM_UartStats(0, &st);
+	CHECK(st.rxOverrun == FLOOD - TXFIFOSIZE);
+
+	printf("uart rx: ring full: %d dropped, FIFO overrun: %u counted\n", BURST - RXBUFSIZE, overruns);
+	os_tsk_delete_self();
+}
+
+static void entry(void) {
+	os_sys_init(mainTask);
+}
+
+int main(void) {
+	int r = SIM_Run(entry, 10*SIM_S);
+
+	CHECK(r == 0);
+	if(failed) {
+		printf("%d check(s) failed\n", failed);
+		return 1;
+	}
+	printf("uart rx: all checks passed\n");
+	return 0;
+}
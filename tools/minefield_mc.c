@@ -0,0 +1,344 @@
+// Plays MineField games (game.c) on all host cores
+//
+//   minefield_mc [-n games] [-a agent] [-l lapse %] [-j threads] [-m max steps] [-s seed] [-c]
+//
+// Every game gets its own seed, derived from -s and the game number, so
+// the results do not depend on the number of threads. Agents:
+//
+//   random    random steering, pushes off now and then
+//   cautious  only drives onto cells with no visible mine, stops in front
+//             of anything else and leaves a primed cell when it can; with
+//             -l it misses that many percent of the steps, doing nothing
+//   idle      never moves
+//
+// Prints the survival time and score distributions and the throughput.
+// With -c the same games are run again on 1, 2, 4, ... threads up to the
+// core count; it fails if the results differ or a thread count gets less
+// than 75% of linear scaling. The mine speed-up per score increment is
+// set at build time with GAME_SPEEDUP_NUM/GAME_SPEEDUP_DEN.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "game.h"
+
+#define BLOCK          (256)        // games a thread takes at a time
+#define MAX_THREADS    (256)
+#define SCALE_MIN      (0.75)
+#define STEP_S         (GAME_STEP_TICKS*0.01)   // OS_TICK is 10 ms
+
+typedef struct {
+	uint32_t rng;
+	uint32_t lapse;               // percent of steps the agent misses
+} AGENT_CTX;
+
+typedef struct {
+	const char *name;
+	GAME_AGENT fn;
+} AGENT;
+
+// Totals of a run, per thread and merged
+typedef struct {
+	uint64_t games;
+	uint64_t steps;
+	uint64_t limit;               // games still running at max steps
+	uint32_t *survival;           // games per number of steps run
+	uint32_t *score;              // games per final score/10
+} STATS;
+
+typedef struct {
+	pthread_t id;
+	STATS st;
+} WORKER;
+
+static const AGENT *agent;
+static uint64_t games = 1000000;
+static uint32_t maxSteps = 20000;
+static uint32_t seed = 1;
+static uint32_t lapse = 0;
+static uint32_t scoreBins;
+static volatile uint64_t nextGame;
+
+static uint32_t xorshift(uint32_t *s) {
+	uint32_t x = *s;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *s = x;
+}
+
+// Seed of game n, never 0
+static uint32_t gameSeed(uint64_t n) {
+	uint64_t z = (n + seed) * 0x9E3779B97F4A7C15ULL;
+
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	z ^= z >> 31;
+	return (uint32_t)z | 1;
+}
+
+static uint8_t idleAgent(const GameState *g, void *ctx) {
+	return 0;
+}
+
+static uint8_t randomAgent(const GameState *g, void *ctx) {
+	AGENT_CTX *a = ctx;
+	uint32_t r = xorshift(&a->rng);
+	uint8_t in = r % 5;
+
+	if(!((r >> 8) & 3))
+		in |= GAME_IN_PRESS;
+	return in;
+}
+
+// Cell next to (x, y) in direction input, as tankMove drives
+static int neighbour(const GameState *g, uint8_t dir, int *x, int *y) {
+	switch(dir) {
+		case GAME_IN_LEFT:  (*y)--; break;
+		case GAME_IN_RIGHT: (*y)++; break;
+		case GAME_IN_DOWN:  (*x)--; break;
+		case GAME_IN_UP:    (*x)++; break;
+		default: return 0;
+	}
+	return *x >= 0 && *x < MAP_COLS && *y >= 0 && *y < MAP_ROWS &&
+	       !(mapBitField[*x] & (0x1 << (15 - *y)));
+}
+
+static int safe(const GameState *g, uint8_t dir) {
+	int x = g->x, y = g->y;
+
+	return neighbour(g, dir, &x, &y) && Game_CellState(g, x, y) == INVIS;
+}
+
+static uint8_t cautiousAgent(const GameState *g, void *ctx) {
+	static const uint8_t dirCode[] = {0, GAME_IN_UP, GAME_IN_RIGHT, GAME_IN_LEFT, GAME_IN_DOWN};
+	AGENT_CTX *a = ctx;
+	uint8_t dirs[4], n = 0, d;
+	uint32_t r = xorshift(&a->rng);
+	int onMine = Game_CellState(g, g->x, g->y) != INVIS;
+
+	if(r % 100 < a->lapse)
+		return 0;
+
+	// Keep going while the way ahead is clear
+	if(g->moving && safe(g, dirCode[g->dir]) && (onMine || (r & 7)))
+		return 0;
+
+	// Otherwise pick a clear cell next to the tank, or wait where it is
+	for(d=GAME_IN_LEFT; d<=GAME_IN_UP; d++) {
+		if(safe(g, d))
+			dirs[n++] = d;
+	}
+	if(!n || (!onMine && (r >> 8) % 4))
+		return g->moving ? GAME_IN_STOP : 0;
+	return GAME_IN_STOP | GAME_IN_PRESS | dirs[(r >> 16) % n];
+}
+
+static const AGENT agents[] = {
+	{"random", randomAgent},
+	{"cautious", cautiousAgent},
+	{"idle", idleAgent},
+};
+
+static void *worker(void *arg) {
+	WORKER *w = arg;
+	AGENT_CTX ctx;
+	GameState g;
+	uint64_t n, end;
+	uint32_t steps;
+
+	while((n = __atomic_fetch_add(&nextGame, BLOCK, __ATOMIC_RELAXED)) < games) {
+		end = n + BLOCK < games ? n + BLOCK : games;
+		for(; n<end; n++) {
+			ctx.rng = gameSeed(n);
+			ctx.lapse = lapse;
+			steps = Game_Run(&g, agent->fn, &ctx, maxSteps);
+			w->st.games++;
+			w->st.steps += steps;
+			w->st.survival[steps]++;
+			w->st.score[g.score/10]++;
+			if(!g.gameOver)
+				w->st.limit++;
+		}
+	}
+	return 0;
+}
+
+static void statsInit(STATS *st) {
+	memset(st, 0, sizeof(*st));
+	st->survival = calloc(maxSteps + 1, sizeof(uint32_t));
+	st->score = calloc(scoreBins, sizeof(uint32_t));
+	if(!st->survival || !st->score) {
+		fprintf(stderr, "out of memory\n");
+		exit(2);
+	}
+}
+
+static void statsFree(STATS *st) {
+	free(st->survival);
+	free(st->score);
+}
+
+static void statsAdd(STATS *t, const STATS *st) {
+	uint32_t i;
+
+	t->games += st->games;
+	t->steps += st->steps;
+	t->limit += st->limit;
+	for(i=0; i<=maxSteps; i++)
+		t->survival[i] += st->survival[i];
+	for(i=0; i<scoreBins; i++)
+		t->score[i] += st->score[i];
+}
+
+static int statsSame(const STATS *a, const STATS *b) {
+	return a->games == b->games && a->steps == b->steps && a->limit == b->limit &&
+	       !memcmp(a->survival, b->survival, (maxSteps + 1)*sizeof(uint32_t)) &&
+	       !memcmp(a->score, b->score, scoreBins*sizeof(uint32_t));
+}
+
+static double seconds(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+// Runs all games on the given number of threads, returns the wall time
+static double run(int threads, STATS *total) {
+	static WORKER w[MAX_THREADS];
+	double t;
+	int i;
+
+	nextGame = 0;
+	for(i=0; i<threads; i++)
+		statsInit(&w[i].st);
+	t = seconds();
+	for(i=0; i<threads; i++) {
+		if(pthread_create(&w[i].id, 0, worker, &w[i])) {
+			fprintf(stderr, "cannot start thread %d\n", i);
+			exit(2);
+		}
+	}
+	for(i=0; i<threads; i++)
+		pthread_join(w[i].id, 0);
+	t = seconds() - t;
+
+	statsInit(total);
+	for(i=0; i<threads; i++) {
+		statsAdd(total, &w[i].st);
+		statsFree(&w[i].st);
+	}
+	return t;
+}
+
+// Value below which the given share of the counts lies
+static uint32_t percentile(const uint32_t *count, uint32_t n, uint64_t total, double p) {
+	uint64_t sum = 0, want = (uint64_t)(p*total);
+	uint32_t i;
+
+	for(i=0; i<n - 1; i++) {
+		sum += count[i];
+		if(sum > want)
+			break;
+	}
+	return i;
+}
+
+static void report(const STATS *st, double t) {
+	static const double p[] = {0.1, 0.25, 0.5, 0.75, 0.9, 0.99};
+	uint64_t score = 0;
+	uint32_t i, max = 0;
+
+	for(i=0; i<=maxSteps; i++) {
+		if(st->survival[i])
+			max = i;
+	}
+	for(i=0; i<scoreBins; i++)
+		score += (uint64_t)i*10*st->score[i];
+
+	printf("survival: mean %.1f steps (%.1f s), max %u, %.2f%% still alive after %u steps\n",
+	       (double)st->steps/st->games, STEP_S*st->steps/st->games, max,
+	       100.0*st->limit/st->games, maxSteps);
+	printf("  steps:");
+	for(i=0; i<sizeof(p)/sizeof(p[0]); i++)
+		printf("  p%.0f %u", p[i]*100, percentile(st->survival, maxSteps + 1, st->games, p[i]));
+	printf("\nscore: mean %.1f\n  score:", (double)score/st->games);
+	for(i=0; i<sizeof(p)/sizeof(p[0]); i++)
+		printf("  p%.0f %u", p[i]*100, 10*percentile(st->score, scoreBins, st->games, p[i]));
+	printf("\nthroughput: %.0f games/s, %.0f steps/s\n", st->games/t, st->steps/t);
+}
+
+int main(int argc, char **argv) {
+	STATS total, again;
+	int c, i, threads, cores, scale = 0, ok = 1;
+	double t, t1 = 0, eff;
+
+	cores = sysconf(_SC_NPROCESSORS_ONLN);
+	if(cores < 1)
+		cores = 1;
+	if(cores > MAX_THREADS)
+		cores = MAX_THREADS;
+	threads = cores;
+	agent = &agents[0];
+
+	while((c = getopt(argc, argv, "n:a:l:j:m:s:c")) != -1) {
+		switch(c) {
+			case 'n': games = strtoull(optarg, 0, 10); break;
+			case 'j': threads = atoi(optarg); break;
+			case 'm': maxSteps = strtoul(optarg, 0, 10); break;
+			case 's': seed = strtoul(optarg, 0, 10); break;
+			case 'l': lapse = strtoul(optarg, 0, 10); break;
+			case 'c': scale = 1; break;
+			case 'a':
+				for(i=0; i<(int)(sizeof(agents)/sizeof(agents[0])); i++) {
+					if(!strcmp(optarg, agents[i].name))
+						agent = &agents[i];
+				}
+				if(strcmp(optarg, agent->name)) {
+					fprintf(stderr, "unknown agent: %s\n", optarg);
+					return 2;
+				}
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-n games] [-a random|cautious|idle] [-l lapse %%] [-j threads] [-m max steps] [-s seed] [-c]\n", argv[0]);
+				return 2;
+		}
+	}
+	if(threads < 1 || threads > MAX_THREADS || !games || !maxSteps || lapse > 100) {
+		fprintf(stderr, "bad arguments\n");
+		return 2;
+	}
+	scoreBins = maxSteps/GAME_SCORE_STEPS + 2;
+
+	printf("minefield_mc: %llu games, %s agent (lapse %u%%), %d threads, speed-up %d/%d per score step\n",
+	       (unsigned long long)games, agent->name, lapse, threads, GAME_SPEEDUP_NUM, GAME_SPEEDUP_DEN);
+	t = run(threads, &total);
+	report(&total, t);
+
+	if(scale) {
+		printf("scaling on %d cores:\n", cores);
+		for(i=1; ; i = i*2 < cores ? i*2 : cores) {
+			t = run(i, &again);
+			if(i == 1)
+				t1 = t;
+			eff = t1/(t*i);
+			printf("  %3d threads %12.0f games/s  %5.1f%% of linear\n", i, games/t, 100*eff);
+			if(!statsSame(&total, &again)) {
+				printf("  results differ from the first run\n");
+				ok = 0;
+			}
+			if(eff < SCALE_MIN)
+				ok = 0;
+			statsFree(&again);
+			if(i == cores)
+				break;
+		}
+	}
+	statsFree(&total);
+	return ok ? 0 : 1;
+}
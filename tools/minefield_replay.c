@@ -0,0 +1,154 @@
+// Replays a recorded MineField game (game.c) on the host
+//
+//   minefield_replay [-n steps] [-w replay.txt] recording
+//
+// The recording is either a capture of the telemetry stream of UART0
+// (minefield_sim -u, or a serial port) or a replay file. From a capture
+// only the TLM_INPUT records are used; the game cannot be replayed if one
+// of them is missing, which the gap in their sequence numbers shows. A
+// replay file holds one input change per line, the step in decimal and the
+// input byte in hex, lines starting with # are comments. -w writes the
+// input changes of the recording as such a file.
+//
+// The game runs until it is over or -n steps have run (default 1000000),
+// and its final state is printed. A recording that was cut off before the
+// game ended needs -n, the step count of the board.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "game.h"
+#include "telemetry.h"
+
+#define MAX_INPUTS     (1024*1024)
+#define MAX_STREAM     (64*1024*1024)
+#define MAX_STEPS      (1000000)
+
+static GameInput inputs[MAX_INPUTS];
+
+static uint8_t crc8(uint8_t crc, uint8_t data) {
+	uint8_t i;
+
+	crc ^= data;
+	for(i=0; i<8; i++)
+		crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+	return crc;
+}
+
+// TLM_INPUT records of a capture, returns their number, -1 if one is lost
+static int fromCapture(const uint8_t *d, uint32_t n) {
+	uint32_t i = 0, k = 0, seq;
+	uint8_t crc, len;
+	int j;
+
+	while(i < n) {
+		if(d[i] != TLM_SYNC || i + 4 > n || i + 4 + d[i+2] > n) {
+			i++;
+			continue;
+		}
+		len = d[i+2];
+		crc = crc8(crc8(0, d[i+1]), len);
+		for(j=0; j<len; j++)
+			crc = crc8(crc, d[i+3+j]);
+		if(crc != d[i+3+len]) {
+			i++;
+			continue;
+		}
+		if(d[i+1] == TLM_INPUT && len == 7) {
+			seq = d[i+3] | d[i+4] << 8;
+			if(seq != (k & 0xFFFF) || k >= MAX_INPUTS) {
+				fprintf(stderr, "TLM_INPUT record %u missing, got %u\n", k & 0xFFFF, seq);
+				return -1;
+			}
+			inputs[k].step = d[i+5] | d[i+6] << 8 | d[i+7] << 16 | (uint32_t)d[i+8] << 24;
+			inputs[k++].input = d[i+9];
+		}
+		i += 4 + len;
+	}
+	return k;
+}
+
+// Input changes of a replay file, returns their number, -1 on a bad line
+static int fromText(char *s) {
+	unsigned long step, input;
+	char *line, *end;
+	int k = 0, n = 0;
+
+	for(line = strtok(s, "\n"); line; line = strtok(0, "\n")) {
+		n++;
+		line += strspn(line, " \t\r");
+		if(!*line || *line == '#')
+			continue;
+		step = strtoul(line, &end, 10);
+		input = strtoul(end, &end, 16);
+		end += strspn(end, " \t\r");
+		if(*end || input > 0xFF || k >= MAX_INPUTS || (k && step < inputs[k-1].step)) {
+			fprintf(stderr, "line %d: expected increasing step and input byte\n", n);
+			return -1;
+		}
+		inputs[k].step = step;
+		inputs[k++].input = input;
+	}
+	return k;
+}
+
+int main(int argc, char **argv) {
+	static const char *dirNames[] = {"none", "up", "right", "left", "down"};
+	const char *out = 0;
+	uint8_t *d;
+	uint32_t n, maxSteps = MAX_STEPS, steps;
+	GameState g;
+	FILE *f;
+	int c, k, i;
+
+	while((c = getopt(argc, argv, "n:w:")) != -1) {
+		switch(c) {
+			case 'n': maxSteps = strtoul(optarg, 0, 10); break;
+			case 'w': out = optarg; break;
+			default:
+				fprintf(stderr, "usage: %s [-n steps] [-w replay.txt] recording\n", argv[0]);
+				return 2;
+		}
+	}
+	if(optind != argc - 1) {
+		fprintf(stderr, "usage: %s [-n steps] [-w replay.txt] recording\n", argv[0]);
+		return 2;
+	}
+	f = fopen(argv[optind], "rb");
+	d = malloc(MAX_STREAM + 1);
+	if(!f || !d) {
+		fprintf(stderr, "cannot read %s\n", argv[optind]);
+		return 2;
+	}
+	n = fread(d, 1, MAX_STREAM, f);
+	fclose(f);
+	d[n] = 0;
+
+	k = n && d[0] == TLM_SYNC ? fromCapture(d, n) : fromText((char *)d);
+	if(k < 0)
+		return 1;
+
+	if(out) {
+		f = fopen(out, "w");
+		if(f) {
+			fprintf(f, "# MineField replay: step, input byte (game.h GAME_IN_xxx)\n");
+			for(i=0; i<k; i++)
+				fprintf(f, "%u %02x\n", inputs[i].step, inputs[i].input);
+		}
+		if(!f || fclose(f)) {
+			fprintf(stderr, "cannot write %s\n", out);
+			return 2;
+		}
+	}
+
+	steps = Game_ReplayInputs(&g, inputs, k, maxSteps);
+	printf("replay: %d input changes, %s after %u steps (%.1f s)\n", k,
+	       g.gameOver ? "game over" : "still running", steps, steps*GAME_STEP_TICKS*0.01);
+	printf("  score %u, tank at %u,%u facing %s%s, mine sets", g.score, g.x, g.y,
+	       dirNames[g.dir <= DOWN ? g.dir : 0], g.moving ? ", moving" : "");
+	for(i=0; i<MINE_SETS; i++)
+		printf(" %s", g.mines[i] == EXP ? "exp" : g.mines[i] == PRIMED ? "primed" : "invis");
+	printf("\n");
+	return 0;
+}
@@ -0,0 +1,127 @@
+// Runs the firmware on the simulated board (host/sim.h)
+//
+//   minefield_sim [-t seconds] [-j script] [-b ms] [-o screen.ppm] [-u uart0.bin]
+//
+// The joystick script is a comma separated list of ms:lines, lines being
+// the hal.h HAL_JOY_xxx bits in hex (e.g. 200:100000,300:0 pushes the
+// joystick at 200 ms and lets go at 300 ms). -b presses the push button.
+// Without -j the joystick is pushed once to leave the start screen.
+// Prints what the run cost on the buses and how long the core slept, both
+// as the firmware reported it in TLM_IDLE records and as the kernel saw it.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "game.h"
+#include "hal.h"
+#include "telemetry.h"
+#include "sim.h"
+
+int MinefieldMain(void);
+extern GameState gameState;
+
+static void entry(void) {
+	MinefieldMain();
+}
+
+// Sleep time of the TLM_IDLE records on UART0, in microseconds
+static uint64_t reportedSleep(const uint8_t *d, uint32_t n) {
+	uint64_t us = 0;
+	uint32_t i = 0;
+
+	while(i + 4 <= n && d[i] == TLM_SYNC && i + 4 + d[i+2] <= n) {
+		if(d[i+1] == TLM_IDLE && d[i+2] == 8)
+			us += d[i+7] | d[i+8] << 8 | d[i+9] << 16 | (uint32_t)d[i+10] << 24;
+		i += 4 + d[i+2];
+	}
+	return us;
+}
+
+static int script(const char *s) {
+	unsigned long ms, lines;
+	char *end;
+
+	while(*s) {
+		ms = strtoul(s, &end, 10);
+		if(*end != ':')
+			return -1;
+		lines = strtoul(end + 1, &end, 16);
+		SIM_JoyAt(ms*SIM_MS, (uint32_t)lines);
+		if(*end == ',')
+			end++;
+		else if(*end)
+			return -1;
+		s = end;
+	}
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	SIM_SSP_STATS ssp;
+	SIM_LCD_STATS lcd;
+	SIM_RTX_STATS rtx;
+	SIM_UART_STATS uart;
+	const char *ppm = 0, *uartFile = 0;
+	const uint8_t *out;
+	double seconds = 600, t;
+	uint32_t len;
+	int c, r, joy = 0;
+	FILE *f;
+
+	while((c = getopt(argc, argv, "t:j:b:o:u:")) != -1) {
+		switch(c) {
+			case 't': seconds = atof(optarg); break;
+			case 'j':
+				if(script(optarg)) {
+					fprintf(stderr, "bad joystick script: %s\n", optarg);
+					return 2;
+				}
+				joy = 1;
+				break;
+			case 'b': SIM_ButtonAt(strtoull(optarg, 0, 10)*SIM_MS); break;
+			case 'o': ppm = optarg; break;
+			case 'u': uartFile = optarg; break;
+			default:
+				fprintf(stderr, "usage: %s [-t seconds] [-j ms:lines,...] [-b ms] [-o screen.ppm] [-u uart0.bin]\n", argv[0]);
+				return 2;
+		}
+	}
+	if(!joy) {
+		SIM_JoyAt(200*SIM_MS, HAL_JOY_PRESS);
+		SIM_JoyAt(300*SIM_MS, 0);
+	}
+
+	r = SIM_Run(entry, (uint64_t)(seconds*SIM_S));
+	t = SIM_Now()/1e9;
+
+	SIM_SspStats(&ssp, 0);
+	SIM_LcdStats(&lcd, 0);
+	SIM_RtxStats(&rtx);
+	SIM_UartStats(0, &uart);
+
+	printf("run:    %s after %.3f s, %u steps, score %u\n",
+	       r == 0 ? "game over" : r == -1 ? "time limit" : "stopped", t, gameState.step, gameState.score);
+	printf("ssp1:   %llu bytes (%llu by DMA) in %llu transactions, wire busy %.1f%%\n",
+	       (unsigned long long)ssp.bytes, (unsigned long long)ssp.dmaBytes,
+	       (unsigned long long)ssp.csAsserts, t > 0 ? 100.0*ssp.wireNs/SIM_Now() : 0.0);
+	printf("lcd:    %llu pixels, %u protocol errors\n", (unsigned long long)lcd.pixels, SIM_LcdErrors());
+	printf("uart0:  %llu bytes sent, %llu lost on a full FIFO\n",
+	       (unsigned long long)uart.txBytes, (unsigned long long)uart.txOverflow);
+	printf("rtx:    %llu switches, %llu kernel calls, %u ticks\n",
+	       (unsigned long long)rtx.switches, (unsigned long long)rtx.calls, rtx.ticks);
+	printf("idle:   %.1f%% of the time since os_sys_init\n",
+	       rtx.ticks ? 100.0*rtx.idleNs/(rtx.ticks*10*SIM_MS) : 0.0);
+	out = SIM_UartOutput(0, &len);
+	printf("asleep: %.3f s by TLM_IDLE, %.3f s since the last record, %.3f s idle in the kernel\n",
+	       reportedSleep(out, len)/1e6, HAL_SleepUs(0)/1e6, rtx.idleNs/1e9);
+
+	if(ppm && SIM_LcdDump(ppm))
+		fprintf(stderr, "cannot write %s\n", ppm);
+	if(uartFile) {
+		f = fopen(uartFile, "wb");
+		if(!f || fwrite(out, 1, len, f) != len || fclose(f))
+			fprintf(stderr, "cannot write %s\n", uartFile);
+	}
+	return r == 0 || r == -1 ? 0 : 1;
+}
@@ -0,0 +1,291 @@
+// Decodes the telemetry stream of UART0 (telemetry.h)
+//
+//   tlm_decode [-a] uart0.bin
+//
+// Reads a capture of the stream, e.g. from minefield_sim -u or a serial
+// port, - for stdin. Checks the framing and CRC of every record, skipping
+// bytes until the next good record after a damaged one, and prints:
+//
+//   - the share of the time each task ran (TLM_TASK), the core slept
+//     (TLM_IDLE) and the rest went to (kernel, interrupts, tasks without
+//     records), between the first and the last TLM_IDLE record, as each
+//     of them covers the sleep since the one before. The run time of a
+//     pass is wall time and includes what the task spent blocked inside
+//     it (display_task sleeping on DMA), so the shares can overlap
+//   - per task histograms of the run time of a pass and of the time from
+//     one pass to the next, and of the frame render time (TLM_FRAME)
+//   - SSP1 bytes per frame and per tag (TLM_BUS, PROFILE_BUS builds)
+//   - gaps in the TLM_INPUT sequence numbers, records minefield_replay
+//     would miss
+//
+// With -a every record is printed as well. Fails if no record was found
+// or any was damaged.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "telemetry.h"
+
+#define MAX_STREAM     (64*1024*1024)
+#define BUCKETS        (32)
+#define BUS_TAGS       (8)
+#define BAR            (40)
+
+// Counts per power of two of microseconds, bucket b holds [2^(b-1), 2^b)
+typedef struct {
+	uint32_t n[BUCKETS];
+	uint32_t count;
+	uint32_t max;
+	uint64_t sum;
+} HIST;
+
+typedef struct {
+	uint32_t passes;
+	uint64_t runUs;               // in the share window
+	uint32_t lastStart;
+	HIST run;
+	HIST period;
+} TASK;
+
+static TASK tasks[256];
+static HIST render;
+static uint64_t busBytes[BUS_TAGS];
+static uint32_t busFrames[BUS_TAGS];
+// Share window, from the first to the last TLM_IDLE record
+static uint32_t idleFirst, idleLast, idleCount;
+static uint64_t sleepUs;
+static uint32_t perType[256];
+static uint32_t inputSeq, inputLost;
+static uint32_t bad, skipped;
+
+static uint32_t get16(const uint8_t *p) {
+	return p[0] | p[1] << 8;
+}
+
+static uint32_t get32(const uint8_t *p) {
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint8_t crc8(uint8_t crc, uint8_t data) {
+	uint8_t i;
+
+	crc ^= data;
+	for(i=0; i<8; i++)
+		crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+	return crc;
+}
+
+static void histAdd(HIST *h, uint32_t us) {
+	uint32_t b = 0;
+
+	while(b < BUCKETS - 1 && us >> b)
+		b++;
+	h->n[b]++;
+	h->count++;
+	h->sum += us;
+	if(us > h->max)
+		h->max = us;
+}
+
+static void histPrint(const char *name, const HIST *h) {
+	uint32_t b, first, last, peak = 0;
+
+	if(!h->count)
+		return;
+	for(first=0; !h->n[first]; first++);
+	for(last=BUCKETS - 1; !h->n[last]; last--);
+	for(b=first; b<=last; b++) {
+		if(h->n[b] > peak)
+			peak = h->n[b];
+	}
+	printf("  %s: %u, mean %.0f us, max %u us\n", name, h->count, (double)h->sum/h->count, h->max);
+	for(b=first; b<=last; b++) {
+		printf("    %8u - %8u us %7u ", b ? 1u << (b - 1) : 0, (1u << b) - 1, h->n[b]);
+		printf("%.*s\n", (int)((h->n[b]*(uint64_t)BAR + peak - 1)/peak), "########################################");
+	}
+}
+
+// Whether a time is inside the share window, timestamps wrap after 71 min
+static int inWindow(uint32_t t) {
+	return (int32_t)(t - idleFirst) >= 0 && (int32_t)(idleLast - t) >= 0;
+}
+
+static const char *taskName(uint8_t id) {
+	static char buf[16];
+
+	switch(id) {
+		case TLM_ID_GAME: return "game";
+		case TLM_ID_DISP: return "display";
+	}
+	snprintf(buf, sizeof(buf), "task %u", id);
+	return buf;
+}
+
+static void record(uint8_t type, const uint8_t *p, uint8_t len, int all) {
+	TASK *t;
+	uint32_t start;
+
+	switch(type) {
+		case TLM_TASK:
+			if(len != 13)
+				break;
+			t = &tasks[p[0]];
+			start = get32(p + 1);
+			if(t->passes)
+				histAdd(&t->period, start - t->lastStart);
+			t->lastStart = start;
+			t->passes++;
+			if(inWindow(start) && inWindow(start + get32(p + 9)))
+				t->runUs += get32(p + 9);
+			histAdd(&t->run, get32(p + 9));
+			if(all)
+				printf("task    %-8s start %10u wait %8u run %8u\n", taskName(p[0]), start, get32(p + 5), get32(p + 9));
+			return;
+		case TLM_FRAME:
+			if(len != 16)
+				break;
+			histAdd(&render, get32(p + 6));
+			if(all)
+				printf("frame   %5u start %10u render %8u spi %8u B cells %u\n", get16(p), get32(p + 2),
+				       get32(p + 6), get32(p + 10), get16(p + 14));
+			return;
+		case TLM_IDLE:
+			if(len != 8)
+				break;
+			if(get32(p) != idleFirst)
+				sleepUs += get32(p + 4);
+			if(all)
+				printf("idle    time %10u asleep %8u\n", get32(p), get32(p + 4));
+			return;
+		case TLM_INPUT:
+			if(len != 7)
+				break;
+			if(get16(p) != (inputSeq & 0xFFFF))
+				inputLost += (get16(p) - inputSeq) & 0xFFFF;
+			inputSeq = get16(p) + 1;
+			if(all)
+				printf("input   %5u step %10u input 0x%02x\n", get16(p), get32(p + 2), p[6]);
+			return;
+		case TLM_BUS:
+			if(len != 15)
+				break;
+			if(p[2] < BUS_TAGS) {
+				busBytes[p[2]] += get32(p + 3);
+				busFrames[p[2]]++;
+			}
+			if(all)
+				printf("bus     %5u tag %u %8u B %5u cs %5u skipped %8u us\n", get16(p), p[2],
+				       get32(p + 3), get16(p + 7), get16(p + 9), get32(p + 11));
+			return;
+	}
+	if(all)
+		printf("type 0x%02x, %u bytes\n", type, len);
+}
+
+// Goes through the good records of the stream, the first time (all < 0)
+// only to find the TLM_IDLE records, and returns the number of good records
+static uint32_t parse(const uint8_t *d, uint32_t n, int all) {
+	uint32_t i = 0, records = 0;
+	uint8_t crc, len;
+	int j;
+
+	bad = skipped = 0;
+	while(i < n) {
+		if(d[i] != TLM_SYNC || i + 4 > n || i + 4 + d[i+2] > n) {
+			i++;
+			skipped++;
+			continue;
+		}
+		len = d[i+2];
+		crc = crc8(crc8(0, d[i+1]), len);
+		for(j=0; j<len; j++)
+			crc = crc8(crc, d[i+3+j]);
+		if(crc != d[i+3+len]) {
+			bad++;
+			i++;
+			skipped++;
+			continue;
+		}
+		if(all >= 0) {
+			record(d[i+1], d + i + 3, len, all);
+			perType[d[i+1]]++;
+		} else if(d[i+1] == TLM_IDLE && len == 8) {
+			if(!idleCount++)
+				idleFirst = get32(d + i + 3);
+			idleLast = get32(d + i + 3);
+		}
+		records++;
+		i += 4 + len;
+	}
+	return records;
+}
+
+int main(int argc, char **argv) {
+	static const char *tagNames[BUS_TAGS] = {"other", "map", "tank", "mines", "flush"};
+	uint32_t n, records, spanUs;
+	uint8_t *d;
+	uint64_t runUs = 0;
+	FILE *f;
+	int c, all = 0, id, j;
+
+	while((c = getopt(argc, argv, "a")) != -1) {
+		switch(c) {
+			case 'a': all = 1; break;
+			default:
+				fprintf(stderr, "usage: %s [-a] uart0.bin|-\n", argv[0]);
+				return 2;
+		}
+	}
+	if(optind != argc - 1) {
+		fprintf(stderr, "usage: %s [-a] uart0.bin|-\n", argv[0]);
+		return 2;
+	}
+	f = strcmp(argv[optind], "-") ? fopen(argv[optind], "rb") : stdin;
+	d = malloc(MAX_STREAM);
+	if(!f || !d) {
+		fprintf(stderr, "cannot read %s\n", argv[optind]);
+		return 2;
+	}
+	n = fread(d, 1, MAX_STREAM, f);
+
+	// The share window first, then the records
+	parse(d, n, -1);
+	records = parse(d, n, all);
+	printf("tlm_decode: %u bytes, %u records (%u task, %u frame, %u idle, %u input, %u bus), "
+	       "%u failed the CRC, %u bytes skipped\n", n, records, perType[TLM_TASK], perType[TLM_FRAME],
+	       perType[TLM_IDLE], perType[TLM_INPUT], perType[TLM_BUS], bad, skipped);
+
+	spanUs = idleLast - idleFirst;
+	if(idleCount > 1 && spanUs) {
+		printf("cpu share over %.3f s:\n", spanUs/1e6);
+		for(id=0; id<256; id++) {
+			if(tasks[id].passes) {
+				printf("  %-8s %5.1f%%  %u passes\n", taskName(id), 100.0*tasks[id].runUs/spanUs, tasks[id].passes);
+				runUs += tasks[id].runUs;
+			}
+		}
+		printf("  %-8s %5.1f%%\n", "asleep", 100.0*sleepUs/spanUs);
+		printf("  %-8s %5.1f%%  kernel, interrupts, tasks without records\n", "other",
+		       runUs + sleepUs < spanUs ? 100.0*(spanUs - runUs - sleepUs)/spanUs : 0.0);
+	}
+	for(id=0; id<256; id++) {
+		if(!tasks[id].passes)
+			continue;
+		printf("%s task:\n", taskName(id));
+		histPrint("run time", &tasks[id].run);
+		histPrint("pass to pass", &tasks[id].period);
+	}
+	if(render.count) {
+		printf("frames:\n");
+		histPrint("render time", &render);
+	}
+	for(j=0; j<BUS_TAGS; j++) {
+		if(busFrames[j])
+			printf("ssp1 %-6s %10llu B, %.0f B/frame\n", tagNames[j] ? tagNames[j] : "?",
+			       (unsigned long long)busBytes[j], (double)busBytes[j]/busFrames[j]);
+	}
+	if(inputLost)
+		printf("%u TLM_INPUT records lost, the game cannot be replayed\n", inputLost);
+	return records && !bad ? 0 : 1;
+}